@@ -0,0 +1,98 @@
+/*
+ * async_writer.cc -- write output from a separate thread
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "async_writer.hh"
+
+Async_writer::Async_writer(size_t record_size,size_t max_bytes) :
+  rsize(record_size),
+  head(0),
+  tail(0),
+  done(false)
+{
+  nslots=max_bytes/rsize;
+  if (nslots<4) nslots=4;
+  if (nslots>4096) nslots=4096;
+  ring.resize(nslots*rsize);
+}
+
+Async_writer::~Async_writer()
+{
+  finish();
+}
+
+void Async_writer::finish()
+{
+  if (!writer.joinable()) return;
+  done.store(true,std::memory_order_release);
+  writer.join();
+  done.store(false);
+}
+
+// Writer thread: write records as they become available, sleep a
+// little when there are none
+void Async_writer::loop()
+{
+  while (true) {
+    size_t t=tail.load(std::memory_order_relaxed);
+    if (t==head.load(std::memory_order_acquire)) {
+      if (done.load(std::memory_order_acquire) && t==head.load(std::memory_order_acquire))
+	return;
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+      continue;
+    }
+    write(ring.data()+(t%nslots)*rsize);
+    tail.store(t+1,std::memory_order_release);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Text_rows
+
+Text_rows::Text_rows(std::ostream& o,const std::string& formats,const char *eol) :
+  Async_writer(formats.size()*sizeof(double),1<<20),
+  o(o),
+  formats(formats),
+  eol(eol)
+{}
+
+void Text_rows::push(const double *row)
+{
+  memcpy(reserve(),row,formats.size()*sizeof(double));
+  commit();
+}
+
+void Text_rows::write(const char *record)
+{
+  const double *row=(const double*) record;
+  char buf[30];
+  for (int c=0; c<formats.size(); ++c) {
+    if (formats[c]=='d')
+      sprintf(buf,c==0 ? "%11d" : " %11d",(int) row[c]);
+    else
+      sprintf(buf,c==0 ? "%11.6g" : " %11.6g",row[c]);
+    o << buf;
+  }
+  o << eol;
+}
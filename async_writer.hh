@@ -0,0 +1,113 @@
+/*
+ * async_writer.hh -- write output from a separate thread
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#ifndef ASYNC_WRITER_HH
+#define ASYNC_WRITER_HH
+
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Async_writer
+//
+// Moves formatting and writing of output off the simulation thread.
+// The simulation (producer) copies the raw data of each sample into a
+// record of fixed size, and a writer thread (consumer) formats and
+// writes the records, in order.  Records live in a ring buffer shared
+// by the two threads without locks (there is only one producer and
+// one consumer, so the two indices suffice for synchronization).  If
+// the writer falls behind and the buffer fills up, the producer waits.
+//
+// Derive a class implementing write(), which receives a record (in
+// the writer thread).  To produce a record call reserve(), fill the
+// memory it returns (record_size bytes) and then call commit().  The
+// writer thread is started with the first record.  finish() waits
+// until all records have been written and stops the thread; it must
+// be called (at the latest) by the destructor of the derived class,
+// since write() uses its members.
+//
+// The ring holds at most max_bytes (but at least 4 records).
+
+class Async_writer {
+public:
+  Async_writer(size_t record_size,size_t max_bytes=1<<26);
+  virtual ~Async_writer();
+
+  char* reserve();
+  void  commit();
+  void  finish();
+
+protected:
+  virtual void write(const char *record)=0;
+
+private:
+  size_t              rsize,nslots;
+  std::vector<char>   ring;
+  std::atomic<size_t> head,tail;     // next slot to fill, next slot to write
+  std::atomic<bool>   done;
+  std::thread         writer;
+
+  void loop();
+} ;
+
+inline char* Async_writer::reserve()
+{
+  if (!writer.joinable()) writer=std::thread(&Async_writer::loop,this);
+  size_t h=head.load(std::memory_order_relaxed);
+  while (h-tail.load(std::memory_order_acquire)>=nslots)
+    std::this_thread::yield();
+  return ring.data()+(h%nslots)*rsize;
+}
+
+inline void Async_writer::commit()
+{
+  head.store(head.load(std::memory_order_relaxed)+1,std::memory_order_release);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Text_rows
+//
+// Writes rows of doubles as text, one field per column formatted as
+// %11.6g or %11d (format 'g' or 'd') and separated by blanks (the
+// layout of the output of the simulation programs), each row ending
+// with eol.  Records are the rows; use push() to copy a row.
+
+class Text_rows : public Async_writer {
+public:
+  Text_rows(std::ostream& o,const std::string& formats,const char *eol="\n");
+  ~Text_rows() {finish();}
+
+  void push(const double *row);
+
+protected:
+  void write(const char *record);
+
+private:
+  std::ostream &o;
+  std::string  formats;
+  const char   *eol;
+} ;
+
+#endif /* ASYNC_WRITER_HH */
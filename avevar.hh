@@ -47,6 +47,9 @@
 /** \class AveVar
     \ingroup Analysis
     \brief Compute average and variance using West recurrence
+
+    Two partial results can be combined with merge() (Chan et al.
+    pairwise formula).
 */
 template <bool maxmin=true>
 class AveVar {
@@ -55,6 +58,7 @@ public:
   AveVar& push(double);
   AveVar& push(std::vector<double> v) {for (auto d : v) push(d);}
   AveVar& clear();
+  AveVar& merge(const AveVar&);  ///< Add the points of another object
 
   double  ave() const {return ave_;}
   double  var() const {return var_/(N_-1);}
@@ -100,4 +104,25 @@ inline AveVar<maxmin>& AveVar<maxmin>::push(double x)
   return *this;
 }
 
+template <bool maxmin>
+inline AveVar<maxmin>& AveVar<maxmin>::merge(const AveVar<maxmin>& a)
+{
+  if (a.N_==0) return *this;
+
+  double NA=N_;
+  double NB=a.N_;
+  double N=NA+NB;
+  double delta=a.ave_-ave_;
+  N_+=a.N_;
+  ave_+=delta*NB/N;
+  var_+=a.var_+delta*delta*NA*NB/N;
+
+  if (maxmin) {
+    if (a.min_<min_) min_=a.min_;
+    if (a.max_>max_) max_=a.max_;
+  }
+
+  return *this;
+}
+
 #endif /* AVEVAR_HH */
@@ -0,0 +1,142 @@
+/*
+ * ensemble.hh -- tools to run several replicas of a mean-field model
+ *                in lockstep (one per SIMD lane)
+ *
+ * The lockstep engines (see sir_m.cc and seeiir_m.cc) keep the state
+ * of `lanes' independent replicas in arrays, and advance all of them
+ * by one Gillespie event per step, each with its own clock.  The loops
+ * over the lanes have no branches and no calls, so that the compiler
+ * can turn them into vector instructions.  This needs random numbers
+ * and logarithms computed inline, which is what this file provides.
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#ifndef ENSEMBLE_HH
+#define ENSEMBLE_HH
+
+#include <stdint.h>
+#include <string.h>
+
+#include "qdrandom.hh"
+
+// Replicas advanced together.  8 fills an AVX-512 register (or two
+// AVX ones) with doubles; compile with -march=native to use them.
+const int ensemble_lanes=8;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Lane_random
+//
+// One xoshiro256+ generator per lane, with the states stored by
+// component so that the lanes are updated together.  The seeds are
+// taken from the global generator (qdrandom.hh), so runs are
+// reproducible given the seed of the program.
+
+template <int L>
+class Lane_random {
+public:
+  Lane_random();
+  void uniform(double *u);     // u[l] in [0,1)
+  void uniform_pos(double *u); // u[l] in (0,1]
+
+private:
+  uint64_t s0[L],s1[L],s2[L],s3[L];
+
+  void next(double *d);        // d[l] in [1,2)
+} ;
+
+template <int L>
+Lane_random<L>::Lane_random()
+{
+  Uniform_integer ran;
+  for (int l=0; l<L; ++l) {
+    uint64_t x=((uint64_t) ran.raw()<<32) ^ ran.raw();
+    uint64_t *s[4]={s0+l,s1+l,s2+l,s3+l};
+    for (int k=0; k<4; ++k) {      // splitmix64, as recommended to seed xoshiro
+      uint64_t z=(x+=0x9e3779b97f4a7c15ULL);
+      z=(z^(z>>30))*0xbf58476d1ce4e5b9ULL;
+      z=(z^(z>>27))*0x94d049bb133111ebULL;
+      *s[k]=z^(z>>31);
+    }
+  }
+}
+
+template <int L>
+inline void Lane_random<L>::next(double *d)
+{
+  for (int l=0; l<L; ++l) {
+    uint64_t r=s0[l]+s3[l];
+    uint64_t t=s1[l]<<17;
+    s2[l]^=s0[l];
+    s3[l]^=s1[l];
+    s1[l]^=s2[l];
+    s0[l]^=s3[l];
+    s2[l]^=t;
+    s3[l]=(s3[l]<<45) | (s3[l]>>19);
+    r=(r>>12) | 0x3ff0000000000000ULL;   // 52 random bits as mantissa of [1,2)
+    memcpy(d+l,&r,sizeof(double));
+  }
+}
+
+template <int L>
+inline void Lane_random<L>::uniform(double *u)
+{
+  next(u);
+  for (int l=0; l<L; ++l) u[l]-=1.;
+}
+
+template <int L>
+inline void Lane_random<L>::uniform_pos(double *u)
+{
+  next(u);
+  for (int l=0; l<L; ++l) u[l]=2.-u[l];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// lane_log
+//
+// Natural logarithm of a positive, normal x, with error of a few ulp.
+// x=2^e m with m in [sqrt(1/2),sqrt(2)), and log m=2 atanh(s) with
+// s=(m-1)/(m+1), |s|<0.172, summed as a series (12 terms are exact to
+// double precision).  Only arithmetic and bit operations, so it can
+// be inlined in vectorised loops (std::log is a library call).
+
+inline double lane_log(double x)
+{
+  uint64_t b;
+  memcpy(&b,&x,sizeof(double));
+  uint64_t eb=(b>>52) | 0x4330000000000000ULL;   // 2^52 + biased exponent
+  uint64_t mb=(b & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL;
+  double e,m;
+  memcpy(&e,&eb,sizeof(double));
+  memcpy(&m,&mb,sizeof(double));
+  e-=4503599627370496.+1023.;
+  bool big= m>1.4142135623730951;
+  m= big ? 0.5*m : m;
+  e= big ? e+1. : e;
+
+  double s=(m-1.)/(m+1.);
+  double z=s*s;
+  double p=1./23;
+  p=p*z+1./21; p=p*z+1./19; p=p*z+1./17; p=p*z+1./15; p=p*z+1./13;
+  p=p*z+1./11; p=p*z+1./9;  p=p*z+1./7;  p=p*z+1./5;  p=p*z+1./3;
+  return e*0.6931471805599453094 + (2.*s + 2.*s*z*p);
+}
+
+#endif /* ENSEMBLE_HH */
@@ -87,6 +87,33 @@ void Geoave::push(double time,double e)
   rvarn[n]+=Q*R*(count[n]-1);
 }
 
+/*
+ * Combine with another Geoave using the pairwise formula of Chan,
+ * Golub and LeVeque for the variance
+ */
+void Geoave::merge(const Geoave& g)
+{
+  if (g.base!=base || g.t0!=t0 || g.wfactor!=wfactor)
+    throw std::runtime_error("Geoave::merge: windows do not match");
+
+  if (g.count.size()>count.size()) {
+    count.resize(g.count.size(),0);
+    rave.resize(g.count.size(),0);
+    rvarn.resize(g.count.size(),0);
+  }
+
+  for (int n=0; n<g.count.size(); ++n) {
+    if (g.count[n]==0) continue;
+    double NA=count[n];
+    double NB=g.count[n];
+    double N=NA+NB;
+    double delta=g.rave[n]-rave[n];
+    rave[n]+=delta*NB/N;
+    rvarn[n]+=g.rvarn[n]+delta*delta*NA*NB/N;
+    count[n]+=g.count[n];
+  }
+}
+
 void Geoave::get_aves(std::vector<double>& time,std::vector<double>& ave,
 		      std::vector<double>& var) const
 {
@@ -74,6 +74,9 @@
     The case \f$w=1\f$ is supported and handled as a special case,
     yielding windows of fixed width equal to \f$b\f$. \f$w<1\f$ is not
     recommended.
+
+    Partial averages (with identical windows) can be combined with
+    merge().
 */
 class Geoave {
 public:
@@ -85,6 +88,7 @@ public:
   Geoave(double t0=0,double wfactor=1.5,double base=1);
 
   void push(double time,double e); ///< Add pair (first argument is interpreted as time)
+  void merge(const Geoave&);       ///< Add the points of another object with the same windows
   void get_aves(std::vector<double>& time,std::vector<double>& ave,
 		std::vector<double>& var) const; ///< Returns the abcissas \f$s_0\f$, averages and variance (vectors given are first cleared)
   double ave(int i) const {return rave[i];}
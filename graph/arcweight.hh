@@ -0,0 +1,96 @@
+/*
+ * arcweight.hh -- arc weight policies for the graph types
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#ifndef ARCWEIGHT_HH
+#define ARCWEIGHT_HH
+
+#include <lemon/core.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Arc weight policies
+//
+// Each graph type says how its arcs are weighted through the typedef
+// arc_weight_policy, so that the models can choose at compile time how
+// to sum the weights of the arcs from a node to its infectious
+// neighbours (the innermost loop of the simulations on graphs):
+//
+//   - Uniform_arc_weight: all arcs weigh uniform_arc_weight(), so it
+//     is enough to count the neighbours
+//
+//   - Per_arc_weight: the weight of each arc is read with
+//     arc_weight(arc).  Graphs that may have no weights at all (as a
+//     CSRGraph read from an unweighted file) tell it through
+//     has_arc_weights(), which is checked once per node instead of once
+//     per arc
+//
+//   - Multiplicative_arc_weight: arc i->j weighs
+//     node_factor(i)*node_factor(j), so the factors of the neighbours
+//     are summed and the result multiplied once by that of the node
+
+struct Uniform_arc_weight {};
+struct Per_arc_weight {};
+struct Multiplicative_arc_weight {};
+
+// Sum of the weights of the arcs from node to the targets t for which
+// pred(t) is true.  The loops add a 0 or 1 (or a weight or 0) instead
+// of branching, so that the compiler can vectorise them.
+
+template <typename EGraph,typename Pred>
+inline double weight_to(EGraph& egraph,typename EGraph::inode_t node,Pred pred,
+			Uniform_arc_weight)
+{
+  int n=0;
+  for (typename EGraph::igraph_t::OutArcIt arc(egraph.igraph,node); arc!=lemon::INVALID; ++arc)
+    n+=pred(egraph.igraph.target(arc));
+  return n*egraph.uniform_arc_weight();
+}
+
+template <typename EGraph,typename Pred>
+inline double weight_to(EGraph& egraph,typename EGraph::inode_t node,Pred pred,
+			Per_arc_weight)
+{
+  if (!egraph.has_arc_weights())
+    return weight_to(egraph,node,pred,Uniform_arc_weight());
+  double w=0;
+  for (typename EGraph::igraph_t::OutArcIt arc(egraph.igraph,node); arc!=lemon::INVALID; ++arc)
+    w+= pred(egraph.igraph.target(arc)) ? egraph.arc_weight(arc) : 0.;
+  return w;
+}
+
+template <typename EGraph,typename Pred>
+inline double weight_to(EGraph& egraph,typename EGraph::inode_t node,Pred pred,
+			Multiplicative_arc_weight)
+{
+  double w=0;
+  for (typename EGraph::igraph_t::OutArcIt arc(egraph.igraph,node); arc!=lemon::INVALID; ++arc) {
+    typename EGraph::inode_t t=egraph.igraph.target(arc);
+    w+= pred(t) ? egraph.node_factor(t) : 0.;
+  }
+  return egraph.node_factor(node)*w;
+}
+
+template <typename EGraph,typename Pred>
+inline double weight_to(EGraph& egraph,typename EGraph::inode_t node,Pred pred)
+{
+  return weight_to(egraph,node,pred,typename EGraph::arc_weight_policy());
+}
+
+#endif /* ARCWEIGHT_HH */
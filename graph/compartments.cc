@@ -0,0 +1,159 @@
+/*
+ * compartments.cc -- individuals grouped by epidemiological state
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <algorithm>
+
+#include "compartments.hh"
+
+Compartments::Compartments(int N,int ncomp,unsigned infectious_mask,
+			   const std::vector<double>* weights) :
+  N(N),
+  ncomp(ncomp),
+  infectious(infectious_mask),
+  w(weights),
+  state_(N),
+  pos(N),
+  members(ncomp),
+  count_(ncomp),
+  tree(N+1)
+{
+  for (tree_top=1; 2*tree_top<=N; tree_top*=2) ;
+  reset();
+}
+
+// The tree is built in O(N) by adding each partial sum to the next
+// one that covers it
+void Compartments::reset()
+{
+  std::fill(state_.begin(),state_.end(),0);
+  for (auto &m: members) m.clear();
+  std::fill(count_.begin(),count_.end(),0);
+  count_[0]=N;
+  count_I=n_WI_updates=0;
+  WI=0;
+
+  double tot=0;
+  for (int k=1; k<=N; ++k) {
+    double wk=weight(k-1);
+    tot+=wk;
+    tree[k]=wk;
+  }
+  for (int k=1; k<=N; ++k) {
+    int j=k+(k&-k);
+    if (j<=N) tree[j]+=tree[k];
+  }
+  tree[0]=tot;
+}
+
+void Compartments::tree_add(int i,double dw)
+{
+  tree[0]+=dw;
+  for (int k=i+1; k<=N; k+=k&-k)
+    tree[k]+=dw;
+}
+
+// Returns the individual whose interval of the cumulative weights
+// contains r (N if r is beyond the total)
+int Compartments::tree_find(double r)
+{
+  int k=0;
+  for (int step=tree_top; step>0; step/=2)
+    if (k+step<=N && tree[k+step]<=r) {
+      k+=step;
+      r-=tree[k];
+    }
+  return k;
+}
+
+double Compartments::tree_prefix(int i)
+{
+  double s=0;
+  for (int k=i; k>0; k-=k&-k)
+    s+=tree[k];
+  return s;
+}
+
+// Roundoff can leave tiny weights at removed individuals; those are
+// rejected and drawn again
+int Compartments::pick(int c)
+{
+  if (c>0) return members[c][iran(members[c].size())];
+  int i;
+  do
+    i=tree_find(uran()*tree[0]);
+  while (i>=N || state_[i]!=0);
+  return i;
+}
+
+int Compartments::pick(int,int lo,int hi)
+{
+  double wlo=tree_prefix(lo);
+  double whi=tree_prefix(hi);
+  int i;
+  do
+    i=tree_find(wlo+uran()*(whi-wlo));
+  while (i<lo || i>=hi || state_[i]!=0);
+  return i;
+}
+
+void Compartments::move(int i,int c)
+{
+  int    old=state_[i];
+  double wi=weight(i);
+
+  if (old==0)
+    tree_add(i,-wi);
+  else if (old<ncomp-1) {
+    auto &m=members[old];
+    int  last=m.back();
+    m[pos[i]]=last;
+    pos[last]=pos[i];
+    m.pop_back();
+  }
+  if (c==0)
+    tree_add(i,wi);
+  else if (c<ncomp-1) {
+    pos[i]=members[c].size();
+    members[c].push_back(i);
+  }
+  count_[old]--;
+  count_[c]++;
+  state_[i]=c;
+
+  if (is_infectious(old)==is_infectious(c)) return;
+  if (is_infectious(c)) {
+    WI+=wi;
+    count_I++;
+  } else {
+    WI-=wi;
+    count_I--;
+  }
+  if (++n_WI_updates>N/10) recompute_WI();
+}
+
+// W_I is recomputed from time to time to avoid accumulating roundoff
+void Compartments::recompute_WI()
+{
+  WI=0;
+  for (int c=1; c<ncomp-1; ++c)
+    if (is_infectious(c))
+      for (int i: members[c]) WI+=weight(i);
+  n_WI_updates=0;
+}
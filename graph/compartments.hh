@@ -0,0 +1,86 @@
+/*
+ * compartments.hh -- individuals grouped by epidemiological state
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#ifndef COMPARTMENTS_HH
+#define COMPARTMENTS_HH
+
+#include <vector>
+
+#include "../qdrandom.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Compartments
+//
+// State of N individuals, grouped in compartments numbered from 0
+// (susceptible) to ncomp-1 (absorbing, e.g. removed).  Members of the
+// intermediate compartments are kept in lists (to pick one at
+// random), the susceptibles in a sum tree of their weights (to pick
+// one with probability proportional to its weight, either among all
+// individuals or among those numbered lo..hi-1).  The sum of the
+// weights of the compartments flagged as infectious is kept in W_I.
+//
+// Weights are read from the given vector, which may be changed
+// before reset() but not afterwards; if it is empty (or not given)
+// all weights are 1.
+
+class Compartments {
+public:
+  Compartments(int N,int ncomp,unsigned infectious_mask,
+	       const std::vector<double>* weights=0);
+
+  void   reset();                    // all susceptible
+  int    state(int i) const {return state_[i];}
+  int    count(int c) const {return count_[c];}
+  int    pick(int c);                // random member of compartment c
+  int    pick(int c,int lo,int hi);  // same, among lo..hi-1 (only c=0)
+  void   move(int i,int c);          // move individual i to compartment c
+
+  double W_S() const {return count_[0]>0 ? tree[0] : 0.;}
+  double W_I() const {return count_I>0 ? WI : 0.;}
+
+private:
+  int                            N,ncomp;
+  unsigned                       infectious;
+  const std::vector<double>*     w;
+  std::vector<unsigned char>     state_;
+  std::vector<int>               pos;      // position in its compartment list
+  std::vector<std::vector<int> > members;
+  std::vector<int>               count_;
+  int                            count_I,n_WI_updates;
+  double                         WI;
+
+  // Fenwick tree: tree[k] (k=1..N) holds the sum of the weights of
+  // the susceptibles k-lowbit(k)..k-1; tree[0] holds the total
+  std::vector<double>            tree;
+  int                            tree_top;
+  void   tree_add(int i,double dw);
+  int    tree_find(double r);
+  double tree_prefix(int i);       // sum over the susceptibles below i
+
+  Uniform_real                   uran;
+  Uniform_integer                iran;
+
+  double weight(int i) const {return w==0 || w->empty() ? 1. : (*w)[i];}
+  bool   is_infectious(int c) const {return infectious & (1U<<c);}
+  void   recompute_WI();
+} ;
+
+#endif /* COMPARTMENTS_HH */
@@ -0,0 +1,557 @@
+/*
+ * csrgraph.cc -- static graph stored in compressed sparse row form
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "csrgraph.hh"
+
+static const char edges_magic[]="COVIDm edge list 1\n";
+static const char csr_magic[]="COVIDm CSR graph 1\n";
+static const char groups_magic[]="COVIDm groups 1\n";
+static const size_t magic_size=32;
+
+// Split [0,n) among the available cores and call fun(begin,end) for
+// each piece (small jobs are done serially)
+template <typename Fun>
+static void parallel_for(long n,Fun fun)
+{
+  int nt= n<100000 ? 1 : std::max(1U,std::thread::hardware_concurrency());
+  std::vector<std::thread> threads;
+  for (int t=1; t<nt; ++t)
+    threads.emplace_back(fun,n*t/nt,n*(t+1)/nt);
+  fun(0,n/nt);
+  for (auto &t: threads) t.join();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// CSRGraph
+
+CSRGraph::CSRGraph(double default_arc_weight) :
+  default_arc_weight(default_arc_weight),
+  map(0)
+{}
+
+CSRGraph::CSRGraph(int N,std::vector<long>& start,std::vector<int>& adj,
+		   std::vector<double>& weight,std::vector<int>& parent,
+		   double default_arc_weight) :
+  default_arc_weight(default_arc_weight),
+  map(0)
+{
+  start_v.swap(start);
+  adj_v.swap(adj);
+  weight_v.swap(weight);
+  parent_v.swap(parent);
+  set_arrays(N,parent_v.size(),start_v.data(),adj_v.data(),
+	     weight_v.empty() ? 0 : weight_v.data(),parent_v.data());
+}
+
+// Point the graphs to the arrays and build the children lists of the
+// hierarchy (by counting sort of the parent array)
+void CSRGraph::set_arrays(int N,int Nh,const long *start,const int *adj,
+			  const double *weight_,const int *parent_)
+{
+  if (Nh<=N) throw std::runtime_error("CSRGraph: hierarchy has no aggregate nodes");
+  inode_count=N;
+  weight=weight_;
+  parent=parent_;
+  igraph.N=N;
+  igraph.start=start;
+  igraph.adj=adj;
+
+  cstart_v.assign(Nh+1,0);
+  hroot=lemon::INVALID;
+  for (int n=0; n<Nh; ++n) {
+    if (parent[n]<0) {
+      if (hroot!=lemon::INVALID)
+	throw std::runtime_error("CSRGraph: hierarchy has more than one root");
+      hroot=Node(n);
+    } else if (parent[n]<N || parent[n]>=Nh)
+      throw std::runtime_error("CSRGraph: parent is not an aggregate node");
+    else
+      cstart_v[parent[n]+1]++;
+  }
+  if (hroot==lemon::INVALID || hroot.i<N)
+    throw std::runtime_error("CSRGraph: hierarchy root must be an aggregate node");
+  std::partial_sum(cstart_v.begin(),cstart_v.end(),cstart_v.begin());
+  child_v.resize(Nh-1);
+  std::vector<long> pos(cstart_v.begin(),cstart_v.end()-1);
+  for (int n=0; n<Nh; ++n)
+    if (parent[n]>=0) child_v[pos[parent[n]]++]=n;
+
+  hgraph.N=Nh;
+  hgraph.cstart=cstart_v.data();
+  hgraph.child=child_v.data();
+  build_ancestors();
+}
+
+// Ancestor chains of the individuals, so that for_each_anode() reads
+// a short contiguous slice.  When all individuals are at the same
+// depth D (always the case for hierarchies from group tables) the
+// chains are stored as D consecutive ints per individual, otherwise
+// anc_first_v gives the limits of each chain.
+void CSRGraph::build_ancestors()
+{
+  int N=inode_count;
+  std::vector<int> depth(N);
+  anc_depth=-1;
+  for (int n=0; n<N; ++n) {
+    int d=0;
+    for (int p=parent[n]; p>=0; p=parent[p])
+      if (++d>hgraph.N) throw std::runtime_error("CSRGraph: hierarchy has a cycle");
+    depth[n]=d;
+    if (anc_depth<0) anc_depth=d;
+    else if (d!=anc_depth) anc_depth=0;
+  }
+
+  anc_first_v.clear();
+  if (anc_depth==0) {
+    anc_first_v.resize(N+1,0);
+    for (int n=0; n<N; ++n) anc_first_v[n+1]=anc_first_v[n]+depth[n];
+  }
+  anc_v.resize(anc_depth>0 ? (long) N*anc_depth : anc_first_v[N]);
+  parallel_for(N,[this](long begin,long end) {
+      for (long n=begin; n<end; ++n) {
+	long k= anc_depth>0 ? n*anc_depth : anc_first_v[n];
+	for (int p=parent[n]; p>=0; p=parent[p]) anc_v[k++]=p;
+      }
+    });
+  anc=anc_v.data();
+  anc_first=anc_first_v.data();
+}
+
+CSRGraph::~CSRGraph()
+{
+  if (map) munmap(map,map_size);
+}
+
+// Sort the neighbours of each node by number (with their weights, if
+// any)
+static void sort_rows(int N,const std::vector<long>& start,std::vector<int>& adj,
+		      std::vector<double>& weight)
+{
+  parallel_for(N,[&](long b,long e) {
+      std::vector<std::pair<int,double> > row;
+      for (long i=b; i<e; ++i) {
+	if (weight.empty()) {
+	  std::sort(adj.begin()+start[i],adj.begin()+start[i+1]);
+	  continue;
+	}
+	row.clear();
+	for (long k=start[i]; k<start[i+1]; ++k) row.push_back(std::make_pair(adj[k],weight[k]));
+	std::sort(row.begin(),row.end());
+	for (long k=start[i]; k<start[i+1]; ++k) {
+	  adj[k]=row[k-start[i]].first;
+	  weight[k]=row[k-start[i]].second;
+	}
+      }
+    });
+}
+
+// Build from an edge list: each edge gives the two arcs i->j and j->i.
+// Arcs are counted and placed in parallel, then the neighbours of each
+// node are sorted by number (so that the result does not depend on
+// the order in which the threads placed them)
+CSRGraph* CSRGraph::create(int N,long M,const int *ends,const double *w,
+			   const std::vector<int>& parent)
+{
+  std::vector<std::atomic<long> > count(N+1);
+  for (auto &c: count) c.store(0,std::memory_order_relaxed);
+  std::atomic<bool> bad(false);
+  parallel_for(M,[&](long b,long e) {
+      for (long k=b; k<e; ++k) {
+	int i=ends[2*k], j=ends[2*k+1];
+	if (i<0 || i>=N || j<0 || j>=N || i==j) {bad=true; return;}
+	count[i].fetch_add(1,std::memory_order_relaxed);
+	count[j].fetch_add(1,std::memory_order_relaxed);
+      }
+    });
+  if (bad) throw std::runtime_error("CSRGraph: invalid edge");
+
+  std::vector<long> start(N+1);
+  start[0]=0;
+  for (int i=0; i<N; ++i) {
+    start[i+1]=start[i]+count[i].load(std::memory_order_relaxed);
+    count[i].store(start[i],std::memory_order_relaxed);    // now next free position
+  }
+
+  std::vector<int>    adj(start[N]);
+  std::vector<double> weight(w ? start[N] : 0);
+  parallel_for(M,[&](long b,long e) {
+      for (long k=b; k<e; ++k) {
+	int i=ends[2*k], j=ends[2*k+1];
+	long pi=count[i].fetch_add(1,std::memory_order_relaxed);
+	long pj=count[j].fetch_add(1,std::memory_order_relaxed);
+	adj[pi]=j;
+	adj[pj]=i;
+	if (w) weight[pi]=weight[pj]=w[k];
+      }
+    });
+
+  sort_rows(N,start,adj,weight);
+  std::vector<int> par(parent);
+  return new CSRGraph(N,start,adj,weight,par);
+}
+
+// Parent array with all individuals hanging from the root
+static std::vector<int> flat_hierarchy(int N)
+{
+  std::vector<int> parent(N+1,N);
+  parent[N]=-1;
+  return parent;
+}
+
+// Square lattice with open boundaries (as lemon::GridGraph) and a
+// single aggregate node.  Node (x,y) is x+y*Lx.
+CSRGraph* CSRGraph::create_square_lattice(int Lx,int Ly)
+{
+  int N=Lx*Ly;
+  std::vector<int> ends;
+  ends.reserve(4*N);
+  for (int y=0; y<Ly; ++y)
+    for (int x=0; x<Lx; ++x) {
+      int n=x+y*Lx;
+      if (x<Lx-1) {ends.push_back(n); ends.push_back(n+1);}
+      if (y<Ly-1) {ends.push_back(n); ends.push_back(n+Lx);}
+    }
+  return create(N,ends.size()/2,ends.data(),0,flat_hierarchy(N));
+}
+
+// Hierarchy from nested groups: group g of level l is aggregate node
+// N+first[l]+g, the root is the last node
+std::vector<int> CSRGraph::groups_to_parent(int N,const std::vector<const int*>& group)
+{
+  int L=group.size();
+  std::vector<long> first(L+1,0);
+  for (int l=0; l<L; ++l) {
+    int G=0;
+    for (int n=0; n<N; ++n) {
+      if (group[l][n]<0) throw std::runtime_error("CSRGraph: negative group number");
+      G=std::max(G,group[l][n]+1);
+    }
+    first[l+1]=first[l]+G;
+  }
+  long Nh=N+first[L]+1;
+  if (Nh>std::numeric_limits<int>::max())
+    throw std::runtime_error("CSRGraph: too many nodes");
+  int root=Nh-1;
+
+  std::vector<int> parent(Nh,root);
+  parent[root]=-1;
+  for (int n=0; n<N; ++n) {
+    int node=n;
+    for (int l=0; l<L; ++l) {
+      int p=N+first[l]+group[l][n];
+      if (node>=N && parent[node]!=root && parent[node]!=p)
+	throw std::runtime_error("CSRGraph: groups are not nested");
+      parent[node]=p;
+      node=p;
+    }
+  }
+  return parent;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Renumbering
+//
+//   - bfs: breadth-first search, each component starting from its
+//     node of lowest degree.
+//
+//   - rcm: reverse Cuthill-McKee, i.e. as bfs but visiting the
+//     neighbours of each node by increasing degree, and reversing the
+//     result.  This gives the smallest bandwidth (largest distance in
+//     numbers between neighbours) of the three.
+//
+//   - groups: the members of each group (household, neighbourhood,
+//     ...) consecutive, keeping the old order within the lowest
+//     groups.  This suits networks where most contacts are within
+//     groups, and also makes the aggregate counts updated by
+//     for_each_anode() local.
+
+std::vector<int> CSRGraph::ordering(ordering_t kind) const
+{
+  int N=inode_count;
+  const long *start=igraph.start;
+  const int  *adj=igraph.adj;
+  std::vector<int> order(N);
+  std::iota(order.begin(),order.end(),0);
+
+  if (kind==groups) {
+    auto chain=[this](int n,const int *&b,const int *&e) {
+      if (anc_depth>0) {b=anc+(long) n*anc_depth; e=b+anc_depth;}
+      else {b=anc+anc_first[n]; e=anc+anc_first[n+1];}
+    };
+    std::stable_sort(order.begin(),order.end(),[&chain](int i,int j) {
+	const int *bi,*ei,*bj,*ej;
+	chain(i,bi,ei);
+	chain(j,bj,ej);
+	return std::lexicographical_compare(std::reverse_iterator<const int*>(ei),
+					    std::reverse_iterator<const int*>(bi),
+					    std::reverse_iterator<const int*>(ej),
+					    std::reverse_iterator<const int*>(bj));
+      });
+  } else {
+    auto degree=[start](int i) {return start[i+1]-start[i];};
+    std::vector<int> seeds(order);
+    std::stable_sort(seeds.begin(),seeds.end(),
+		     [&degree](int i,int j) {return degree(i)<degree(j);});
+    std::vector<char> visited(N,0);
+    long head=0,tail=0;
+    for (int s: seeds) {
+      if (visited[s]) continue;
+      visited[s]=1;
+      order[tail++]=s;
+      while (head<tail) {
+	int  u=order[head++];
+	long first=tail;
+	for (long k=start[u]; k<start[u+1]; ++k)
+	  if (!visited[adj[k]]) {
+	    visited[adj[k]]=1;
+	    order[tail++]=adj[k];
+	  }
+	if (kind==rcm)
+	  std::stable_sort(order.begin()+first,order.begin()+tail,
+			   [&degree](int i,int j) {return degree(i)<degree(j);});
+      }
+    }
+    if (kind==rcm) std::reverse(order.begin(),order.end());
+  }
+
+  std::vector<int> newid(N);
+  for (int k=0; k<N; ++k) newid[order[k]]=k;
+  return newid;
+}
+
+CSRGraph* CSRGraph::renumbered(const std::vector<int>& newid) const
+{
+  int N=inode_count;
+  std::vector<int> old(N,-1);
+  if (newid.size()!=N) throw std::runtime_error("CSRGraph: bad renumbering");
+  for (int i=0; i<N; ++i) {
+    if (newid[i]<0 || newid[i]>=N || old[newid[i]]>=0)
+      throw std::runtime_error("CSRGraph: bad renumbering");
+    old[newid[i]]=i;
+  }
+
+  const long *ostart=igraph.start;
+  std::vector<long> start(N+1);
+  start[0]=0;
+  for (int v=0; v<N; ++v) start[v+1]=start[v]+ostart[old[v]+1]-ostart[old[v]];
+  std::vector<int>    adj(start[N]);
+  std::vector<double> w(weight ? start[N] : 0);
+  parallel_for(N,[&](long b,long e) {
+      for (long v=b; v<e; ++v) {
+	long k=start[v];
+	for (long ko=ostart[old[v]]; ko<ostart[old[v]+1]; ++ko,++k) {
+	  adj[k]=newid[igraph.adj[ko]];
+	  if (weight) w[k]=weight[ko];
+	}
+      }
+    });
+  sort_rows(N,start,adj,w);
+
+  std::vector<int> par(parent,parent+hgraph.N);
+  for (int i=0; i<N; ++i) par[newid[i]]=parent[i];
+  return new CSRGraph(N,start,adj,w,par,default_arc_weight);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Reading and writing network files
+
+// Maps the whole file, but the data of interest start at offset (base)
+struct Mapped_file {
+  void       *map;
+  size_t     size;
+  const char *base;
+
+  Mapped_file(const char *fname,size_t offset=0);
+  ~Mapped_file() {if (map) munmap(map,size);}
+  bool has_magic(const char *magic) const;
+  const unsigned long* header() const {return (const unsigned long*) (base+magic_size);}
+  void check_size(size_t needed,const char *fname) const;
+} ;
+
+Mapped_file::Mapped_file(const char *fname,size_t offset)
+{
+  int fd=open(fname,O_RDONLY);
+  if (fd<0) {
+    std::cerr << "Error opening file (" << fname << ")\n";
+    throw std::runtime_error(strerror(errno));
+  }
+  struct stat st;
+  fstat(fd,&st);
+  size=st.st_size;
+  map=mmap(0,size,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);
+  if (map==MAP_FAILED) throw std::runtime_error(strerror(errno));
+  if (offset>size) throw std::runtime_error(std::string(fname)+": truncated file");
+  base=(const char*) map+offset;
+}
+
+bool Mapped_file::has_magic(const char *magic) const
+{
+  return size-(base-(const char*) map)>=magic_size && strncmp(base,magic,strlen(magic))==0;
+}
+
+void Mapped_file::check_size(size_t needed,const char *fname) const
+{
+  if (size-(base-(const char*) map)<needed) throw std::runtime_error(std::string(fname)+": truncated file");
+}
+
+static size_t pad8(size_t n) {return (n+7)/8*8;}
+
+static std::vector<int> read_groups(const char *fname,int N)
+{
+  Mapped_file gf(fname);
+  if (!gf.has_magic(groups_magic))
+    throw std::runtime_error(std::string(fname)+": not a group table");
+  gf.check_size(magic_size+2*sizeof(long),fname);
+  const unsigned long *h=gf.header();
+  if ((int) h[0]!=N)
+    throw std::runtime_error(std::string(fname)+": number of individuals does not match network");
+  int L=h[1];
+  std::vector<const int*> group(L);
+  const char *p=(const char*) (h+2);
+  for (int l=0; l<L; ++l) {
+    group[l]=(const int*) p;
+    p+=pad8(N*sizeof(int));
+  }
+  gf.check_size(p-gf.base,fname);
+  return CSRGraph::groups_to_parent(N,group);
+}
+
+CSRGraph* CSRGraph::load(const char *netfile,const char *groupfile,size_t offset)
+{
+  Mapped_file net(netfile,offset);
+  bool edge_list=net.has_magic(edges_magic);
+  if (!edge_list && !net.has_magic(csr_magic))
+    throw std::runtime_error(std::string(netfile)+": not a network file");
+  net.check_size(magic_size+3*sizeof(long),netfile);
+  const unsigned long *h=net.header();
+  int N=h[0];
+
+  std::vector<int> parent;
+  if (groupfile) parent=read_groups(groupfile,N);
+
+  if (edge_list) {
+    long M=h[1];
+    bool weighted=h[2];
+    const char *p=(const char*) (h+3);
+    const int    *ends=(const int*) p;
+    const double *w= weighted ? (const double*) (p+pad8(2*M*sizeof(int))) : 0;
+    net.check_size(p-net.base + pad8(2*M*sizeof(int)) + (weighted ? M*sizeof(double) : 0),
+		   netfile);
+    if (parent.empty()) parent=flat_hierarchy(N);
+    return create(N,M,ends,w,parent);
+  }
+
+  // CSR graph: use the arrays in place
+  net.check_size(magic_size+4*sizeof(long),netfile);
+  long Nh=h[1];
+  long narcs=h[2];
+  bool weighted=h[3];
+  if (N<0 || Nh<0 || narcs<0)
+    throw std::runtime_error(std::string(netfile)+": bad header");
+  const char   *p=(const char*) (h+4);
+  const long   *start=(const long*) p;
+  p+=(N+1)*sizeof(long);
+  const int    *adj=(const int*) p;
+  p+=pad8(narcs*sizeof(int));
+  const double *w=0;
+  if (weighted) {
+    w=(const double*) p;
+    p+=narcs*sizeof(double);
+  }
+  const int    *fparent=(const int*) p;
+  net.check_size(p-net.base + Nh*sizeof(int),netfile);
+  // the arrays are used as they are, so check once that they describe a
+  // graph (otherwise a corrupt file makes the models read out of bounds)
+  if (start[0]!=0 || start[N]!=narcs)
+    throw std::runtime_error(std::string(netfile)+": inconsistent arc count");
+  for (int n=0; n<N; ++n)
+    if (start[n+1]<start[n])
+      throw std::runtime_error(std::string(netfile)+": arc offsets not ordered");
+  for (long k=0; k<narcs; ++k)
+    if (adj[k]<0 || adj[k]>=N)
+      throw std::runtime_error(std::string(netfile)+": arc to nonexistent node");
+
+  if (parent.empty() && Nh==0) parent=flat_hierarchy(N);
+  CSRGraph *g=new CSRGraph;
+  g->map=net.map;          // the graph keeps the mapping
+  g->map_size=net.size;
+  net.map=0;
+  g->parent_v.swap(parent);
+  if (g->parent_v.empty())
+    g->set_arrays(N,Nh,start,adj,w,fparent);
+  else
+    g->set_arrays(N,g->parent_v.size(),start,adj,w,g->parent_v.data());
+  return g;
+}
+
+static void write_padded(FILE *f,const void *data,size_t size)
+{
+  static const char zeros[8]={0};
+  if (fwrite(data,1,size,f)!=size) throw std::runtime_error(strerror(errno));
+  fwrite(zeros,1,pad8(size)-size,f);
+}
+
+void CSRGraph::save(const char *fname)
+{
+  FILE *f=fopen(fname,"wb");
+  if (f==0) {
+    std::cerr << "Error opening file (" << fname << ")\n";
+    throw std::runtime_error(strerror(errno));
+  }
+  save(f);
+  if (fclose(f)!=0) throw std::runtime_error(strerror(errno));
+}
+
+void CSRGraph::save(FILE *f)
+{
+  char magic[magic_size];
+  memset(magic,'\n',magic_size);
+  memcpy(magic,csr_magic,strlen(csr_magic));
+  fwrite(magic,1,magic_size,f);
+
+  long narcs=igraph.start[inode_count];
+  unsigned long h[4]={(unsigned long) inode_count,(unsigned long) hgraph.N,
+		      (unsigned long) narcs,weight ? 1UL : 0UL};
+  fwrite(h,sizeof(long),4,f);
+  write_padded(f,igraph.start,(inode_count+1)*sizeof(long));
+  write_padded(f,igraph.adj,narcs*sizeof(int));
+  if (weight) write_padded(f,weight,narcs*sizeof(double));
+  write_padded(f,parent,hgraph.N*sizeof(int));
+}
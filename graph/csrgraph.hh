@@ -0,0 +1,327 @@
+/*
+ * csrgraph.hh -- static graph stored in compressed sparse row form
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#ifndef CSRGRAPH_HH
+#define CSRGRAPH_HH
+
+#include <cstdio>
+#include <vector>
+
+#include <lemon/core.h>
+
+#include "../qdrandom.hh"
+#include "arcweight.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// CSRGraph
+//
+// A static graph with the same interface as Graph_base (igraph,
+// hgraph, for_each_anode(), random_inode(), id(), inode(),
+// arc_weight()), so that the models can be instantiated on it, but
+// without LEMON graphs or adaptors underneath.
+//
+//   - Individual nodes are numbered 0..inode_count-1, and the
+//     neighbours of node i are adj[start[i]]..adj[start[i+1]-1], with
+//     weights (if not uniform) in the same positions of weight.  Links
+//     are symmetric, so that the in-arcs of a node are its out-arcs
+//     reversed, and are stored only once for each direction.
+//
+//   - The hierarchy is given by a parent array over all nodes
+//     (individual nodes first, then the aggregate nodes); the root is
+//     the only node without parent (parent -1).  hgraph sees the arcs
+//     from each aggregate node to its children.
+//
+// Scanning the neighbours of a node thus reads consecutive memory,
+// and for_each_anode() reads the ancestors of the node, which are
+// stored consecutively when the graph is built.
+//
+// Use create() to build the graph from a list of (undirected) edges,
+// create_square_lattice() for the (open) square lattice of SQGraph, or
+// load() to read a contact network from file.  Since models keep
+// their node data in arrays indexed by node number, the numbering of
+// the individuals decides how scattered the neighbour lookups are;
+// ordering() and renumbered() improve it (net2bin does this once when
+// writing the graph file).
+
+/*
+ * Network files
+ *
+ * load() reads binary files through mmap, so that large networks
+ * (10^7 nodes, 10^9 edges) start in seconds.  All files begin with a
+ * 32-byte block holding a magic line (padded with newlines), followed
+ * by unsigned longs (8 bytes) and arrays; every array starts at a
+ * multiple of 8 bytes (int arrays are padded with zeros).  Numbers are
+ * in the native format of the machine.
+ *
+ *  - Edge list: magic "COVIDm edge list 1", then N (number of
+ *    individuals), M (number of edges) and weighted (0 or 1), then the
+ *    2M ints i0 j0 i1 j1 ... (each edge is an undirected link between
+ *    individuals i and j, numbered from 0), then, if weighted, the M
+ *    weights (doubles).  The CSR arrays are built in parallel.
+ *
+ *  - CSR graph: magic "COVIDm CSR graph 1", then N, Nh (number of nodes
+ *    in the hierarchy, 0 if none), number of arcs and weighted, then
+ *    the arrays start (N+1 longs), adj (ints), weight (doubles, if
+ *    weighted) and parent (Nh ints), as described above.  The arrays
+ *    are used directly from the mapped file.  save() writes this
+ *    format.
+ *
+ *  - Group table: magic "COVIDm groups 1", then N and the number of
+ *    levels L, then for each level (starting from the lowest, e.g.
+ *    households, then neighbourhoods, ...) the group of every
+ *    individual (N ints, groups numbered from 0).  Groups must be
+ *    nested (all members of a group belong to the same group of the
+ *    next level).  Each group becomes an aggregate node, and the
+ *    groups of the last level hang from the root.
+ *
+ * The hierarchy is taken from the group table if given, else from the
+ * CSR graph file if it has one, else all individuals hang from the
+ * root.  The program net2bin writes these files from text.  The
+ * network can also start at a given offset within a file (the graph
+ * cache, see graph_cache.hh, stores graphs this way).
+ */
+
+class CSRGraph {
+public:
+  class Node {
+  public:
+    Node() {}
+    explicit Node(int i) : i(i) {}
+    Node(lemon::Invalid) : i(-1) {}
+    bool operator==(Node n) const {return i==n.i;}
+    bool operator!=(Node n) const {return i!=n.i;}
+    bool operator<(Node n) const {return i<n.i;}
+
+    int i;
+  } ;
+
+  class Arc {
+  public:
+    Arc() {}
+    Arc(int s,int t,long k) : s(s), t(t), k(k) {}
+    Arc(lemon::Invalid) : k(-1) {}
+    bool operator==(Arc a) const {return k==a.k && (k<0 || (s==a.s && t==a.t));}
+    bool operator!=(Arc a) const {return !(*this==a);}
+
+    int  s,t;    // source and target
+    long k;      // position in the arc arrays (-1 for INVALID)
+  } ;
+
+  template <typename T>
+  class Node_vector : public std::vector<T> {
+  public:
+    Node_vector(int n,const T& v) : std::vector<T>(n,v) {}
+    T&       operator[](Node n) {return std::vector<T>::operator[](n.i);}
+    const T& operator[](Node n) const {return std::vector<T>::operator[](n.i);}
+  } ;
+
+  // Individual (contact) graph
+  class Igraph {
+  public:
+    typedef CSRGraph::Node Node;
+    typedef CSRGraph::Arc  Arc;
+
+    Node source(Arc a) const {return Node(a.s);}
+    Node target(Arc a) const {return Node(a.t);}
+    int  id(Node n) const {return n.i;}
+    Node nodeFromId(int i) const {return Node(i);}
+    int  nodeNum() const {return N;}
+
+    template <typename T>
+    class NodeMap : public Node_vector<T> {
+    public:
+      NodeMap(const Igraph& g,const T& v=T()) : Node_vector<T>(g.N,v) {}
+    } ;
+
+    class NodeIt : public Node {
+    public:
+      NodeIt(lemon::Invalid) : Node(lemon::INVALID) {}
+      NodeIt(const Igraph& g) : Node(g.N>0 ? 0 : -1), N(g.N) {}
+      NodeIt& operator++() {if (++i==N) i=-1; return *this;}
+    private:
+      int N;
+    } ;
+
+    class OutArcIt : public Arc {
+    public:
+      OutArcIt(lemon::Invalid) : Arc(lemon::INVALID) {}
+      OutArcIt(const Igraph& g,Node n) :
+	Arc(n.i,0,g.start[n.i]), adj(g.adj), end(g.start[n.i+1]) {set();}
+      OutArcIt& operator++() {++k; set(); return *this;}
+    private:
+      const int *adj;
+      long      end;
+      void set() {if (k<end) t=adj[k]; else k=-1;}
+    } ;
+
+    class InArcIt : public Arc {
+    public:
+      InArcIt(lemon::Invalid) : Arc(lemon::INVALID) {}
+      InArcIt(const Igraph& g,Node n) :
+	Arc(0,n.i,g.start[n.i]), adj(g.adj), end(g.start[n.i+1]) {set();}
+      InArcIt& operator++() {++k; set(); return *this;}
+    private:
+      const int *adj;
+      long      end;
+      void set() {if (k<end) s=adj[k]; else k=-1;}
+    } ;
+
+  private:
+    int        N;
+    const long *start;
+    const int  *adj;
+
+    friend class CSRGraph;
+  } ;
+
+  // Hierarchical graph (all nodes, arcs from parents to children)
+  class Hgraph {
+  public:
+    typedef CSRGraph::Node Node;
+    typedef CSRGraph::Arc  Arc;
+
+    Node source(Arc a) const {return Node(a.s);}
+    Node target(Arc a) const {return Node(a.t);}
+    int  id(Node n) const {return n.i;}
+    Node nodeFromId(int i) const {return Node(i);}
+    int  nodeNum() const {return N;}
+
+    template <typename T>
+    class NodeMap : public Node_vector<T> {
+    public:
+      NodeMap(const Hgraph& g,const T& v=T()) : Node_vector<T>(g.N,v) {}
+    } ;
+
+    class NodeIt : public Node {
+    public:
+      NodeIt(lemon::Invalid) : Node(lemon::INVALID) {}
+      NodeIt(const Hgraph& g) : Node(g.N>0 ? 0 : -1), N(g.N) {}
+      NodeIt& operator++() {if (++i==N) i=-1; return *this;}
+    private:
+      int N;
+    } ;
+
+    class OutArcIt : public Arc {
+    public:
+      OutArcIt(lemon::Invalid) : Arc(lemon::INVALID) {}
+      OutArcIt(const Hgraph& g,Node n) :
+	Arc(n.i,0,g.cstart[n.i]), child(g.child), end(g.cstart[n.i+1]) {set();}
+      OutArcIt& operator++() {++k; set(); return *this;}
+    private:
+      const int *child;
+      long      end;
+      void set() {if (k<end) t=child[k]; else k=-1;}
+    } ;
+
+  private:
+    int        N;
+    const long *cstart;
+    const int  *child;
+
+    friend class CSRGraph;
+  } ;
+
+  typedef Igraph  igraph_t;
+  typedef Hgraph  hgraph_t;
+  typedef Node    hnode_t;
+  typedef Node    inode_t;
+  typedef Arc     iarc_t;
+  typedef Per_arc_weight arc_weight_policy;
+
+  igraph_t igraph;
+  hgraph_t hgraph;
+  double   arc_weight(iarc_t arc) {return weight ? weight[arc.k] : default_arc_weight;}
+  bool     has_arc_weights() const {return weight!=0;}
+  double   uniform_arc_weight() const {return default_arc_weight;}
+  inode_t  random_inode() {return Node(ran(inode_count));}
+  int      id(inode_t n) {return n.i;}
+  inode_t  inode(int id) {return Node(id);}
+
+  template <typename Fun>
+  void     for_each_anode(inode_t,Fun fun);
+
+  hnode_t  hroot;
+  int      inode_count;
+
+  // ends holds the M edges as pairs i,j; weight (M values) can be 0
+  // for uniform weights; parent must cover all nodes, the first N are
+  // individuals
+  static CSRGraph* create(int N,long M,const int *ends,const double *weight,
+			  const std::vector<int>& parent);
+  static CSRGraph* create_square_lattice(int Lx,int Ly);
+  static CSRGraph* load(const char *netfile,const char *groupfile=0,size_t offset=0);
+  void             save(const char *fname);
+  void             save(FILE*);         // at the current position (must be a multiple of 8)
+  virtual ~CSRGraph();
+
+  // parent array for the hierarchy defined by the groups (group[l][n]
+  // is the group of individual n at level l+1)
+  static std::vector<int> groups_to_parent(int N,const std::vector<const int*>& group);
+
+  // Renumbering of the individuals so that neighbours are close in
+  // memory (see csrgraph.cc): newid[i] is the new number of
+  // individual i.  renumbered() returns a copy of the graph with the
+  // new numbers (aggregate nodes keep theirs).
+  enum ordering_t {bfs,rcm,groups};
+  std::vector<int> ordering(ordering_t) const;
+  CSRGraph*        renumbered(const std::vector<int>& newid) const;
+
+protected:
+  CSRGraph(double default_arc_weight=1.);
+  CSRGraph(int N,std::vector<long>& start,std::vector<int>& adj,std::vector<double>& weight,
+	   std::vector<int>& parent,double default_arc_weight=1.);
+  void set_arrays(int N,int Nh,const long *start,const int *adj,const double *weight,
+		  const int *parent);
+  void build_ancestors();
+
+  double          default_arc_weight;
+  Uniform_integer ran;
+
+private:
+  const double        *weight;    // 0 if uniform
+  const int           *parent;
+  const int           *anc;       // ancestor chains (see build_ancestors())
+  const long          *anc_first;
+  int                 anc_depth;  // 0 if not the same for all individuals
+  std::vector<long>   start_v,cstart_v;
+  std::vector<int>    adj_v,parent_v,child_v,anc_v;
+  std::vector<long>   anc_first_v;
+  std::vector<double> weight_v;
+  void                *map;       // mapped CSR graph file (0 if none)
+  size_t              map_size;
+} ;
+
+// Applies a function to all aggregate (hierarchichal) nodes starting at inode.
+template <typename Fun>
+inline void CSRGraph::for_each_anode(inode_t inode,Fun fun)
+{
+  const int *a,*end;
+  if (anc_depth>0) {
+    a=anc+(long) inode.i*anc_depth;
+    end=a+anc_depth;
+  } else {
+    a=anc+anc_first[inode.i];
+    end=anc+anc_first[inode.i+1];
+  }
+  for (; a<end; ++a) fun(Node(*a));
+}
+
+#endif /* CSRGRAPH_HH */
@@ -0,0 +1,73 @@
+/*
+ * ddlattice.hh -- square lattice split in domains for parallel runs
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#ifndef DDLATTICE_HH
+#define DDLATTICE_HH
+
+#include <limits>
+#include <stdexcept>
+
+#include "sqlattice.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// DDLattice
+//
+// An SQLattice divided in ndomains() horizontal strips of consecutive
+// rows (domain d holds rows first_row(d) to first_row(d+1)-1), so that
+// each domain only has contacts with the two neighbouring strips.  It
+// is meant for SEEIIR_model<DDLattice> (ddmodel.hh), which runs each
+// domain in a separate thread.
+
+class DDLattice : public SQLattice {
+public:
+  static DDLattice* create(int Lx,int Ly,bool periodic,int ndomains);
+
+  int  ndomains() const {return ndomains_;}
+  int  first_row(int d) const {return (long) d*Ly_/ndomains_;}
+  int  Lx() const {return Lx_;}
+  int  Ly() const {return Ly_;}
+  bool periodic() const {return periodic_;}
+
+protected:
+  DDLattice(int Lx,int Ly,bool periodic,int ndomains) :
+    SQLattice(Lx,Ly,periodic), ndomains_(ndomains),
+    Lx_(Lx), Ly_(Ly), periodic_(periodic) {}
+
+private:
+  int  ndomains_;
+  int  Lx_,Ly_;
+  bool periodic_;
+} ;
+
+// Sizes as for SQLattice::create(); there can be at most one domain
+// per row
+inline DDLattice* DDLattice::create(int Lx,int Ly,bool periodic,int ndomains)
+{
+  if (Lx<1 || Ly<1 || (periodic && (Lx<3 || Ly<3)))
+    throw std::runtime_error("DDLattice: bad lattice size");
+  if ((long) Lx*Ly>=std::numeric_limits<int>::max())
+    throw std::runtime_error("DDLattice: too many nodes");
+  if (ndomains<1) throw std::runtime_error("DDLattice: bad number of domains");
+  if (ndomains>Ly) ndomains=Ly;
+  return new DDLattice(Lx,Ly,periodic,ndomains);
+}
+
+#endif /* DDLATTICE_HH */
@@ -0,0 +1,595 @@
+/*
+ * ddmodel.cc -- SEEIIR model on the square lattice, run in parallel by
+ *               domain decomposition
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <thread>
+
+#include <gsl/gsl_randist.h>
+
+#include "ddmodel.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Rate_tree
+//
+// Sum tree of the rates of the nodes of a domain (leaves are the
+// nodes, each inner node holds the sum of its children), to choose
+// the next transition in O(log n).  Sums are always recomputed from
+// the children, so the tree depends only on the current rates (which
+// matters when a window is repeated).
+
+namespace {
+
+class Rate_tree {
+public:
+  Rate_tree(int n) {for (size=1; size<n; size*=2) ; t.assign(2*size,0.);}
+  double total() const {return t[1];}
+  void   set(int i,double r);
+  int    find(double u) const;
+
+private:
+  int                 size;
+  std::vector<double> t;
+} ;
+
+inline void Rate_tree::set(int i,double r)
+{
+  int k=size+i;
+  t[k]=r;
+  for (k/=2; k>0; k/=2) t[k]=t[2*k]+t[2*k+1];
+}
+
+// Leaf where the cumulative rate reaches u (0<=u<total()).  Goes
+// right only if the right subtree has a nonzero rate, so that roundoff
+// cannot select a node with zero rate.
+inline int Rate_tree::find(double u) const
+{
+  int k=1;
+  while (k<size) {
+    k*=2;
+    if (u>=t[k] && t[k+1]>0) {u-=t[k]; ++k;}
+  }
+  return k-size;
+}
+
+// Barrier for the threads of run(): spins, then yields (windows can
+// be short, so the threads should not sleep)
+class Spin_barrier {
+public:
+  Spin_barrier(int n) : n(n), waiting(0), phase(0) {}
+  void wait();
+
+private:
+  int              n;
+  std::atomic<int> waiting,phase;
+} ;
+
+void Spin_barrier::wait()
+{
+  int ph=phase.load(std::memory_order_acquire);
+  if (waiting.fetch_add(1,std::memory_order_acq_rel)==n-1) {
+    waiting.store(0,std::memory_order_relaxed);
+    phase.store(ph+1,std::memory_order_release);
+  } else
+    for (int k=0; phase.load(std::memory_order_acquire)==ph; ++k)
+      if (k>1000) std::this_thread::yield();
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Domain
+
+struct SEEIIR_model<DDLattice>::Domain {
+  // A node of a boundary row becomes (on) or stops being infectious
+  struct Message {
+    double time;
+    int    x;
+    bool   on;
+    bool operator==(const Message& m) const {return time==m.time && x==m.x && on==m.on;}
+  } ;
+
+  Domain(SEEIIR_model<DDLattice>& model,int d,unsigned long seed);
+  ~Domain() {gsl_rng_free(rng);}
+
+  SEEIIR_model<DDLattice>  &model;
+  const DDLattice::igraph_t &g;
+  int                       Lx,r0,r1,base,n;
+  int                       row_lo,row_hi;  // rows next to r0 and r1-1 (-1 if none)
+  bool                      has_lo,has_hi;  // ...and they belong to another domain
+  int                       dlo,dhi;        // domains that own them
+
+  std::vector<char>    ghost_lo,ghost_hi;   // whether the ghost nodes are infectious
+  Rate_tree            rates;
+  aggregate_data       count;
+  gsl_rng              *rng;
+
+  // state at the start of the window, and changes since then
+  std::vector<char>    ghost_lo0,ghost_hi0;
+  aggregate_data       count0;
+  std::vector<char>    rng0;
+  std::vector<std::pair<int,char>> undo;    // node and previous state
+  bool                 ghosts_changed;
+
+  std::vector<Message> out_lo,out_hi;       // changes of rows r0 and r1-1 in the window
+  std::vector<Message> in_lo,in_hi;         // ghost changes assumed in the window
+
+  bool own(int y) const {return y>=r0 && y<r1;}
+  static bool infectious(char s) {return s==I1 || s==I2;}
+  bool infectious_at(int j) const;
+  void compute_rate(int i);
+  void compute_rates_around(int i);
+  void ghost_change(int row,std::vector<char>& ghost,const Message&);
+  void transition(int i,double t);
+
+  void reset();
+  void resync();
+  void begin_window();
+  void simulate(double T0,double T1);
+  bool receive();
+  void rollback();
+} ;
+
+SEEIIR_model<DDLattice>::Domain::Domain(SEEIIR_model<DDLattice>& model,int d,
+					unsigned long seed) :
+  model(model),
+  g(model.egraph.igraph),
+  Lx(model.egraph.Lx()),
+  r0(model.egraph.first_row(d)),
+  r1(model.egraph.first_row(d+1)),
+  base(r0*Lx),
+  n((r1-r0)*Lx),
+  rates(n)
+{
+  DDLattice &lat=model.egraph;
+  int D=lat.ndomains();
+  row_lo= r0>0 ? r0-1 : (lat.periodic() ? lat.Ly()-1 : -1);
+  row_hi= r1<lat.Ly() ? r1 : (lat.periodic() ? 0 : -1);
+  has_lo= row_lo>=0 && !own(row_lo);
+  has_hi= row_hi>=0 && !own(row_hi);
+  dlo=(d+D-1)%D;
+  dhi=(d+1)%D;
+  ghost_lo.assign(has_lo ? Lx : 0,0);
+  ghost_hi.assign(has_hi ? Lx : 0,0);
+  rng=gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(rng,seed);
+  rng0.resize(gsl_rng_size(rng));
+}
+
+// j is a neighbour of a node of the domain
+inline bool SEEIIR_model<DDLattice>::Domain::infectious_at(int j) const
+{
+  int y=j/Lx;
+  if (own(y)) return infectious(model.state[j]);
+  if (has_lo && y==row_lo) return ghost_lo[j-y*Lx];
+  return ghost_hi[j-y*Lx];
+}
+
+void SEEIIR_model<DDLattice>::Domain::compute_rate(int i)
+{
+  double rate=0;
+  switch(model.state[i]) {
+  case S: {
+    int x=i%Lx, y=i/Lx, ninf=0;
+    for (int k=0; k<4; ++k) {
+      int j=g.neighbour(i,x,y,k);
+      if (j>=0) ninf+=infectious_at(j);
+    }
+    rate=model.beta*(ninf*model.egraph.uniform_arc_weight());
+    break;
+  }
+  case E1:
+    rate=model.sigma1;
+    break;
+  case E2:
+    rate=model.sigma2;
+    break;
+  case I1:
+    rate=model.gamma1;
+    break;
+  case I2:
+    rate=model.gamma2;
+    break;
+  }
+  rates.set(i-base,rate);
+}
+
+// Rates of i and of its neighbours in the domain
+void SEEIIR_model<DDLattice>::Domain::compute_rates_around(int i)
+{
+  int x=i%Lx, y=i/Lx;
+  compute_rate(i);
+  for (int k=0; k<4; ++k) {
+    int j=g.neighbour(i,x,y,k);
+    if (j>=0 && own(j/Lx)) compute_rate(j);
+  }
+}
+
+void SEEIIR_model<DDLattice>::Domain::ghost_change(int row,std::vector<char>& ghost,
+						   const Message& m)
+{
+  int j=row*Lx+m.x;
+  ghost[m.x]=m.on;
+  ghosts_changed=true;
+  for (int k=0; k<4; ++k) {
+    int i=g.neighbour(j,m.x,row,k);
+    if (i>=0 && own(i/Lx)) compute_rate(i);
+  }
+}
+
+void SEEIIR_model<DDLattice>::Domain::transition(int i,double t)
+{
+  char s=model.state[i];
+  undo.push_back(std::make_pair(i,s));
+  bool change=false;
+
+  switch(s) {
+  case S:
+    model.state[i]=E1;
+    count.NS--; count.NE1++; count.Eacc++;
+    break;
+  case E1:
+    model.state[i]=E2;
+    count.NE1--; count.NE2++;
+    break;
+  case E2:
+    model.state[i]=I1;
+    count.inf_accum++; count.inf_close++; count.NE2--; count.NI1++;
+    change=true;
+    break;
+  case I1:
+    model.state[i]=I2;
+    count.NI1--; count.NI2++;
+    break;
+  case I2:
+    model.state[i]=R;
+    count.NI2--; count.NR++;
+    change=true;
+    break;
+  }
+
+  if (!change) {
+    compute_rate(i);
+    return;
+  }
+  compute_rates_around(i);
+  int y=i/Lx;
+  if (has_lo && y==r0) out_lo.push_back(Message{t,i-y*Lx,s==E2});
+  if (has_hi && y==r1-1) out_hi.push_back(Message{t,i-y*Lx,s==E2});
+}
+
+void SEEIIR_model<DDLattice>::Domain::reset()
+{
+  for (int i=base; i<base+n; ++i) model.state[i]=S;
+  memset(&count,0,sizeof(count));
+  count.Ntot=count.NS=n;
+}
+
+// Read the ghost rows from the other domains, and recompute all the
+// rates (after set_all_susceptible() or the events)
+void SEEIIR_model<DDLattice>::Domain::resync()
+{
+  for (int x=0; x<(int) ghost_lo.size(); ++x)
+    ghost_lo[x]=infectious(model.state[row_lo*Lx+x]);
+  for (int x=0; x<(int) ghost_hi.size(); ++x)
+    ghost_hi[x]=infectious(model.state[row_hi*Lx+x]);
+  for (int i=base; i<base+n; ++i)
+    compute_rate(i);
+}
+
+void SEEIIR_model<DDLattice>::Domain::begin_window()
+{
+  ghost_lo0=ghost_lo;
+  ghost_hi0=ghost_hi;
+  count0=count;
+  memcpy(rng0.data(),gsl_rng_state(rng),rng0.size());
+  undo.clear();
+  ghosts_changed=false;
+  in_lo.clear();
+  in_hi.clear();
+}
+
+// Simulate from T0 to T1, with the ghost changes in in_lo and in_hi.
+// A time step drawn past the next ghost change or the end of the
+// window is discarded (the process is Markovian), so the trajectory up
+// to time t does not depend on the ghost changes after t.
+void SEEIIR_model<DDLattice>::Domain::simulate(double T0,double T1)
+{
+  const double inf=std::numeric_limits<double>::infinity();
+  size_t a=0,b=0;
+  double t=T0;
+
+  out_lo.clear();
+  out_hi.clear();
+  for (;;) {
+    double ta= a<in_lo.size() ? in_lo[a].time : inf;
+    double tb= b<in_hi.size() ? in_hi[b].time : inf;
+    double tin=std::min(std::min(ta,tb),T1);
+    double total=rates.total();
+    double tnext= total>0 ? t+gsl_ran_exponential(rng,1./total) : inf;
+    if (tnext>=tin) {
+      if (ta<=tb && ta<T1) {t=ta; ghost_change(row_lo,ghost_lo,in_lo[a++]);}
+      else if (tb<T1) {t=tb; ghost_change(row_hi,ghost_hi,in_hi[b++]);}
+      else break;
+      continue;
+    }
+    t=tnext;
+    transition(base+rates.find(gsl_rng_uniform(rng)*total),t);
+  }
+}
+
+// Take the changes the neighbours sent in the window; true if they
+// differ from those assumed
+bool SEEIIR_model<DDLattice>::Domain::receive()
+{
+  bool changed=false;
+  if (has_lo && model.domain[dlo]->out_hi!=in_lo) {
+    in_lo=model.domain[dlo]->out_hi;
+    changed=true;
+  }
+  if (has_hi && model.domain[dhi]->out_lo!=in_hi) {
+    in_hi=model.domain[dhi]->out_lo;
+    changed=true;
+  }
+  return changed;
+}
+
+// Back to the start of the window
+void SEEIIR_model<DDLattice>::Domain::rollback()
+{
+  for (auto u=undo.rbegin(); u!=undo.rend(); ++u)
+    model.state[u->first]=u->second;
+  for (auto &u: undo)
+    compute_rates_around(u.first);
+  undo.clear();
+  if (ghosts_changed) {
+    ghost_lo=ghost_lo0;
+    ghost_hi=ghost_hi0;
+    for (int x=0; x<Lx; ++x) {
+      compute_rate(base+x);
+      compute_rate(base+n-Lx+x);
+    }
+    ghosts_changed=false;
+  }
+  count=count0;
+  memcpy(gsl_rng_state(rng),rng0.data(),rng0.size());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SEEIIR model
+
+SEEIIR_model<DDLattice>::SEEIIR_model(DDLattice& egraph) :
+  hroot(egraph.hroot),
+  anodemap(egraph.hgraph,0),
+  windows(0),
+  repeats(0),
+  egraph(egraph),
+  state(egraph.inode_count,S),
+  resync(true)
+{
+  anodemap[hroot]=new aggregate_data;
+  Uniform_integer ran;
+  for (int d=0; d<egraph.ndomains(); ++d)
+    domain.push_back(new Domain(*this,d,ran.raw()));
+  set_rate_constants(1.,1.,1.,1.,1.);
+  set_all_susceptible();
+}
+
+SEEIIR_model<DDLattice>::~SEEIIR_model()
+{
+  for (Domain *d: domain) delete d;
+  delete anodemap[hroot];
+}
+
+void SEEIIR_model<DDLattice>::set_all_susceptible()
+{
+  for (Domain *d: domain) d->reset();
+  resync=true;
+  sum_counts();
+}
+
+void SEEIIR_model<DDLattice>::set_rate_constants(double beta_,double sigma1_,
+						 double sigma2_,double gamma1_,double gamma2_)
+{
+  beta=beta_;
+  sigma1=sigma1_;
+  sigma2=sigma2_;
+  gamma1=gamma1_;
+  gamma2=gamma2_;
+}
+
+// The domains recompute their rates at the start of the next window
+void SEEIIR_model<DDLattice>::compute_all_rates()
+{
+  resync=true;
+}
+
+void SEEIIR_model<DDLattice>::apply_transition(int)
+{
+  throw std::runtime_error("SEEIIR_model<DDLattice>: transitions are applied by the domains");
+}
+
+void SEEIIR_model<DDLattice>::sum_counts()
+{
+  aggregate_data *a=anodemap[hroot];
+  memset(a,0,sizeof(*a));
+  for (Domain *d: domain) {
+    a->Ntot+=d->count.Ntot;
+    a->NS+=d->count.NS;
+    a->NE1+=d->count.NE1;
+    a->NE2+=d->count.NE2;
+    a->NI1+=d->count.NI1;
+    a->NI2+=d->count.NI2;
+    a->NR+=d->count.NR;
+    a->inf_accum+=d->count.inf_accum;
+    a->inf_imported+=d->count.inf_imported;
+    a->inf_close+=d->count.inf_close;
+    a->inf_community+=d->count.inf_community;
+    a->Eacc+=d->count.Eacc;
+  }
+}
+
+// Called between windows, from a single thread
+void SEEIIR_model<DDLattice>::add_imported(Forced_transition* ii)
+{
+  sum_counts();
+  if (ii->new_infected+ii->new_recovered > anodemap[hroot]->NS)
+    throw std::runtime_error("Too many imported infections");
+
+  auto owner=[this](int i) -> aggregate_data&
+    {int y=i/egraph.Lx(), d=0;
+      while (y>=egraph.first_row(d+1)) ++d;
+      return domain[d]->count;};
+  int i;
+  for (int k=0; k<ii->new_infected; ++k) {
+    do i=egraph.random_inode().i; while (state[i]!=S);
+    state[i]=I1;
+    aggregate_data &c=owner(i);
+    c.NS--; c.NI1++; c.inf_imported++; c.inf_accum++;
+  }
+  for (int k=0; k<ii->new_recovered; ++k) {
+    do i=egraph.random_inode().i; while (state[i]!=S);
+    state[i]=R;
+    aggregate_data &c=owner(i);
+    c.NS--; c.NR++;
+  }
+  resync=true;
+  sum_counts();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// run()
+//
+// One thread per domain.  Between windows, thread 0 alone applies the
+// events, adds up the counts and calls the sampler; then all the
+// threads simulate the window, exchange boundary changes and repeat it
+// until no domain receives anything new.
+
+bool run(SEEIIR_model<DDLattice> *model,Sampler* sampler,event_queue_t& events,double tmax,
+	 double deltat)
+{
+  typedef SEEIIR_model<DDLattice>::Domain Domain;
+  const double inf=std::numeric_limits<double>::infinity();
+  std::vector<Domain*> &domain=model->domain;
+  int D=domain.size();
+
+  event_queue_t levents=events;
+  int pending_infections=0;
+  for (event_queue_t q=events; !q.empty(); q.pop())
+    if (q.front()->infects()) ++pending_infections;
+  model->set_all_susceptible();
+  model->compute_all_rates();
+  model->windows=model->repeats=0;
+
+  double             T=0,T1=0;
+  double             window=deltat/8;
+  long               kgrid=0;          // next sampling time is kgrid*deltat
+  bool               done=false;
+  bool               extinct=false;
+  std::atomic<int>   changed[2];
+  std::atomic<long>  repeats(0);
+  std::exception_ptr error;
+  Spin_barrier       barrier(D);
+  changed[0]=changed[1]=0;
+
+  auto worker=[&](int d) {
+    Domain *dom=domain[d];
+    for (;;) {
+
+      if (d==0) {
+	try {
+	  while (!levents.empty() && levents.front()->time<=T) {
+	    if (levents.front()->infects()) --pending_infections;
+	    levents.front()->apply(model);
+	    levents.pop();
+	  }
+	  model->sum_counts();
+	  if (pending_infections==0 && model->extinct())   // absorbing state
+	    extinct=true;
+	  sampler->sample(std::nextafter(T,inf));
+	  if (T>=tmax) done=true;
+	  else {
+	    while (kgrid*deltat<=T) ++kgrid;
+	    T1=std::min(std::min(T+window,kgrid*deltat),tmax);
+	    if (!levents.empty()) T1=std::min(T1,levents.front()->time);
+	    model->windows++;
+	  }
+	} catch (...) {
+	  error=std::current_exception();
+	  done=true;
+	}
+      }
+      barrier.wait();
+      if (done) return;
+
+      if (model->resync) {    // the neighbours must not start before we read their rows
+	dom->resync();
+	barrier.wait();
+      }
+      dom->begin_window();
+      bool again=true;
+      for (int it=0; ; ++it) {
+	if (again) {
+	  if (it>0) {
+	    dom->rollback();
+	    repeats++;
+	  }
+	  dom->simulate(T,T1);
+	}
+	barrier.wait();
+	if (d==0) {
+	  model->resync=false;
+	  changed[(it+1)&1]=0;
+	}
+	again=dom->receive();
+	if (again) changed[it&1]++;
+	barrier.wait();
+	if (changed[it&1]==0) break;
+      }
+
+      // Shorter windows if many domains had to repeat them, longer if few
+      if (d==0) {
+	double frac=(double) repeats/D;
+	model->repeats+=repeats;
+	repeats=0;
+	if (frac>0.5) window*=0.7;
+	else if (frac<0.15) window=std::min(1.3*window,deltat);
+	T=T1;
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int d=1; d<D; ++d)
+    threads.push_back(std::thread(worker,d));
+  worker(0);
+  for (auto &t: threads) t.join();
+  model->sum_counts();
+  if (error) std::rethrow_exception(error);
+  return extinct;
+}
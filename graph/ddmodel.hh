@@ -0,0 +1,108 @@
+/*
+ * ddmodel.hh -- SEEIIR model on the square lattice, run in parallel by
+ *               domain decomposition
+ *
+ * Each domain of the DDLattice (a strip of rows) is simulated by its
+ * own thread, with its own rates and random number stream, during a
+ * time window.  The only coupling between domains is through the
+ * infectious state of the nodes on the rows next to the boundaries:
+ * a domain simulates the window taking the boundary rows of its
+ * neighbours (ghost rows) as given, and sends the times at which its
+ * own boundary nodes become or stop being infectious.  If what a
+ * domain received differs from what it assumed, it goes back to the
+ * start of the window (restoring its states and random number stream)
+ * and simulates it again with the new ghost history, until no domain
+ * changes.
+ *
+ * The result is exact, not an approximation: a domain's trajectory up
+ * to time t depends only on its random numbers and on the ghost
+ * changes before t, so each iteration fixes at least the next
+ * boundary change in time, and the fixed point is a trajectory of the
+ * full Markov process.  The window length only affects efficiency,
+ * and is adapted during the run so that few domains need to repeat
+ * the window.
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#ifndef DDMODEL_HH
+#define DDMODEL_HH
+
+#include "ddlattice.hh"
+#include "seirmodel.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SEEIIR model
+
+template<>
+class SEEIIR_model<DDLattice> : public Epidemiological_model {
+public:
+  SEEIIR_model(DDLattice&);
+  ~SEEIIR_model();
+  void set_all_susceptible();
+  void apply_transition(int);        // not used: see run() below
+  void compute_all_rates();
+  void add_imported(Forced_transition*);
+  void set_rate_constants(double beta,double sigma1,double sigma2,double gamma1,
+			  double gamma2);
+
+  double tinf() { return 1./gamma1 + 1./gamma2;}
+  bool   extinct() {                 // valid after sum_counts()
+    aggregate_data *r=anodemap[hroot];
+    return r->NE1+r->NE2+r->NI1+r->NI2==0;
+  }
+
+  struct aggregate_data {
+    int Ntot;
+    int NS,NE1,NE2,NI1,NI2,NR;
+    int inf_accum;
+    int inf_imported,inf_close,inf_community;
+    int Eacc;
+  } ;
+
+  DDLattice::hnode_t                           hroot;
+  DDLattice::hgraph_t::NodeMap<aggregate_data*> anodemap;
+
+  // Statistics of the last run: number of windows, and number of
+  // times a domain had to repeat a window
+  long windows,repeats;
+
+private:
+  enum {S,E1,E2,I1,I2,R};
+
+  struct Domain;
+
+  DDLattice            &egraph;
+  double               beta,sigma1,sigma2,gamma1,gamma2;
+  std::vector<char>    state;         // each domain writes only its own nodes
+  std::vector<Domain*> domain;
+  bool                 resync;        // domains must reread ghosts and recompute rates
+
+  void sum_counts();
+
+  friend bool run(SEEIIR_model<DDLattice>*,Sampler*,event_queue_t&,double,double);
+} ;
+
+// Replaces run() (emodel.hh) for this model.  Windows end at the
+// times of the events and at the times the sampler collects (multiples
+// of deltat, which must be that of the Gillespie_sampler).  Returns
+// true if the epidemic went extinct before tmax, as run().
+bool run(SEEIIR_model<DDLattice> *model,Sampler* sampler,event_queue_t& events,double tmax,
+	 double deltat=1.);
+
+#endif /* DDMODEL_HH */
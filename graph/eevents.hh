@@ -28,6 +28,7 @@ class Event {
 public:
   Event(double time) : time(time)  {}
   virtual void apply(Epidemiological_model*) {}
+  virtual bool infects() const {return false;}   // can bring new infected
 
   double  time;
 } ;
@@ -43,6 +44,7 @@ public:
   Forced_transition(double time,int new_infected,int new_recovered) :
     Event(time), new_infected(new_infected), new_recovered(new_recovered) {}
   void apply(Epidemiological_model*);
+  bool infects() const {return new_infected>0;}
 
   int  new_infected,new_recovered;
 } ;
@@ -33,11 +33,6 @@ Graph_base::~Graph_base()
   delete fgraphp;
 }
 
-double Graph_base::arc_weight(Graph_base::iarc_t arc)
-{
-  return default_arc_weight;
-}
-
 ///////////////////////////////////////////////////////////////////////////////
 //
 // Fully-connected graph
@@ -90,16 +85,6 @@ FCGraph::~FCGraph()
   delete hgraphp;
 }
 
-double FCGraph::arc_weight(iarc_t arc)
-{
-  return default_arc_weight;
-}
-
-double FCGraph::arc_weight(inode_t i,inode_t j)
-{
-  return default_arc_weight;
-}
-
 // FCGraph::~FCGraph()
 // {
 //   delete hmap;
@@ -126,18 +111,6 @@ void MWFCGraph::set_weights_random_multiplicative(double (*betadist)(),double be
   }
 }
 
-double MWFCGraph::arc_weight(iarc_t arc)
-{
-  inode_t i=igraph.source(arc);
-  inode_t j=igraph.target(arc);
-  return wfactor[i]*wfactor[j];
-}
-
-double MWFCGraph::arc_weight(inode_t i,inode_t j)
-{
-  return wfactor[i]*wfactor[j];
-}
-
 ///////////////////////////////////////////////////////////////////////////////
 //
 // Square Lattice
@@ -174,54 +147,3 @@ SQGraph::~SQGraph()
   delete hmap;
   delete imap;
 }
-
-///////////////////////////////////////////////////////////////////////////////
-//
-// Hierarchical fully-connected  graph
-
-// HFCGraph* HFCGraph::create( Lx,int Ly)
-// {
-//   // Build the graph by going down the hierarchy.  The arcs added at
-//   // this point belong only to the hierarchical graph.  Only the
-//   // lowest-level (leaf) nodes belong to the individual graph.  Links
-//   // among individuals will be added later
-
-//   fgraph_t *fgr = new fgraph_t;
-//   fgraph_t::ArcMap<bool> *hmap =   // hierarchical graph has same nodes, less arcs
-//     new fgraph_t::ArcMap<bool>(*fgr,false);
-//   fgraph_t::NodeMap<bool> *imap =   // individual graph has only the individual nodes
-//     new fgraph_t::NodeMap<bool>(*fgr,true);
-//   fgr=build_tree(levels,hmap,imap);
-
-//   // Now add the links among individuals
-  
-//   for (fgraph_t::NodeIt inode(*fgr); inode!=lemon::INVALID; ++inode)gi {
-//     if (inode==hnode) continue;
-//     auto arc=fgr->addArc(hnode,inode);
-//     (*hmap)[arc]=true;
-//   }
-//   igraph_t *igr = new igraph_t(*fgr,*imap);
-//   hgraph_t *hgr = new hgraph_t(*fgr,*hmap);
- 
-//   return new SQGraph(fgr,igr,hgr,hnode,1.,hmap,imap);
-// }
-
-
-// // Recursively build a tree starting at given level
-// node_t HFCGraph::build_tree(int level)
-// {
-//   node_t subtree=fgr->addNode();
-//   (*imap)[subtree]= level==0;
-
-//   if (level>0) {
-//     int M=noffspring(level);
-//     for (int i=0; i<M; ++i) {
-//       node_t n;
-//       n=build_tree(level-1);
-//       auto arc=fgr->addArc(subtree,n);
-//       (*hmap)[arc]=true;
-//     }
-//   }
-
-//   return subtree;
-// }
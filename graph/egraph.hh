@@ -35,6 +35,7 @@
 #include <lemon/adaptors.h>
 
 #include "../qdrandom.hh"
+#include "arcweight.hh"
 
 //typedef lemon::ListDigraph digraph_t;
 typedef lemon::SmartDigraph digraph_t;
@@ -46,7 +47,8 @@ typedef lemon::SmartDigraph digraph_t;
 // Base class for most epidemiological graphs
 //
 // NOTE that the class is written assuming that the graph is static (i.e. links and
-// nodes are not added or deleted during the simulation).
+// nodes are not added or deleted during the simulation).  For contacts that switch
+// on and off on a schedule, see MLGraph (mlgraph.hh).
 //
 // Provides two graphs to the model-implementing classes:
 //
@@ -88,10 +90,12 @@ public:
   typedef typename hgraph_t::Node       hnode_t;
   typedef typename igraph_t::Arc        iarc_t;
   typedef typename igraph_t::Node       inode_t;
+  typedef Uniform_arc_weight            arc_weight_policy;
 
   igraph_t &igraph;               
   hgraph_t &hgraph;
-  virtual  double arc_weight(iarc_t arc);
+  double   arc_weight(iarc_t arc) {return default_arc_weight;}
+  double   uniform_arc_weight() const {return default_arc_weight;}
   inode_t  random_inode();
   int      id(inode_t);            // returns Lemon's unique id 
   inode_t  inode(int id);          // returns a node referenced by id (obtained through id() method)
@@ -119,6 +123,13 @@ protected:
   double                                       default_arc_weight;
   std::vector<inode_t>                         rangemap;  // must build a custom one because Lemon's does not work with graph adaptors
 
+  // Ancestors of each individual node, from its parent up to the root:
+  // those of the node with id n are ancestors[anc_first[n]] to
+  // ancestors[anc_first[n+1]-1]
+  std::vector<hnode_t>                         ancestors;
+  std::vector<int>                             anc_first;
+  void                                         build_ancestors();
+
 } ;
 
 inline Graph_base::Graph_base(fgraph_t* fgraphp,igraph_t* igraphp,hgraph_t* hgraphp,
@@ -132,6 +143,31 @@ inline Graph_base::Graph_base(fgraph_t* fgraphp,igraph_t* igraphp,hgraph_t* hgra
   rangemap.reserve(inode_count);
   for (igraph_t::NodeIt n(igraph); n!=lemon::INVALID; ++n)
     rangemap.push_back(n);
+  build_ancestors();
+}
+
+// Walking up the hierarchy through hgraph means a filtered scan of
+// in-arcs at each level, so it is done once here.  Assumes each node
+// has only one parent (incoming arc) of higher hierarchy.
+inline void Graph_base::build_ancestors()
+{
+  anc_first.assign(fgraph.maxNodeId()+2,0);
+  for (int pass=0; pass<2; ++pass) {
+    for (igraph_t::NodeIt inode(igraph); inode!=lemon::INVALID; ++inode) {
+      int    k=anc_first[fgraph.id(inode)];
+      node_t node=inode;
+      hgraph_t::InArcIt arc(hgraph,node);
+      while ( (arc = hgraph_t::InArcIt(hgraph,node) ) != lemon::INVALID ) {
+	node = hgraph.source(arc);
+	if (pass==0) anc_first[fgraph.id(inode)+1]++;
+	else ancestors[k++]=node;
+      }
+    }
+    if (pass==0) {
+      for (int n=1; n<anc_first.size(); ++n) anc_first[n]+=anc_first[n-1];
+      ancestors.resize(anc_first.back());
+    }
+  }
 }
 
 inline int Graph_base::id(Graph_base::inode_t node)
@@ -150,15 +186,13 @@ inline Graph_base::inode_t Graph_base::random_inode()
 }
 
 // Applies a function to all aggregate (hierarchichal) nodes starting at inode.
-// assumes each node has only one parent (incoming arc) of higher hierarchy
 template <typename Fun>
-void Graph_base::for_each_anode(node_t inode,Fun fun)
+inline void Graph_base::for_each_anode(node_t inode,Fun fun)
 {
-  hgraph_t::InArcIt arc(hgraph,inode);
-  while ( (arc = hgraph_t::InArcIt(hgraph,inode) ) != lemon::INVALID ) {
-    inode = hgraph.source(arc);
-    fun(inode);
-  }    
+  int n=fgraph.id(inode);
+  const hnode_t *a=ancestors.data()+anc_first[n];
+  const hnode_t *end=ancestors.data()+anc_first[n+1];
+  for (; a<end; ++a) fun(*a);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -210,11 +244,13 @@ public:
   typedef lemon::FullGraph              igraph_t;
   typedef typename igraph_t::Arc        iarc_t;
   typedef typename igraph_t::Node       inode_t;
+  typedef Uniform_arc_weight            arc_weight_policy;
 
   igraph_t &igraph;               
   hgraph_t &hgraph;
-  virtual  double arc_weight(iarc_t arc);
-  virtual  double arc_weight(inode_t i,inode_t j);
+  double   arc_weight(iarc_t arc) {return default_arc_weight;}
+  double   arc_weight(inode_t i,inode_t j) {return default_arc_weight;}
+  double   uniform_arc_weight() const {return default_arc_weight;}
   inode_t  random_inode();
   int      id(inode_t);            // returns Lemon's unique id 
   inode_t  inode(int id);          // returns a node referenced by id (obtained through id() method)
@@ -301,9 +337,12 @@ void FCGraph::for_each_anode(inode_t inode,Fun fun)
 
 class MWFCGraph : public FCGraph {
 public:
+  typedef Multiplicative_arc_weight arc_weight_policy;
+
   static MWFCGraph* create(int N);
-  double arc_weight(iarc_t arc);
-  double arc_weight(inode_t i,inode_t j);
+  double arc_weight(iarc_t arc) {return wfactor[igraph.source(arc)]*wfactor[igraph.target(arc)];}
+  double arc_weight(inode_t i,inode_t j) {return wfactor[i]*wfactor[j];}
+  double node_factor(inode_t i) {return wfactor[i];}
   void set_weights_random_multiplicative(double (*betadist)(),double scale);
 
 protected:
@@ -348,28 +387,4 @@ inline SQGraph::SQGraph(fgraph_t* fg,igraph_t* ig,hgraph_t *hg,node_t hroot,doub
 {}
 
 
-///////////////////////////////////////////////////////////////////////////////
-//
-// Hierarchical fully-connected  graph
-
-// class HFCGraph : public Graph_base {
-// public:
-//   static HFCGraph* create(int Lx,int Ly);
-//   ~HFCGraph();
-
-// private:
-//   HFCGraph(fgraph_t* fg,igraph_t* ig,hgraph_t *hg,node_t hroot,double def_arc_w,
-// 	   fgraph_t::ArcMap<bool> *hmap, fgraph_t::NodeMap<bool> *imap);
-
-//   fgraph_t::ArcMap<bool>  *hmap;   // hierarchical graph has same nodes, less arcs
-//   fgraph_t::NodeMap<bool> *imap;  // individual graph has only the individual nodes
-// } ;
-
-// inline HFCGraph::HFCGraph(fgraph_t* fg,igraph_t* ig,hgraph_t *hg,node_t hroot,double def_arc_w,
-// 			  fgraph_t::ArcMap<bool> *hmap, fgraph_t::NodeMap<bool> *imap) : 
-//   Graph_base(fg,ig,hg,hroot,def_arc_w),
-//   hmap(hmap), imap(imap)
-// {}
-
-
 #endif /* EGRAPH_HH */
@@ -19,6 +19,8 @@
  */
 
 #include <limits>
+#include <cmath>
+#include <cstdio>
 
 #include "emodel.hh"
 #include "../qdrandom.hh"
@@ -46,14 +48,24 @@ void Epidemiological_model::update_cumulative_rates()
 //
 // simulation driver: uses a given Epidemiological_model to implement
 // Gillespie dynamics.  Output through a Gillespie_sampler object
+//
+// When there are no infected (nor exposed) and no more infections are
+// to be imported the state is absorbing: the rates are no longer
+// computed and time jumps from one external event to the next (forced
+// recoveries and rate changes still apply).  Returns true in that
+// case.
 
-void run(Epidemiological_model *model,Sampler* sampler,event_queue_t& events,double tmax)
+bool run(Epidemiological_model *model,Sampler* sampler,event_queue_t& events,double tmax)
 {
   Exponential_distribution rexp;
   Uniform_real ran(0,1.);
   double deltat,time=0;
+  bool   extinct=false;
 
   event_queue_t levents=events;
+  int pending_infections=0;
+  for (event_queue_t q=events; !q.empty(); q.pop())
+    if (q.front()->infects()) ++pending_infections;
   Event* last_event=new Event(std::numeric_limits<double>::max());
   levents.push(last_event);
 
@@ -62,10 +74,16 @@ void run(Epidemiological_model *model,Sampler* sampler,event_queue_t& events,dou
 
   while (time<=tmax) {
 
-    // get transition probability and advance time
-    model->update_cumulative_rates();
-    double mutot=model->cumulative_rates.back();
-    deltat=rexp(1./mutot);
+    double mutot=0;
+    if (pending_infections==0 && model->extinct())     // absorbing state
+      extinct=true;
+    else {
+      // get transition probability
+      model->update_cumulative_rates();
+      mutot=model->cumulative_rates.back();
+    }
+    // advance time
+    deltat= mutot>0 ? rexp(1./mutot) : std::numeric_limits<double>::infinity();
     time+=deltat;
 
     if (time>=levents.front()->time) {              // external event: imported infections, etc
@@ -76,6 +94,7 @@ void run(Epidemiological_model *model,Sampler* sampler,event_queue_t& events,dou
 	levents.pop();
 	break;
       }
+      if (levents.front()->infects()) --pending_infections;
       levents.front()->apply(model);
       levents.pop();
 
@@ -91,4 +110,14 @@ void run(Epidemiological_model *model,Sampler* sampler,event_queue_t& events,dou
   }
 
   delete last_event;
+  return extinct;
+}
+
+void print_extinction(std::ostream& o,int extinct,int nruns)
+{
+  double p=(double) extinct/nruns;
+  char buf[200];
+  sprintf(buf,"# Extinct runs: %d of %d, extinction probability %g +- %g\n",extinct,nruns,
+	  p,sqrt(p*(1-p)/nruns));
+  o << buf;
 }
@@ -41,6 +41,7 @@ public:
   virtual void compute_all_rates()=0;
   virtual void set_all_susceptible()=0;
   virtual void add_imported(Forced_transition*)=0;
+  virtual bool extinct() {return false;}   // no infected (nor exposed) left
   void         update_cumulative_rates();
 
   std::vector<double> cumulative_rates;
@@ -85,7 +86,10 @@ void Epidemiological_model_graph_base<EGraph>::compute_all_rates()
   update_cumulative_rates();
 }
 
-void run(Epidemiological_model *model,Sampler* sampler,event_queue_t& events,double tmax);
+// Returns true if the epidemic went extinct before tmax
+bool run(Epidemiological_model *model,Sampler* sampler,event_queue_t& events,double tmax);
+// Prints (as a comment) the fraction of extinct runs and its error
+void print_extinction(std::ostream&,int extinct,int nruns);
 
 
 #endif /* EMODEL_HH */
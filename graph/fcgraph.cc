@@ -0,0 +1,89 @@
+/*
+ * fcgraph.cc -- implicit fully-connected graph
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <iostream>
+#include <stdexcept>
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+#include "fcgraph.hh"
+
+IFCGraph::IFCGraph(int N)
+{
+  igraph.N=N;
+  hgraph.root=N;
+  hroot=Node(N);
+  inode_count=N;
+}
+
+IFCGraph* IFCGraph::create(int N)
+{
+  if (N<1) throw std::runtime_error("IFCGraph: bad number of nodes");
+  return new IFCGraph(N);
+}
+
+void IFCGraph::set_weights_random_multiplicative(double (*betadist)(),double beta_scale)
+{
+  double wnorm=sqrt(beta_scale*inode_count);
+  wfactor.resize(inode_count);
+  for (double &w: wfactor)
+    w=betadist()/wnorm;
+}
+
+// Weights are saved as a 32-byte block with the magic line (padded
+// with newlines), the number of nodes (unsigned long) and the weight
+// factors (doubles) in node order
+
+static const char mwfc_magic[]="COVIDm MWFC weights 1\n";
+
+void IFCGraph::save_weights(FILE *f)
+{
+  char magic[32];
+  memset(magic,'\n',sizeof(magic));
+  memcpy(magic,mwfc_magic,strlen(mwfc_magic));
+  fwrite(magic,1,sizeof(magic),f);
+  unsigned long N=inode_count;
+  fwrite(&N,sizeof(N),1,f);
+  std::vector<double> w(N,1.);
+  if (weighted()) w=wfactor;
+  if (fwrite(w.data(),sizeof(double),N,f)!=N) throw std::runtime_error(strerror(errno));
+}
+
+void IFCGraph::load_weights(const char *fname,size_t offset)
+{
+  FILE *f=fopen(fname,"rb");
+  if (f==0) {
+    std::cerr << "Error opening file (" << fname << ")\n";
+    throw std::runtime_error(strerror(errno));
+  }
+  char magic[32];
+  unsigned long N;
+  fseek(f,offset,SEEK_SET);
+  if (fread(magic,1,sizeof(magic),f)!=sizeof(magic) ||
+      strncmp(magic,mwfc_magic,strlen(mwfc_magic))!=0 ||
+      fread(&N,sizeof(N),1,f)!=1 || N!=inode_count)
+    throw std::runtime_error(std::string(fname)+": weights do not match graph");
+  wfactor.resize(N);
+  if (fread(wfactor.data(),sizeof(double),N,f)!=N)
+    throw std::runtime_error(std::string(fname)+": truncated file");
+  fclose(f);
+}
@@ -0,0 +1,158 @@
+/*
+ * fcgraph.hh -- implicit fully-connected graph
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#ifndef FCGRAPH_HH
+#define FCGRAPH_HH
+
+#include <cstdio>
+#include <vector>
+
+#include <lemon/core.h>
+
+#include "../qdrandom.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// IFCGraph
+//
+// Fully-connected graph of N individuals, with uniform weights or
+// multiplicative weights J_ij = w_i w_j (as MWFCGraph), but without
+// any arcs: the graph only knows the number of individuals and their
+// weight factors w_i.  The models on it (fcmodel.hh) compute the
+// pressure on a susceptible from aggregate sums over the infectious,
+// so igraph offers nodes but no arc iterators.
+//
+// As in SQLattice, all individuals hang from the root, and hgraph
+// holds only the root.
+
+class IFCGraph {
+public:
+  class Node {
+  public:
+    Node() {}
+    explicit Node(int i) : i(i) {}
+    Node(lemon::Invalid) : i(-1) {}
+    bool operator==(Node n) const {return i==n.i;}
+    bool operator!=(Node n) const {return i!=n.i;}
+    bool operator<(Node n) const {return i<n.i;}
+
+    int i;
+  } ;
+
+  // Individual graph (nodes only)
+  class Igraph {
+  public:
+    typedef IFCGraph::Node Node;
+
+    int  id(Node n) const {return n.i;}
+    Node nodeFromId(int i) const {return Node(i);}
+    int  nodeNum() const {return N;}
+
+    template <typename T>
+    class NodeMap : public std::vector<T> {
+    public:
+      NodeMap(const Igraph& g,const T& v=T()) : std::vector<T>(g.N,v) {}
+      T&       operator[](Node n) {return std::vector<T>::operator[](n.i);}
+      const T& operator[](Node n) const {return std::vector<T>::operator[](n.i);}
+    } ;
+
+    class NodeIt : public Node {
+    public:
+      NodeIt(lemon::Invalid) : Node(lemon::INVALID) {}
+      NodeIt(const Igraph& g) : Node(g.N>0 ? 0 : -1), N(g.N) {}
+      NodeIt& operator++() {if (++i==N) i=-1; return *this;}
+    private:
+      int N;
+    } ;
+
+  private:
+    int N;
+
+    friend class IFCGraph;
+  } ;
+
+  // Hierarchical graph (only the root, without arcs)
+  class Hgraph {
+  public:
+    typedef IFCGraph::Node Node;
+
+    int  id(Node n) const {return n.i;}
+    int  nodeNum() const {return 1;}
+
+    template <typename T>
+    class NodeMap {
+    public:
+      NodeMap(const Hgraph&,const T& v=T()) : v(v) {}
+      T&       operator[](Node) {return v;}
+      const T& operator[](Node) const {return v;}
+    private:
+      T v;
+    } ;
+
+    class NodeIt : public Node {
+    public:
+      NodeIt(lemon::Invalid) : Node(lemon::INVALID) {}
+      NodeIt(const Hgraph& g) : Node(g.root) {}
+      NodeIt& operator++() {i=-1; return *this;}
+    } ;
+
+  private:
+    int root;
+
+    friend class IFCGraph;
+  } ;
+
+  typedef Igraph  igraph_t;
+  typedef Hgraph  hgraph_t;
+  typedef Node    hnode_t;
+  typedef Node    inode_t;
+
+  igraph_t igraph;
+  hgraph_t hgraph;
+  double   arc_weight(inode_t i,inode_t j) {return weight_factor(i)*weight_factor(j);}
+  double   weight_factor(inode_t n) {return wfactor.empty() ? 1. : wfactor[n.i];}
+  bool     weighted() const {return !wfactor.empty();}
+  const std::vector<double>& weight_factors() const {return wfactor;}
+  inode_t  random_inode() {return Node(ran(inode_count));}
+  int      id(inode_t n) {return n.i;}
+  inode_t  inode(int id) {return Node(id);}
+
+  template <typename Fun>
+  void     for_each_anode(inode_t,Fun fun) {fun(hroot);}
+
+  hnode_t  hroot;
+  int      inode_count;
+
+  static IFCGraph* create(int N);
+
+  // Weights J_ij = beta_i beta_j / A, with beta_i drawn from betadist()
+  // and A = inode_count * beta_scale (as in MWFCGraph)
+  void set_weights_random_multiplicative(double (*betadist)(),double scale);
+  void save_weights(FILE*);                          // binary, for Graph_cache
+  void load_weights(const char *fname,size_t offset);
+
+protected:
+  IFCGraph(int N);
+
+  Uniform_integer     ran;
+  std::vector<double> wfactor;     // empty for uniform weights (1)
+} ;
+
+#endif /* FCGRAPH_HH */
@@ -0,0 +1,199 @@
+/*
+ * fcmodel.cc -- SIR and SEEIIR models on the implicit fully-connected graph
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include "fcmodel.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SIR model
+//
+// Transition c (one per non-absorbing compartment) moves an
+// individual from compartment c to c+1
+
+SIR_model<IFCGraph>::SIR_model(IFCGraph& egraph) :
+  Epidemiological_model_graph_base<IFCGraph>(egraph),
+  hroot(egraph.hroot),
+  anodemap(egraph.hgraph,new aggregate_node),
+  pop(egraph.inode_count,3,1U<<I,&egraph.weight_factors())
+{
+  transitions.clear();
+  for (int c=S; c<R; ++c)
+    transitions.push_back(Epidemiological_model::transition(-1,0,c));
+  set_all_susceptible();
+}
+
+void SIR_model<IFCGraph>::set_all_susceptible()
+{
+  pop.reset();
+  aggregate_node *anode=anodemap[hroot];
+  anode->NS=egraph.inode_count;
+  anode->NI=anode->NR=0;
+}
+
+void SIR_model<IFCGraph>::compute_all_rates()
+{
+  transitions[S].rate=beta*pop.W_S()*pop.W_I();
+  transitions[I].rate=gamma*pop.count(I);
+  update_cumulative_rates();
+}
+
+void SIR_model<IFCGraph>::move(int i,int c)
+{
+  aggregate_node *anode=anodemap[hroot];
+  switch(pop.state(i)) {
+  case S: anode->NS--; break;
+  case I: anode->NI--; break;
+  }
+  switch(c) {
+  case I: anode->NI++; break;
+  case R: anode->NR++; break;
+  }
+  pop.move(i,c);
+}
+
+void SIR_model<IFCGraph>::apply_transition(int itran)
+{
+  int c=transitions[itran].type;
+  move(pop.pick(c),c+1);
+  compute_all_rates();
+}
+
+void SIR_model<IFCGraph>::add_imported(Forced_transition* ii)
+{
+  IFCGraph::inode_t node;
+
+  if (ii->new_infected > anodemap[hroot]->NS)
+    throw std::runtime_error("Too many infections");
+  for (int i=0; i<ii->new_infected; ++i) {
+    do node=egraph.random_inode(); while(pop.state(node.i)!=S);
+    move(node.i,I);
+  }
+
+  if (ii->new_recovered > anodemap[hroot]->NS)
+    throw std::runtime_error("Too many recovered");
+  for (int i=0; i<ii->new_recovered; ++i) {
+    do node=egraph.random_inode(); while(pop.state(node.i)!=S);
+    move(node.i,R);
+  }
+  compute_all_rates();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SEEIIR model
+
+SEEIIR_model<IFCGraph>::SEEIIR_model(IFCGraph& egraph) :
+  Epidemiological_model_graph_base<IFCGraph>(egraph),
+  hroot(egraph.hroot),
+  anodemap(egraph.hgraph,new aggregate_data),
+  pop(egraph.inode_count,6,(1U<<I1) | (1U<<I2),&egraph.weight_factors())
+{
+  transitions.clear();
+  for (int c=S; c<R; ++c)
+    transitions.push_back(Epidemiological_model::transition(-1,0,c));
+  set_rate_constants(1.,1.,1.,1.,1.);
+  set_all_susceptible();
+}
+
+void SEEIIR_model<IFCGraph>::set_all_susceptible()
+{
+  pop.reset();
+  aggregate_data *anode=anodemap[hroot];
+  anode->Ntot=anode->NS=egraph.inode_count;
+  anode->NE1=anode->NE2=anode->NI1=anode->NI2=anode->NR=0;
+  anode->inf_accum=anode->inf_imported=anode->inf_close=anode->inf_community=0;
+  anode->Eacc=0;
+}
+
+void SEEIIR_model<IFCGraph>::set_rate_constants(double beta_,double sigma1_,
+						 double sigma2_,double gamma1_,double gamma2_)
+{
+  beta=beta_;
+  sigma1=sigma1_;
+  sigma2=sigma2_;
+  gamma1=gamma1_;
+  gamma2=gamma2_;
+}
+
+void SEEIIR_model<IFCGraph>::compute_all_rates()
+{
+  transitions[S].rate=beta*pop.W_S()*pop.W_I();
+  transitions[E1].rate=sigma1*pop.count(E1);
+  transitions[E2].rate=sigma2*pop.count(E2);
+  transitions[I1].rate=gamma1*pop.count(I1);
+  transitions[I2].rate=gamma2*pop.count(I2);
+  update_cumulative_rates();
+}
+
+void SEEIIR_model<IFCGraph>::move(int i,int c)
+{
+  aggregate_data *anode=anodemap[hroot];
+  switch(pop.state(i)) {
+  case S:  anode->NS--; break;
+  case E1: anode->NE1--; break;
+  case E2: anode->NE2--; break;
+  case I1: anode->NI1--; break;
+  case I2: anode->NI2--; break;
+  }
+  switch(c) {
+  case E1: anode->NE1++; break;
+  case E2: anode->NE2++; break;
+  case I1: anode->NI1++; break;
+  case I2: anode->NI2++; break;
+  case R:  anode->NR++; break;
+  }
+  pop.move(i,c);
+}
+
+void SEEIIR_model<IFCGraph>::apply_transition(int itran)
+{
+  int c=transitions[itran].type;
+  aggregate_data *anode=anodemap[hroot];
+  if (c==S) anode->Eacc++;
+  if (c==E2) {
+    anode->inf_accum++;
+    anode->inf_close++;
+  }
+  move(pop.pick(c),c+1);
+  compute_all_rates();
+}
+
+void SEEIIR_model<IFCGraph>::add_imported(Forced_transition* ii)
+{
+  IFCGraph::inode_t node;
+  aggregate_data    *anode=anodemap[hroot];
+
+  if (ii->new_infected > anode->NS)
+    throw std::runtime_error("Too many imported infections");
+  for (int i=0; i<ii->new_infected; ++i) {
+    do node=egraph.random_inode(); while(pop.state(node.i)!=S);
+    move(node.i,I1);
+    anode->inf_imported++;
+    anode->inf_accum++;
+  }
+
+  if (ii->new_recovered > anode->NS)
+    throw std::runtime_error("Too many imported infections");
+  for (int i=0; i<ii->new_recovered; ++i) {
+    do node=egraph.random_inode(); while(pop.state(node.i)!=S);
+    move(node.i,R);
+  }
+  compute_all_rates();
+}
@@ -0,0 +1,117 @@
+/*
+ * fcmodel.hh -- SIR and SEEIIR models on the implicit fully-connected graph
+ *
+ * On a fully-connected graph with multiplicative weights J_ij = w_i
+ * w_j, the infection rate of susceptible i is beta w_i W_I, where
+ * W_I is the sum of the weight factors of the infectious
+ * individuals.  The specializations here keep W_I (and the
+ * corresponding sum W_S over the susceptibles) up to date instead of
+ * scanning arcs, and use one transition per compartment instead of
+ * one per individual: the total rate of infection is beta W_S W_I,
+ * and when it is chosen the individual infected is drawn with
+ * probability w_i/W_S; other transitions pick a uniformly random
+ * member of their compartment.  This is the same process as the
+ * per-individual Gillespie dynamics, but each step costs O(log N)
+ * instead of O(N), so that N=10^7 is feasible.
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#ifndef FCMODEL_HH
+#define FCMODEL_HH
+
+#include "fcgraph.hh"
+#include "compartments.hh"
+#include "sirmodel.hh"
+#include "seirmodel.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SIR model
+
+template<>
+class SIR_model<IFCGraph> : public Epidemiological_model_graph_base<IFCGraph> {
+public:
+  SIR_model(IFCGraph&);
+  ~SIR_model() {delete anodemap[hroot];}
+  void set_all_susceptible();
+  void apply_transition(int);
+  void compute_rates(IFCGraph::inode_t) {compute_all_rates();}
+  void compute_all_rates();
+  void add_imported(Forced_transition*);
+  void set_beta(double b) {beta=b;}
+  void set_gamma(double g) {gamma=g;}
+  bool extinct() {return anodemap[hroot]->NI==0;}
+
+  struct aggregate_node {
+    int  NS,NI,NR;
+  } ;
+
+  IFCGraph::hnode_t                           hroot;
+  IFCGraph::hgraph_t::NodeMap<aggregate_node*> anodemap;
+
+private:
+  enum {S,I,R};
+  double        beta,gamma;
+  Compartments  pop;
+
+  void move(int i,int c);
+} ;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SEEIIR model
+
+template<>
+class SEEIIR_model<IFCGraph> : public Epidemiological_model_graph_base<IFCGraph> {
+public:
+  SEEIIR_model(IFCGraph&);
+  ~SEEIIR_model() {delete anodemap[hroot];}
+  void set_all_susceptible();
+  void apply_transition(int);
+  void compute_rates(IFCGraph::inode_t) {compute_all_rates();}
+  void compute_all_rates();
+  void add_imported(Forced_transition*);
+  void set_rate_constants(double beta,double sigma1,double sigma2,double gamma1,
+			  double gamma2);
+
+  double tinf() { return 1./gamma1 + 1./gamma2;}
+  bool   extinct() {
+    aggregate_data *r=anodemap[hroot];
+    return r->NE1+r->NE2+r->NI1+r->NI2==0;
+  }
+
+  struct aggregate_data {
+    int Ntot;
+    int NS,NE1,NE2,NI1,NI2,NR;
+    int inf_accum;
+    int inf_imported,inf_close,inf_community;
+    int Eacc;
+  } ;
+
+  IFCGraph::hnode_t                           hroot;
+  IFCGraph::hgraph_t::NodeMap<aggregate_data*> anodemap;
+
+private:
+  enum {S,E1,E2,I1,I2,R};
+  double        beta,sigma1,sigma2,gamma1,gamma2;
+  Compartments  pop;
+
+  void move(int i,int c);
+} ;
+
+#endif /* FCMODEL_HH */
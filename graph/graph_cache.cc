@@ -0,0 +1,136 @@
+/*
+ * graph_cache.cc -- keep built graphs in files for later runs
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "graph_cache.hh"
+
+static const char cache_magic[]="COVIDm graph cache 1\n";
+static const size_t magic_size=32;
+
+static size_t pad8(size_t n) {return (n+7)/8*8;}
+
+// FNV-1a hash, to name the files
+static unsigned long long hash_key(const std::string& key)
+{
+  unsigned long long h=14695981039346656037ULL;
+  for (unsigned char c: key) {
+    h^=c;
+    h*=1099511628211ULL;
+  }
+  return h;
+}
+
+Graph_cache::Graph_cache(const std::string& key,Random_number_generator *rng) :
+  key(key),
+  rng(rng),
+  offset_(0)
+{
+  const char *dir=getenv("COVIDM_GRAPH_CACHE");
+  if (dir==0 || *dir==0) return;
+  char buf[40];
+  sprintf(buf,"/graph-%016llx.bin",hash_key(key));
+  fname=std::string(dir)+buf;
+  sprintf(buf,".tmp%ld",(long) getpid());
+  tmpname=fname+buf;
+}
+
+// Check that the file exists and holds the graph for our key; if so,
+// restore the generator and find where the graph begins
+bool Graph_cache::find()
+{
+  if (!enabled()) return false;
+  FILE *f=fopen(fname.c_str(),"rb");
+  if (f==0) return false;
+
+  bool ok=false;
+  char magic[magic_size];
+  unsigned long len;
+  if (fread(magic,1,magic_size,f)==magic_size &&
+      strncmp(magic,cache_magic,strlen(cache_magic))==0 &&
+      fread(&len,sizeof(len),1,f)==1 && len==key.size()) {
+    std::vector<char> fkey(pad8(len));
+    if (fread(fkey.data(),1,fkey.size(),f)==fkey.size() &&
+	key.compare(0,len,fkey.data(),len)==0 &&
+	fread(&len,sizeof(len),1,f)==1 && (len>0)==(rng!=0)) {
+      std::vector<char> state(pad8(len));
+      if (fread(state.data(),1,state.size(),f)==state.size()) {
+	if (rng) {
+	  std::istringstream is(std::string(state.data(),len));
+	  rng->load(is);
+	}
+	offset_=ftell(f);
+	ok=true;
+      }
+    }
+  }
+  fclose(f);
+  return ok;
+}
+
+static void write_padded(FILE *f,const void *data,size_t size)
+{
+  static const char zeros[8]={0};
+  unsigned long len=size;
+  fwrite(&len,sizeof(len),1,f);
+  fwrite(data,1,size,f);
+  fwrite(zeros,1,pad8(size)-size,f);
+}
+
+FILE* Graph_cache::begin_save()
+{
+  FILE *f=fopen(tmpname.c_str(),"wb");
+  if (f==0) {
+    std::cerr << "Error opening file (" << tmpname << ")\n";
+    throw std::runtime_error(strerror(errno));
+  }
+  char magic[magic_size];
+  memset(magic,'\n',magic_size);
+  memcpy(magic,cache_magic,strlen(cache_magic));
+  fwrite(magic,1,magic_size,f);
+  write_padded(f,key.data(),key.size());
+  std::string state;
+  if (rng) {
+    std::ostringstream os;
+    rng->save(os);
+    state=os.str();
+  }
+  write_padded(f,state.data(),state.size());
+  return f;
+}
+
+void Graph_cache::end_save(FILE *f)
+{
+  bool err=ferror(f);
+  if (fclose(f)!=0) err=true;
+  if (err || rename(tmpname.c_str(),fname.c_str())!=0) {
+    unlink(tmpname.c_str());
+    std::cerr << "Error writing graph cache (" << fname << ")\n";
+    throw std::runtime_error(strerror(errno));
+  }
+}
@@ -0,0 +1,83 @@
+/*
+ * graph_cache.hh -- keep built graphs in files for later runs
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#ifndef GRAPH_CACHE_HH
+#define GRAPH_CACHE_HH
+
+#include <cstdio>
+#include <string>
+
+#include "../qdrandom.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Graph_cache
+//
+// When the environment variable COVIDM_GRAPH_CACHE names a directory,
+// programs keep there the graphs they build, so that later runs with
+// the same parameters map them instead of building them again (sweeps
+// launch many short processes on the same network).
+//
+// The key describes the graph completely (type and parameters, and
+// the seed if it is random); the file name is derived from it and the
+// key itself is stored in the file and checked.  For random graphs
+// pass the random number generator: its state after building the
+// graph is stored, and restored when the graph is taken from the
+// cache, so that the rest of the run is the same as without the cache.
+//
+// Usage:
+//
+//   Graph_cache cache(key,&RNG);
+//   if (cache.find()) graph=... read graph from cache.file() at cache.offset()
+//   else {
+//     graph=... build
+//     if (cache.enabled()) {
+//       FILE *f=cache.begin_save();
+//       ... write graph to f
+//       cache.end_save(f);
+//     }
+//   }
+//
+// File layout: a 32-byte block with the magic line "COVIDm graph cache
+// 1" (padded with newlines), then the length of the key (unsigned long)
+// and the key, the length of the generator state and the state, each
+// padded to a multiple of 8 bytes, then the graph.  The file is
+// written under a temporary name and renamed, so that concurrent
+// processes never see a partial file.
+
+class Graph_cache {
+public:
+  Graph_cache(const std::string& key,Random_number_generator *rng=0);
+
+  bool        enabled() const {return !fname.empty();}
+  bool        find();
+  const char* file() const {return fname.c_str();}
+  size_t      offset() const {return offset_;}
+
+  FILE*       begin_save();
+  void        end_save(FILE*);
+
+private:
+  std::string             key,fname,tmpname;
+  Random_number_generator *rng;
+  size_t                  offset_;
+} ;
+
+#endif /* GRAPH_CACHE_HH */
@@ -0,0 +1,81 @@
+/*
+ * hfcgraph.cc -- implicit hierarchical fully-connected graph
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "hfcgraph.hh"
+
+// Groups are added level by level, children after their parent and
+// in the order of their parents, so that a group's descendants are
+// contiguous at each level.  The ranges of individuals are then
+// collected from the families up (children always come after their
+// parent).
+HFCGraph* HFCGraph::create(int levels,int (*noffspring)(int))
+{
+  if (levels<1) throw std::runtime_error("HFCGraph: bad number of levels");
+
+  HFCGraph *g=new HFCGraph;
+  g->levels_=levels;
+  g->level_.push_back(levels);
+  g->parent_.push_back(-1);
+
+  int begin=0;
+  for (int l=levels; l>1; --l) {
+    int end=g->level_.size();
+    for (int p=begin; p<end; ++p) {
+      int M=noffspring(l);
+      if (M<1) throw std::runtime_error("HFCGraph: bad number of offspring");
+      for (int k=0; k<M; ++k) {
+	g->level_.push_back(l-1);
+	g->parent_.push_back(p);
+      }
+    }
+    begin=end;
+  }
+
+  int ngroups=g->level_.size();
+  g->first_.assign(ngroups,std::numeric_limits<int>::max());
+  g->last_.assign(ngroups,0);
+  long N=0;
+  for (int f=begin; f<ngroups; ++f) {
+    int M=noffspring(1);
+    if (M<1) throw std::runtime_error("HFCGraph: bad number of offspring");
+    if (N+M+ngroups>=std::numeric_limits<int>::max())
+      throw std::runtime_error("HFCGraph: too many nodes");
+    g->first_[f]=N;
+    N+=M;
+    g->last_[f]=N;
+    g->family.insert(g->family.end(),M,f);
+  }
+  for (int c=ngroups-1; c>0; --c) {
+    int p=g->parent_[c];
+    g->first_[p]=std::min(g->first_[p],g->first_[c]);
+    g->last_[p]=std::max(g->last_[p],g->last_[c]);
+  }
+
+  g->inode_count=N;
+  g->igraph.N=N;
+  g->hgraph.first=N;
+  g->hgraph.ngroups=ngroups;
+  g->hroot=Node(N);
+  return g;
+}
@@ -0,0 +1,165 @@
+/*
+ * hfcgraph.hh -- implicit hierarchical fully-connected graph
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#ifndef HFCGRAPH_HH
+#define HFCGRAPH_HH
+
+#include <vector>
+
+#include <lemon/core.h>
+
+#include "../qdrandom.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// HFCGraph
+//
+// The population of seeiir_h: individuals grouped in families
+// (level 1), families in neighbourhoods (level 2), and so on up to
+// the root (level L).  Every pair of individuals is in contact, with
+// a strength that depends on the lowest group they share, so as in
+// IFCGraph there are no arcs: the models on it (hfcmodel.hh) compute
+// the pressure in each group from its counts.
+//
+// The tree is built breadth-first, so that the groups of each level
+// are numbered contiguously and the members of any group are the
+// individuals first(g)..last(g)-1.  Individuals are numbered
+// 0..N-1, groups N (the root) onwards; hgraph holds the groups, and
+// each individual knows its family.
+
+class HFCGraph {
+public:
+  class Node {
+  public:
+    Node() {}
+    explicit Node(int i) : i(i) {}
+    Node(lemon::Invalid) : i(-1) {}
+    bool operator==(Node n) const {return i==n.i;}
+    bool operator!=(Node n) const {return i!=n.i;}
+    bool operator<(Node n) const {return i<n.i;}
+
+    int i;
+  } ;
+
+  // Individual graph (nodes only)
+  class Igraph {
+  public:
+    typedef HFCGraph::Node Node;
+
+    int  id(Node n) const {return n.i;}
+    Node nodeFromId(int i) const {return Node(i);}
+    int  nodeNum() const {return N;}
+
+    template <typename T>
+    class NodeMap : public std::vector<T> {
+    public:
+      NodeMap(const Igraph& g,const T& v=T()) : std::vector<T>(g.N,v) {}
+      T&       operator[](Node n) {return std::vector<T>::operator[](n.i);}
+      const T& operator[](Node n) const {return std::vector<T>::operator[](n.i);}
+    } ;
+
+    class NodeIt : public Node {
+    public:
+      NodeIt(lemon::Invalid) : Node(lemon::INVALID) {}
+      NodeIt(const Igraph& g) : Node(g.N>0 ? 0 : -1), N(g.N) {}
+      NodeIt& operator++() {if (++i==N) i=-1; return *this;}
+    private:
+      int N;
+    } ;
+
+  private:
+    int N;
+
+    friend class HFCGraph;
+  } ;
+
+  // Hierarchical graph (the groups, without arcs)
+  class Hgraph {
+  public:
+    typedef HFCGraph::Node Node;
+
+    int  id(Node n) const {return n.i;}
+    int  nodeNum() const {return ngroups;}
+
+    template <typename T>
+    class NodeMap : public std::vector<T> {
+    public:
+      NodeMap(const Hgraph& g,const T& v=T()) : std::vector<T>(g.ngroups,v), first(g.first) {}
+      T&       operator[](Node n) {return std::vector<T>::operator[](n.i-first);}
+      const T& operator[](Node n) const {return std::vector<T>::operator[](n.i-first);}
+    private:
+      int first;
+    } ;
+
+    class NodeIt : public Node {
+    public:
+      NodeIt(lemon::Invalid) : Node(lemon::INVALID) {}
+      NodeIt(const Hgraph& g) : Node(g.first), end(g.first+g.ngroups) {}
+      NodeIt& operator++() {if (++i==end) i=-1; return *this;}
+    private:
+      int end;
+    } ;
+
+  private:
+    int first,ngroups;
+
+    friend class HFCGraph;
+  } ;
+
+  typedef Igraph  igraph_t;
+  typedef Hgraph  hgraph_t;
+  typedef Node    hnode_t;
+  typedef Node    inode_t;
+
+  igraph_t igraph;
+  hgraph_t hgraph;
+  inode_t  random_inode() {return Node(ran(inode_count));}
+  int      id(inode_t n) {return n.i;}
+  inode_t  inode(int id) {return Node(id);}
+
+  // Groups of the individual, from its family up to the root
+  template <typename Fun>
+  void     for_each_anode(inode_t n,Fun fun)
+  {for (int g=family[n.i]; g>=0; g=parent_[g]) fun(Node(inode_count+g));}
+
+  int      levels() const {return levels_;}
+  int      level(hnode_t g) const {return level_[g.i-inode_count];}
+  int      first(hnode_t g) const {return first_[g.i-inode_count];}
+  int      last(hnode_t g) const {return last_[g.i-inode_count];}
+  hnode_t  family_of(inode_t n) const {return Node(inode_count+family[n.i]);}
+
+  hnode_t  hroot;
+  int      inode_count;
+
+  // noffspring(l) gives the number of children of a group of level
+  // l (individuals for l=1); it is called once per group, so it can
+  // return random numbers
+  static HFCGraph* create(int levels,int (*noffspring)(int));
+
+protected:
+  HFCGraph() {}
+
+  int                 levels_;
+  std::vector<int>    level_,parent_,first_,last_;   // per group
+  std::vector<int>    family;                        // per individual
+  Uniform_integer     ran;
+} ;
+
+#endif /* HFCGRAPH_HH */
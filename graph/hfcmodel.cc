@@ -0,0 +1,191 @@
+/*
+ * hfcmodel.cc -- SEEIIR model on the hierarchical fully-connected graph
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include "hfcmodel.hh"
+
+SEEIIR_model<HFCGraph>::SEEIIR_model(HFCGraph& egraph) :
+  Epidemiological_model_graph_base<HFCGraph>(egraph),
+  hroot(egraph.hroot),
+  anodemap(egraph.hgraph,0),
+  beta(egraph.levels()+1),
+  pop(egraph.inode_count,6,(1U<<I1) | (1U<<I2)),
+  infected_pos(egraph.hgraph,-1)
+{
+  for (HFCGraph::hgraph_t::NodeIt hnode(egraph.hgraph); hnode!=lemon::INVALID; ++hnode)
+    anodemap[hnode]=new aggregate_data;
+  set_rate_constants(1.,1.,1.,1.,1.);
+  set_all_susceptible();
+}
+
+SEEIIR_model<HFCGraph>::~SEEIIR_model()
+{
+  for (HFCGraph::hgraph_t::NodeIt hnode(egraph.hgraph); hnode!=lemon::INVALID; ++hnode)
+    delete anodemap[hnode];
+}
+
+void SEEIIR_model<HFCGraph>::set_all_susceptible()
+{
+  pop.reset();
+  for (HFCGraph::hgraph_t::NodeIt hnode(egraph.hgraph); hnode!=lemon::INVALID; ++hnode) {
+    aggregate_data *anode=anodemap[hnode];
+    anode->Ntot=anode->NS=egraph.last(hnode)-egraph.first(hnode);
+    anode->NE1=anode->NE2=anode->NI1=anode->NI2=anode->NR=0;
+    anode->inf_accum=anode->inf_imported=anode->inf_close=anode->inf_community=0;
+    anode->Eacc=0;
+    infected_pos[hnode]=-1;
+  }
+  infected.clear();
+}
+
+void SEEIIR_model<HFCGraph>::set_rate_constants(double beta_,double sigma1_,
+						double sigma2_,double gamma1_,double gamma2_)
+{
+  std::fill(beta.begin(),beta.end(),beta_);
+  sigma1=sigma1_;
+  sigma2=sigma2_;
+  gamma1=gamma1_;
+  gamma2=gamma2_;
+}
+
+void SEEIIR_model<HFCGraph>::set_rate_constants(const std::vector<double>& beta_,
+						double sigma1_,double sigma2_,
+						double gamma1_,double gamma2_)
+{
+  if (beta_.size()!=beta.size())
+    throw std::runtime_error("SEEIIR_model<HFCGraph>: need one beta per level");
+  beta=beta_;
+  sigma1=sigma1_;
+  sigma2=sigma2_;
+  gamma1=gamma1_;
+  gamma2=gamma2_;
+}
+
+// Infection transitions come first, one per group with infectious
+// members (nodeid is the group), then one per compartment
+void SEEIIR_model<HFCGraph>::compute_all_rates()
+{
+  transitions.clear();
+  for (HFCGraph::hnode_t hnode: infected) {
+    aggregate_data *anode=anodemap[hnode];
+    if (anode->Ntot<2) continue;
+    double rate=beta[egraph.level(hnode)]*anode->NS*(anode->NI1+anode->NI2)/(anode->Ntot-1);
+    transitions.push_back(Epidemiological_model::transition(hnode.i,rate,S));
+  }
+  aggregate_data *root=anodemap[hroot];
+  transitions.push_back(Epidemiological_model::transition(-1,sigma1*root->NE1,E1));
+  transitions.push_back(Epidemiological_model::transition(-1,sigma2*root->NE2,E2));
+  transitions.push_back(Epidemiological_model::transition(-1,gamma1*root->NI1,I1));
+  transitions.push_back(Epidemiological_model::transition(-1,gamma2*root->NI2,I2));
+  update_cumulative_rates();
+}
+
+static inline int& compartment_count(SEEIIR_model<HFCGraph>::aggregate_data *anode,int c)
+{
+  switch(c) {
+  case 0:  return anode->NS;
+  case 1:  return anode->NE1;
+  case 2:  return anode->NE2;
+  case 3:  return anode->NI1;
+  case 4:  return anode->NI2;
+  default: return anode->NR;
+  }
+}
+
+// Groups enter or leave the list of infected when their first
+// infectious member arrives or their last one leaves
+void SEEIIR_model<HFCGraph>::move(int i,int c)
+{
+  int  old=pop.state(i);
+  bool was_infectious= old==I1 || old==I2;
+  bool is_infectious= c==I1 || c==I2;
+
+  egraph.for_each_anode(HFCGraph::Node(i),
+    [this,old,c,was_infectious,is_infectious](HFCGraph::hnode_t hnode)
+    {aggregate_data *anode=anodemap[hnode];
+      compartment_count(anode,old)--;
+      compartment_count(anode,c)++;
+      if (was_infectious==is_infectious) return;
+      int NI=anode->NI1+anode->NI2;
+      if (is_infectious && NI==1) {
+	infected_pos[hnode]=infected.size();
+	infected.push_back(hnode);
+      } else if (!is_infectious && NI==0) {
+	HFCGraph::hnode_t last=infected.back();
+	infected[infected_pos[hnode]]=last;
+	infected_pos[last]=infected_pos[hnode];
+	infected.pop_back();
+	infected_pos[hnode]=-1;
+      }
+    });
+  pop.move(i,c);
+}
+
+bool SEEIIR_model<HFCGraph>::close_contact(int i)
+{
+  aggregate_data *family=anodemap[egraph.family_of(HFCGraph::Node(i))];
+  return family->NI1+family->NI2+family->NR>1;
+}
+
+void SEEIIR_model<HFCGraph>::apply_transition(int itran)
+{
+  int c=transitions[itran].type;
+  int i;
+
+  if (c==S) {
+    HFCGraph::hnode_t group(transitions[itran].nodeid);
+    i=pop.pick(S,egraph.first(group),egraph.last(group));
+    egraph.for_each_anode(HFCGraph::Node(i),
+      [this](HFCGraph::hnode_t hnode) {anodemap[hnode]->Eacc++;} );
+  } else
+    i=pop.pick(c);
+  move(i,c+1);
+
+  if (c==E2) {
+    bool close=close_contact(i);
+    egraph.for_each_anode(HFCGraph::Node(i),
+      [this,close](HFCGraph::hnode_t hnode)
+      {aggregate_data *anode=anodemap[hnode];
+	anode->inf_accum++;
+	if (close) anode->inf_close++;
+	else anode->inf_community++; } );
+  }
+  compute_all_rates();
+}
+
+void SEEIIR_model<HFCGraph>::add_imported(Forced_transition* ii)
+{
+  if (ii->new_infected > anodemap[hroot]->NS)
+    throw std::runtime_error("Too many imported infections");
+  for (int n=0; n<ii->new_infected; ++n) {
+    int i=pop.pick(S);
+    move(i,I1);
+    egraph.for_each_anode(HFCGraph::Node(i),
+      [this](HFCGraph::hnode_t hnode)
+      {aggregate_data *anode=anodemap[hnode];
+	anode->inf_imported++;
+	anode->inf_accum++; } );
+  }
+
+  if (ii->new_recovered > anodemap[hroot]->NS)
+    throw std::runtime_error("Too many imported infections");
+  for (int n=0; n<ii->new_recovered; ++n)
+    move(pop.pick(S),R);
+  compute_all_rates();
+}
@@ -0,0 +1,119 @@
+/*
+ * hfcmodel.hh -- SEEIIR model on the hierarchical fully-connected graph
+ *
+ * This is the model of seeiir_h: the infectious individuals of a
+ * group g of level l and size N_g infect each susceptible of g at
+ * rate beta_l/(N_g-1), so that the total rate of infections within g
+ * is beta_l S_g (I1_g+I2_g)/(N_g-1).  There is one infection
+ * transition for each group with infectious members, and one
+ * transition for each of the other compartments, which picks a
+ * uniformly random member.  The infected individual is a random
+ * susceptible of the group, found through a sum tree over the
+ * individuals (as the members of a group are numbered contiguously),
+ * so that each step costs O(number of groups with infectious members
+ * + log N).
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#ifndef HFCMODEL_HH
+#define HFCMODEL_HH
+
+#include "hfcgraph.hh"
+#include "compartments.hh"
+#include "seirmodel.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SEEIIR model
+//
+// Infections are counted as close contact when the infected
+// individual's family has other infected members at the time it
+// becomes infectious, as community infections otherwise (as
+// seeiir_h does).
+
+template<>
+class SEEIIR_model<HFCGraph> : public Epidemiological_model_graph_base<HFCGraph> {
+public:
+  SEEIIR_model(HFCGraph&);
+  ~SEEIIR_model();
+  void set_all_susceptible();
+  void apply_transition(int);
+  void compute_rates(HFCGraph::inode_t) {compute_all_rates();}
+  void compute_all_rates();
+  void add_imported(Forced_transition*);
+  void set_rate_constants(double beta,double sigma1,double sigma2,double gamma1,
+			  double gamma2);
+  // beta[l] for l=1..levels (beta[0] is not used)
+  void set_rate_constants(const std::vector<double>& beta,double sigma1,double sigma2,
+			  double gamma1,double gamma2);
+
+  double tinf() { return 1./gamma1 + 1./gamma2;}
+  bool   extinct() {
+    aggregate_data *r=anodemap[hroot];
+    return r->NE1+r->NE2+r->NI1+r->NI2==0;
+  }
+
+  struct aggregate_data {
+    int Ntot;
+    int NS,NE1,NE2,NI1,NI2,NR;
+    int inf_accum;
+    int inf_imported,inf_close,inf_community;
+    int Eacc;
+  } ;
+
+  HFCGraph::hnode_t                           hroot;
+  HFCGraph::hgraph_t::NodeMap<aggregate_data*> anodemap;
+
+private:
+  enum {S,E1,E2,I1,I2,R};
+  std::vector<double> beta;
+  double              sigma1,sigma2,gamma1,gamma2;
+  Compartments        pop;
+
+  // groups with infectious members, and their position in the list
+  std::vector<HFCGraph::hnode_t>            infected;
+  HFCGraph::hgraph_t::NodeMap<int>          infected_pos;
+
+  void move(int i,int c);
+  bool close_contact(int i);
+} ;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// event: change rate constants (one beta per level)
+
+template<>
+class Rate_constant_change<HFCGraph> : public Event {
+public:
+  Rate_constant_change(double time,const std::vector<double>& beta,double sigma1,
+		       double sigma2,double gamma1,double gamma2) :
+    Event(time), beta(beta), sigma1(sigma1), sigma2(sigma2),
+    gamma1(gamma1), gamma2(gamma2) {}
+  virtual void apply(Epidemiological_model *);
+
+  std::vector<double> beta;
+  double              sigma1,sigma2,gamma1,gamma2;
+} ;
+
+inline void Rate_constant_change<HFCGraph>::apply(Epidemiological_model *em)
+{
+  (dynamic_cast<SEEIIR_model<HFCGraph>*>(em))->set_rate_constants(beta,sigma1,sigma2,gamma1,gamma2);
+  (dynamic_cast<SEEIIR_model<HFCGraph>*>(em))->compute_all_rates();
+}
+
+#endif /* HFCMODEL_HH */
@@ -0,0 +1,67 @@
+/*
+ * mlgraph.cc -- multi-layer contact network
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <stdexcept>
+
+#include "mlgraph.hh"
+
+MLGraph::MLGraph(const std::vector<CSRGraph*>& layers) :
+  igraph(layers.at(0)->igraph),
+  hgraph(layers.at(0)->hgraph),
+  hroot(layers[0]->hroot),
+  inode_count(layers[0]->inode_count),
+  layer(layers),
+  nslots_(0),
+  slot_length_(0)
+{
+  for (CSRGraph *g: layer)
+    if (g->inode_count!=inode_count) {
+      for (CSRGraph *h: layer) delete h;
+      throw std::runtime_error("MLGraph: layers have different numbers of individuals");
+    }
+}
+
+MLGraph* MLGraph::load(const std::vector<std::string>& netfiles,const char *groupfile)
+{
+  if (netfiles.empty()) throw std::runtime_error("MLGraph: no layers");
+  std::vector<CSRGraph*> layers;
+  for (size_t l=0; l<netfiles.size(); ++l)
+    layers.push_back(CSRGraph::load(netfiles[l].c_str(),l==0 ? groupfile : 0));
+  return new MLGraph(layers);
+}
+
+MLGraph::~MLGraph()
+{
+  for (CSRGraph *g: layer) delete g;
+}
+
+void MLGraph::set_schedule(double slot_length,const std::vector<std::vector<char>>& activity_)
+{
+  if (activity_.size()!=layer.size())
+    throw std::runtime_error("MLGraph: need one activity mask per layer");
+  if (slot_length<=0)
+    throw std::runtime_error("MLGraph: slot length must be positive");
+  for (auto &a: activity_)
+    if (a.empty() || a.size()!=activity_[0].size())
+      throw std::runtime_error("MLGraph: activity masks must have the same number of slots");
+  activity=activity_;
+  nslots_=activity[0].size();
+  slot_length_=slot_length;
+}
@@ -0,0 +1,98 @@
+/*
+ * mlgraph.hh -- multi-layer contact network
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#ifndef MLGRAPH_HH
+#define MLGRAPH_HH
+
+#include <string>
+#include <vector>
+
+#include "csrgraph.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// MLGraph
+//
+// A contact network made of several layers (household, workplace,
+// school, community, ...) over the same individuals.  Each layer is a
+// CSRGraph, with its own arcs and weights, so that the contacts of a
+// node within one layer are contiguous.  The hierarchy (and thus
+// hgraph and for_each_anode()) is that of the first layer.
+//
+// igraph is the individual graph of the first layer; the models on
+// MLGraph (mlmodel.hh) use it only to iterate over the individuals,
+// and reach the arcs through layer_igraph().
+//
+// The network can also be temporal: with a periodic schedule of
+// nslots() slots of length slot_length(), every arc of layer l is
+// active during the slots s for which active(l,s) is true (arcs that
+// share an activity mask go in the same layer).  The arcs are never
+// added or removed; the model is told which layers are active through
+// Layer_activity_change events (mlmodel.hh).
+
+class MLGraph {
+public:
+  typedef CSRGraph::Node     Node;
+  typedef CSRGraph::Arc      Arc;
+  typedef CSRGraph::igraph_t igraph_t;
+  typedef CSRGraph::hgraph_t hgraph_t;
+  typedef CSRGraph::hnode_t  hnode_t;
+  typedef CSRGraph::inode_t  inode_t;
+  typedef CSRGraph::iarc_t   iarc_t;
+
+  igraph_t& igraph;
+  hgraph_t& hgraph;
+
+  int             nlayers() const {return layer.size();}
+  const igraph_t& layer_igraph(int l) const {return layer[l]->igraph;}
+  double          arc_weight(int l,iarc_t arc) {return layer[l]->arc_weight(arc);}
+  inode_t         random_inode() {return layer[0]->random_inode();}
+  int             id(inode_t n) {return n.i;}
+  inode_t         inode(int id) {return Node(id);}
+
+  template <typename Fun>
+  void     for_each_anode(inode_t inode,Fun fun) {layer[0]->for_each_anode(inode,fun);}
+
+  // activity[l][s] nonzero if layer l is active in slot s; all layers
+  // are always active if no schedule is set
+  void     set_schedule(double slot_length,const std::vector<std::vector<char>>& activity);
+  int      nslots() const {return nslots_;}
+  double   slot_length() const {return slot_length_;}
+  bool     active(int l,int slot) const {return nslots_==0 || activity[l][slot%nslots_];}
+
+  hnode_t  hroot;
+  int      inode_count;
+
+  // Takes ownership of the layers, which must have the same number of
+  // individuals
+  MLGraph(const std::vector<CSRGraph*>& layers);
+  // The group file (if any) applies to the first layer
+  static MLGraph* load(const std::vector<std::string>& netfiles,const char *groupfile=0);
+  ~MLGraph();
+
+private:
+  std::vector<CSRGraph*> layer;
+
+  int                            nslots_;
+  double                         slot_length_;
+  std::vector<std::vector<char>> activity;
+} ;
+
+#endif /* MLGRAPH_HH */
@@ -0,0 +1,337 @@
+/*
+ * mlmodel.cc -- SEEIIR model on multi-layer contact networks
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include "mlmodel.hh"
+
+SEEIIR_model<MLGraph>::SEEIIR_model(MLGraph& egraph) :
+  Epidemiological_model_graph_base<MLGraph>(egraph),
+  hroot(egraph.hroot),
+  anodemap(egraph.hgraph,0),
+  L(egraph.nlayers()),
+  beta(L),
+  active(L,1),
+  beta_eff(L),
+  inodemap(egraph.igraph),
+  pressure((long) egraph.inode_count*L,0.),
+  ninf(egraph.inode_count,0),
+  infectious_pos(egraph.inode_count,-1),
+  stamp(egraph.inode_count,0),
+  current_stamp(0)
+{
+  transitions.clear();
+  for (MLGraph::igraph_t::NodeIt inode(egraph.igraph); inode!=lemon::INVALID; ++inode) {
+    inodemap[inode].state=SEEIIR_node::S;
+    inodemap[inode].itransition=transitions.size();
+    transitions.push_back(Epidemiological_model::transition(egraph.id(inode),0,0));
+  }
+  set_rate_constants(1.,1.,1.,1.,1.);
+}
+
+SEEIIR_model<MLGraph>::~SEEIIR_model()
+{
+  for (MLGraph::hgraph_t::NodeIt anode(egraph.hgraph); anode!=lemon::INVALID; ++anode)
+    delete anodemap[anode];
+}
+
+void SEEIIR_model<MLGraph>::set_all_susceptible()
+{
+  for (MLGraph::igraph_t::NodeIt inode(egraph.igraph); inode!=lemon::INVALID; ++inode)
+    inodemap[inode].state=SEEIIR_node::S;
+  recompute_counts();
+  recompute_pressure();
+}
+
+void SEEIIR_model<MLGraph>::set_rate_constants(double beta_,double sigma1_,
+					       double sigma2_,double gamma1_,double gamma2_)
+{
+  std::fill(beta.begin(),beta.end(),beta_);
+  for (int l=0; l<L; ++l) beta_eff[l]= active[l] ? beta[l] : 0.;
+  sigma1=sigma1_;
+  sigma2=sigma2_;
+  gamma1=gamma1_;
+  gamma2=gamma2_;
+}
+
+// Rates of exposed and infectious individuals are recomputed only if
+// sigma or gamma change
+void SEEIIR_model<MLGraph>::set_rate_constants(const std::vector<double>& beta_,
+					       double sigma1_,double sigma2_,
+					       double gamma1_,double gamma2_)
+{
+  if (beta_.size()!=L)
+    throw std::runtime_error("SEEIIR_model<MLGraph>: need one beta per layer");
+  if (sigma1_!=sigma1 || sigma2_!=sigma2 || gamma1_!=gamma1 || gamma2_!=gamma2) {
+    sigma1=sigma1_;
+    sigma2=sigma2_;
+    gamma1=gamma1_;
+    gamma2=gamma2_;
+    for (MLGraph::igraph_t::NodeIt inode(egraph.igraph); inode!=lemon::INVALID; ++inode)
+      if (inodemap[inode].state!=SEEIIR_node::S) compute_rates(inode);
+  }
+  for (int l=0; l<L; ++l)
+    set_layer_beta(l,beta_[l]);
+}
+
+void SEEIIR_model<MLGraph>::set_layer_beta(int l,double b)
+{
+  if (b==beta[l]) return;
+  beta[l]=b;
+  if (active[l]) layer_changed(l);
+}
+
+void SEEIIR_model<MLGraph>::set_layer_active(int l,bool a)
+{
+  if (a==(bool) active[l]) return;
+  active[l]=a;
+  layer_changed(l);
+}
+
+// Only susceptibles with infectious neighbours in the layer are
+// affected (the pressure of inactive layers is kept up to date, so
+// nothing else needs to change)
+void SEEIIR_model<MLGraph>::layer_changed(int l)
+{
+  double b= active[l] ? beta[l] : 0.;
+  if (b==beta_eff[l]) return;
+  beta_eff[l]=b;
+  if (++current_stamp==0) {
+    std::fill(stamp.begin(),stamp.end(),0);
+    current_stamp=1;
+  }
+  const MLGraph::igraph_t &lgraph=egraph.layer_igraph(l);
+  for (int j: infectious)
+    for (MLGraph::igraph_t::OutArcIt arc(lgraph,MLGraph::Node(j)); arc!=lemon::INVALID; ++arc) {
+      MLGraph::inode_t i=lgraph.target(arc);
+      if (stamp[i.i]==current_stamp) continue;
+      stamp[i.i]=current_stamp;
+      compute_rates(i);
+    }
+}
+
+void SEEIIR_model<MLGraph>::init_htree(MLGraph::hnode_t lroot)
+{
+  aggregate_data* anode=anodemap[lroot];
+  if (anode==0) {
+    anode=new aggregate_data;
+    anodemap[lroot]=anode;
+  }
+  anode->Ntot=anode->NS=anode->NE1=anode->NE2=anode->NI1=anode->NI2=anode->NR=0;
+  anode->inf_accum=anode->inf_imported=anode->inf_close=anode->inf_community=0;
+  anode->Eacc=0;
+  for (MLGraph::hgraph_t::OutArcIt arc(egraph.hgraph,lroot); arc!=lemon::INVALID; ++arc)
+    init_htree(egraph.hgraph.target(arc));
+}
+
+void SEEIIR_model<MLGraph>::recompute_counts()
+{
+  init_htree(hroot);
+  for (MLGraph::igraph_t::NodeIt inode(egraph.igraph); inode!=lemon::INVALID; ++inode) {
+    auto state=inodemap[inode].state;
+    egraph.for_each_anode(inode,
+      [this,state](MLGraph::hnode_t hnode)
+      {aggregate_data* anode=this->anodemap[hnode];
+	anode->Ntot++;
+	switch(state) {
+	case SEEIIR_node::S:  anode->NS++; break;
+	case SEEIIR_node::E1: anode->NE1++; break;
+	case SEEIIR_node::E2: anode->NE2++; break;
+	case SEEIIR_node::I1: anode->NI1++; break;
+	case SEEIIR_node::I2: anode->NI2++; break;
+	case SEEIIR_node::R:  anode->NR++; break;
+	} } );
+  }
+}
+
+// Rebuild the list of infectious individuals and the pressures from
+// the states
+void SEEIIR_model<MLGraph>::recompute_pressure()
+{
+  infectious.clear();
+  std::fill(infectious_pos.begin(),infectious_pos.end(),-1);
+  std::fill(pressure.begin(),pressure.end(),0.);
+  std::fill(ninf.begin(),ninf.end(),0);
+  for (MLGraph::igraph_t::NodeIt j(egraph.igraph); j!=lemon::INVALID; ++j) {
+    if (!is_infectious(j)) continue;
+    infectious_pos[j.i]=infectious.size();
+    infectious.push_back(j.i);
+    for (int l=0; l<L; ++l) {
+      const MLGraph::igraph_t &lgraph=egraph.layer_igraph(l);
+      for (MLGraph::igraph_t::OutArcIt arc(lgraph,j); arc!=lemon::INVALID; ++arc) {
+	int i=lgraph.target(arc).i;
+	pressure[(long) i*L+l]+=egraph.arc_weight(l,arc);
+	ninf[i]++;
+      }
+    }
+  }
+}
+
+void SEEIIR_model<MLGraph>::compute_all_rates()
+{
+  recompute_pressure();
+  for (MLGraph::igraph_t::NodeIt inode(egraph.igraph); inode!=lemon::INVALID; ++inode)
+    compute_rates(inode);
+  update_cumulative_rates();
+}
+
+void SEEIIR_model<MLGraph>::compute_rates(MLGraph::inode_t node)
+{
+  auto   &noded=inodemap[node];
+  double rate=0;
+
+  switch(noded.state) {
+  case SEEIIR_node::S: {
+    const double *P=pressure.data()+(long) node.i*L;
+    for (int l=0; l<L; ++l) rate+=beta_eff[l]*P[l];
+    break;
+  }
+  case SEEIIR_node::E1:
+    rate=sigma1;
+    break;
+  case SEEIIR_node::E2:
+    rate=sigma2;
+    break;
+  case SEEIIR_node::I1:
+    rate=gamma1;
+    break;
+  case SEEIIR_node::I2:
+    rate=gamma2;
+    break;
+  case SEEIIR_node::R:
+    rate=0;
+    break;
+  }
+
+  transitions[noded.itransition].rate=rate;
+}
+
+// Add (or remove) the weights of the arcs of j to the pressure of its
+// neighbours, then recompute their rates
+void SEEIIR_model<MLGraph>::set_infectious(MLGraph::inode_t j,bool on)
+{
+  if (on) {
+    infectious_pos[j.i]=infectious.size();
+    infectious.push_back(j.i);
+  } else {
+    int last=infectious.back();
+    infectious[infectious_pos[j.i]]=last;
+    infectious_pos[last]=infectious_pos[j.i];
+    infectious.pop_back();
+    infectious_pos[j.i]=-1;
+  }
+
+  int sign= on ? 1 : -1;
+  for (int l=0; l<L; ++l) {
+    const MLGraph::igraph_t &lgraph=egraph.layer_igraph(l);
+    for (MLGraph::igraph_t::OutArcIt arc(lgraph,j); arc!=lemon::INVALID; ++arc) {
+      int i=lgraph.target(arc).i;
+      pressure[(long) i*L+l]+=sign*egraph.arc_weight(l,arc);
+      if ((ninf[i]+=sign)==0)
+	std::fill(pressure.begin()+(long) i*L,pressure.begin()+(long) (i+1)*L,0.);
+    }
+  }
+  for (int l=0; l<L; ++l) {
+    const MLGraph::igraph_t &lgraph=egraph.layer_igraph(l);
+    for (MLGraph::igraph_t::OutArcIt arc(lgraph,j); arc!=lemon::INVALID; ++arc)
+      compute_rates(lgraph.target(arc));
+  }
+}
+
+void SEEIIR_model<MLGraph>::apply_transition(int itran)
+{
+  auto node=egraph.inode(transitions[itran].nodeid);
+  auto &noded=inodemap[node];
+
+  switch(noded.state) {
+  case SEEIIR_node::S:
+    noded.state=SEEIIR_node::E1;
+    egraph.for_each_anode(node,
+			  [this](MLGraph::hnode_t hnode) ->void
+			  {aggregate_data* anode=this->anodemap[hnode]; anode->NS--; anode->NE1++; anode->Eacc++;} );
+    break;
+
+  case SEEIIR_node::E1:
+    noded.state=SEEIIR_node::E2;
+    egraph.for_each_anode(node,
+			  [this](MLGraph::hnode_t hnode) ->void
+			  {aggregate_data* anode=this->anodemap[hnode]; anode->NE1--; anode->NE2++;} );
+    break;
+
+  case SEEIIR_node::E2:
+    noded.state=SEEIIR_node::I1;
+    egraph.for_each_anode(node,
+			  [this](MLGraph::hnode_t hnode) ->void
+			  {aggregate_data* anode=this->anodemap[hnode]; anode->inf_accum++; anode->inf_close++; anode->NE2--; anode->NI1++;} );
+    set_infectious(node,true);
+    break;
+
+  case SEEIIR_node::I1:
+    noded.state=SEEIIR_node::I2;
+    egraph.for_each_anode(node,
+			  [this](MLGraph::hnode_t hnode) ->void
+			  {aggregate_data* anode=this->anodemap[hnode]; anode->NI1--; anode->NI2++;} );
+    break;
+
+  case SEEIIR_node::I2:
+    noded.state=SEEIIR_node::R;
+    egraph.for_each_anode(node,
+			  [this](MLGraph::hnode_t hnode) ->void
+			  {aggregate_data* anode=this->anodemap[hnode]; anode->NI2--; anode->NR++;} );
+    set_infectious(node,false);
+    break;
+
+  case SEEIIR_node::R:
+    std::cerr << "Internal error: should not be R\n";
+    I_AM_HERE;
+    exit(10);
+    break;
+  }
+
+  compute_rates(node);
+}
+
+void SEEIIR_model<MLGraph>::add_imported(Forced_transition* ii)
+{
+  MLGraph::inode_t node;
+
+  if (ii->new_infected > anodemap[hroot]->NS)
+    throw std::runtime_error("Too many imported infections");
+  for (int i=0; i<ii->new_infected; ++i) {
+    do node=egraph.random_inode(); while(inodemap[node].state!=SEEIIR_node::S);
+    inodemap[node].state=SEEIIR_node::I1;
+    egraph.for_each_anode(node,
+		   [this](MLGraph::hnode_t hnode)
+		   {aggregate_data* anode=this->anodemap[hnode];
+		     anode->NS--; anode->NI1++; anode->inf_imported++; anode->inf_accum++; }  );
+    set_infectious(node,true);
+    compute_rates(node);
+  }
+
+  if (ii->new_recovered > anodemap[hroot]->NS)
+    throw std::runtime_error("Too many imported infections");
+  for (int i=0; i<ii->new_recovered; ++i) {
+    do node=egraph.random_inode(); while(inodemap[node].state!=SEEIIR_node::S);
+    inodemap[node].state=SEEIIR_node::R;
+    egraph.for_each_anode(node,
+		   [this](MLGraph::hnode_t hnode)
+		   {aggregate_data* anode=this->anodemap[hnode];
+		     anode->NS--; anode->NR++; }  );
+    compute_rates(node);
+  }
+}
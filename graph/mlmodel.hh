@@ -0,0 +1,153 @@
+/*
+ * mlmodel.hh -- SEEIIR model on multi-layer contact networks
+ *
+ * Each layer l has its own transmission rate beta_l, so that the
+ * infection rate of a susceptible i is sum_l beta_l P_il, where the
+ * pressure P_il is the sum of the weights of its layer-l arcs to
+ * infectious individuals.  The pressures are cached and updated
+ * through the arcs of individuals that become or stop being
+ * infectious, so that changing beta_l (e.g. closing schools) only
+ * recomputes the rates of the susceptibles that have infectious
+ * neighbours in layer l, instead of all the rates.  Switching a layer
+ * on or off (temporal networks) is done the same way, at a cost
+ * proportional to the arcs of the layer, without rebuilding the graph.
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#ifndef MLMODEL_HH
+#define MLMODEL_HH
+
+#include "mlgraph.hh"
+#include "seirmodel.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SEEIIR model
+
+template<>
+class SEEIIR_model<MLGraph> : public Epidemiological_model_graph_base<MLGraph> {
+public:
+  SEEIIR_model(MLGraph&);
+  ~SEEIIR_model();
+  void set_all_susceptible();
+  void apply_transition(int);
+  void compute_rates(MLGraph::inode_t);
+  void compute_all_rates();
+  void add_imported(Forced_transition*);
+  void set_rate_constants(double beta,double sigma1,double sigma2,double gamma1,
+			  double gamma2);
+  // One beta per layer; only the rates that change are recomputed
+  void set_rate_constants(const std::vector<double>& beta,double sigma1,double sigma2,
+			  double gamma1,double gamma2);
+  void set_layer_beta(int layer,double beta);
+  void set_layer_active(int layer,bool active);
+
+  double tinf() { return 1./gamma1 + 1./gamma2;}
+  bool   extinct() {
+    aggregate_data *r=anodemap[hroot];
+    return r->NE1+r->NE2+r->NI1+r->NI2==0;
+  }
+
+  struct SEEIIR_node {
+    enum {S,E1,E2,I1,I2,R} state;
+    int  itransition;
+  } ;
+  struct aggregate_data {
+    int Ntot;
+    int NS,NE1,NE2,NI1,NI2,NR;
+    int inf_accum;
+    int inf_imported,inf_close,inf_community;
+    int Eacc;
+  } ;
+
+  MLGraph::hnode_t                           hroot;
+  MLGraph::hgraph_t::NodeMap<aggregate_data*> anodemap;
+
+private:
+  int                 L;
+  std::vector<double> beta;
+  std::vector<char>   active;
+  std::vector<double> beta_eff;       // beta of the layer, or 0 if not active
+  double              sigma1,sigma2,gamma1,gamma2;
+
+  MLGraph::igraph_t::NodeMap<SEEIIR_node> inodemap;
+
+  // pressure[i*L+l] is P_il; ninf[i] counts the arcs of i to
+  // infectious individuals (when it drops to 0 the pressures are
+  // reset, so that roundoff does not accumulate)
+  std::vector<double> pressure;
+  std::vector<int>    ninf;
+
+  // infectious individuals, and their position in the list
+  std::vector<int>    infectious,infectious_pos;
+  std::vector<int>    stamp;          // to visit each affected node once
+  int                 current_stamp;
+
+  void init_htree(MLGraph::hnode_t lroot);
+  void recompute_counts();
+  void recompute_pressure();
+  void set_infectious(MLGraph::inode_t,bool);
+  void layer_changed(int layer);
+  bool is_infectious(MLGraph::inode_t n) {
+    return inodemap[n].state==SEEIIR_node::I1 || inodemap[n].state==SEEIIR_node::I2;
+  }
+} ;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// event: change rate constants (one beta per layer)
+
+template<>
+class Rate_constant_change<MLGraph> : public Event {
+public:
+  Rate_constant_change(double time,const std::vector<double>& beta,double sigma1,
+		       double sigma2,double gamma1,double gamma2) :
+    Event(time), beta(beta), sigma1(sigma1), sigma2(sigma2),
+    gamma1(gamma1), gamma2(gamma2) {}
+  virtual void apply(Epidemiological_model *);
+
+  std::vector<double> beta;
+  double              sigma1,sigma2,gamma1,gamma2;
+} ;
+
+inline void Rate_constant_change<MLGraph>::apply(Epidemiological_model *em)
+{
+  (dynamic_cast<SEEIIR_model<MLGraph>*>(em))->set_rate_constants(beta,sigma1,sigma2,gamma1,gamma2);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// event: switch layers on or off (temporal networks)
+
+class Layer_activity_change : public Event {
+public:
+  Layer_activity_change(double time,const std::vector<char>& active) :
+    Event(time), active(active) {}
+  virtual void apply(Epidemiological_model *);
+
+  std::vector<char> active;
+} ;
+
+inline void Layer_activity_change::apply(Epidemiological_model *em)
+{
+  auto model=dynamic_cast<SEEIIR_model<MLGraph>*>(em);
+  for (int l=0; l<(int) active.size(); ++l)
+    model->set_layer_active(l,active[l]);
+}
+
+#endif /* MLMODEL_HH */
@@ -0,0 +1,185 @@
+/*
+ * net2bin.cc
+ *
+ * Convert a contact network from text to the binary CSR graph format
+ * read by CSRGraph::load() (see csrgraph.hh), so that simulations
+ * (seeiir_net) need not parse the text every time.
+ *
+ * The edge file has one edge per line, given by the two individuals
+ * (numbered from 0) and optionally a weight (if any line has a weight,
+ * all must).  The optional group file has one line per individual
+ * (in order), giving its group at each level of the hierarchy, from
+ * the lowest (e.g. household, then neighbourhood).  Lines beginning
+ * with # are comments.
+ *
+ * With -o, individuals are renumbered (by breadth-first search,
+ * reverse Cuthill-McKee or group) so that the node data of neighbours
+ * are close in memory during the simulation; see CSRGraph::ordering().
+ * The permutation is then written to outfile.perm: one line per
+ * individual in the new order, giving its number in the text files.
+ * netbench measures the effect of each ordering.
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <cstdio>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "csrgraph.hh"
+
+void show_usage(char *prog)
+{
+  std::cerr << "usage: " << prog << " [-o bfs|rcm|groups] edgefile [groupfile] outfile\n\n"
+	    << "Convert a contact network (and optionally the table of groups of each\n"
+	    << "individual) from text to a binary CSR graph file.  With -o, renumber the\n"
+	    << "individuals in the given order (individual numbers in the output file\n"
+	    << "then differ from those of the text files; outfile.perm gives, for each\n"
+	    << "new number in order, the original one)\n";
+  exit(1);
+}
+
+static FILE* open_or_die(const char *fname)
+{
+  FILE *f=fopen(fname,"r");
+  if (f==0) {
+    std::cerr << "Error opening file (" << fname << ")\n";
+    throw std::runtime_error(strerror(errno));
+  }
+  return f;
+}
+
+// line k gives the original number of individual k (newid is
+// original->new)
+static void write_permutation(const char *fname,const char *order,const std::vector<int>& newid)
+{
+  std::vector<int> old(newid.size());
+  for (int i=0; i<newid.size(); ++i) old[newid[i]]=i;
+  FILE *f=fopen(fname,"w");
+  if (f==0) {
+    std::cerr << "Error opening file (" << fname << ")\n";
+    throw std::runtime_error(strerror(errno));
+  }
+  fprintf(f,"# Original number of each individual, in the new (%s) order\n",order);
+  for (int i: old) fprintf(f,"%d\n",i);
+  if (fclose(f)!=0) throw std::runtime_error(std::string(fname)+": "+strerror(errno));
+}
+
+static void read_edges(const char *fname,int &N,std::vector<int>& ends,std::vector<double>& w)
+{
+  FILE *f=open_or_die(fname);
+  char buf[1000];
+  int  i,j,n;
+  double wij;
+  bool weighted=false;
+  N=0;
+  for (long line=1; fgets(buf,1000,f); ++line) {
+    if (*buf=='#') continue;
+    n=sscanf(buf,"%d %d %lg",&i,&j,&wij);
+    if (n<0) continue;                    // blank line
+    if (n<2 || (ends.size()>0 && (n==3)!=weighted))
+      throw std::runtime_error(std::string(fname)+": bad edge in line "+std::to_string(line));
+    weighted= n==3;
+    ends.push_back(i);
+    ends.push_back(j);
+    if (weighted) w.push_back(wij);
+    N=std::max(N,std::max(i,j)+1);
+  }
+  fclose(f);
+}
+
+static void read_groups(const char *fname,int &N,std::vector<std::vector<int> >& group)
+{
+  FILE *f=open_or_die(fname);
+  char buf[1000];
+  int  n=0;
+  for (long line=1; fgets(buf,1000,f); ++line) {
+    if (*buf=='#') continue;
+    std::istringstream s(buf);
+    std::vector<int> g;
+    int x;
+    while (s >> x) g.push_back(x);
+    if (g.size()==0) continue;
+    if (group.size()==0) group.resize(g.size());
+    if (g.size()!=group.size())
+      throw std::runtime_error(std::string(fname)+": wrong number of groups in line "+
+			       std::to_string(line));
+    for (int l=0; l<g.size(); ++l) group[l].push_back(g[l]);
+    ++n;
+  }
+  fclose(f);
+  if (n<N) throw std::runtime_error(std::string(fname)+": missing individuals");
+  N=n;
+}
+
+int main(int argc,char *argv[])
+{
+  char *prog=argv[0];
+  const char *order=0;
+  if (argc>2 && strcmp(argv[1],"-o")==0) {
+    order=argv[2];
+    argv+=2;
+    argc-=2;
+  }
+  if (argc!=3 && argc!=4) show_usage(prog);
+  CSRGraph::ordering_t kind=CSRGraph::bfs;
+  if (order) {
+    if (strcmp(order,"rcm")==0) kind=CSRGraph::rcm;
+    else if (strcmp(order,"groups")==0) kind=CSRGraph::groups;
+    else if (strcmp(order,"bfs")!=0) show_usage(prog);
+  }
+  Random_number_generator RNG(1);    // not used, but graphs need one
+
+  int N,Ng;
+  std::vector<int>    ends;
+  std::vector<double> w;
+  read_edges(argv[1],N,ends,w);
+
+  std::vector<int> parent;
+  if (argc==4) {
+    std::vector<std::vector<int> > group;
+    Ng=N;
+    read_groups(argv[2],Ng,group);
+    N=Ng;
+    std::vector<const int*> gp;
+    for (auto &g: group) gp.push_back(g.data());
+    parent=CSRGraph::groups_to_parent(N,gp);
+  } else {
+    parent.assign(N+1,N);
+    parent[N]=-1;
+  }
+
+  CSRGraph *g=CSRGraph::create(N,ends.size()/2,ends.data(),w.empty() ? 0 : w.data(),parent);
+  if (order) {
+    std::vector<int> newid=g->ordering(kind);
+    CSRGraph *r=g->renumbered(newid);
+    delete g;
+    g=r;
+    write_permutation((std::string(argv[argc-1])+".perm").c_str(),order,newid);
+  }
+  g->save(argv[argc-1]);
+  std::cerr << N << " individuals, " << ends.size()/2 << " edges, "
+	    << parent.size()-N << " aggregate nodes\n";
+  delete g;
+}
@@ -0,0 +1,288 @@
+/*
+ * netbench.cc
+ *
+ * Benchmark of the renumberings of CSRGraph::ordering() (see
+ * net2bin): for the original numbering and each ordering, times a
+ * number of full rate sweeps (compute_all_rates()) of
+ * SEEIIR_model<CSRGraph> and counts the cache misses and references
+ * they cause with the hardware counters (perf_event_open, Linux
+ * only).  Each renumbered graph is first checked to be the original
+ * one under the permutation (same neighbours and ancestors).
+ *
+ * The network is read from a file as in seeiir_net, or generated with
+ * -g L: L x L cells with a household of 3 in each, every member in
+ * contact with the rest of the household and with a random member of
+ * 4 of the neighbouring cells, and neighbourhoods of 10 x 10 cells.
+ * Individuals are numbered at random, as they may come from any
+ * external source.
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include <cstdio>
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "emodel.hh"
+#include "seirmodel.hh"
+#include "csrgraph.hh"
+
+void show_usage(char *prog)
+{
+  std::cerr << "usage: " << prog << " netfile [groupfile] [sweeps]\n"
+	    << "    or " << prog << " -g L [sweeps]\n\n"
+	    << "Time full rate sweeps of SEEIIR_model on a network, in its original numbering\n"
+	    << "and renumbered by each CSRGraph::ordering(), counting cache misses.  With -g,\n"
+	    << "use a generated spatial network of 3*L*L individuals in households\n"
+	    << "(default 10 sweeps)\n";
+  exit(1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// generated network
+
+CSRGraph* spatial_households(int L)
+{
+  const int hood=10;             // neighbourhood side (in cells)
+  const int N=3*L*L;
+  Uniform_integer ran;
+
+  std::vector<int> num(N);       // individual numbers, shuffled
+  for (int i=0; i<N; ++i) num[i]=i;
+  for (int i=N-1; i>0; --i) std::swap(num[i],num[ran(i+1)]);
+
+  std::vector<int> ends,household(N),neighbourhood(N);
+  static const int dx[]={1,0,1,1}, dy[]={0,1,1,-1};
+  for (int y=0; y<L; ++y)
+    for (int x=0; x<L; ++x) {
+      int c=x+y*L;
+      const int *m=&num[3*c];
+      for (int a=0; a<3; ++a) {
+	household[m[a]]=c;
+	neighbourhood[m[a]]=x/hood+(y/hood)*((L+hood-1)/hood);
+	for (int b=a+1; b<3; ++b) {
+	  ends.push_back(m[a]);
+	  ends.push_back(m[b]);
+	}
+      }
+      for (int k=0; k<4; ++k) {
+	int X=x+dx[k], Y=y+dy[k];
+	if (X<0 || X>=L || Y<0 || Y>=L) continue;
+	for (int a=0; a<3; ++a) {
+	  ends.push_back(m[a]);
+	  ends.push_back(num[3*(X+Y*L)+ran(3)]);
+	}
+      }
+    }
+
+  std::vector<const int*> group={household.data(),neighbourhood.data()};
+  return CSRGraph::create(N,ends.size()/2,ends.data(),0,CSRGraph::groups_to_parent(N,group));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// hardware counters
+
+class Cache_counters {
+public:
+  Cache_counters();
+  ~Cache_counters();
+  bool available() const {return fmiss>=0 && fref>=0;}
+  void start();
+  void stop(long long &misses,long long &references);
+
+private:
+  int fmiss,fref;
+} ;
+
+#ifdef __linux__
+
+static int open_counter(unsigned long config)
+{
+  perf_event_attr a;
+  memset(&a,0,sizeof(a));
+  a.type=PERF_TYPE_HARDWARE;
+  a.size=sizeof(a);
+  a.config=config;
+  a.disabled=1;
+  a.exclude_kernel=1;
+  a.exclude_hv=1;
+  return syscall(__NR_perf_event_open,&a,0,-1,-1,0);
+}
+
+Cache_counters::Cache_counters() :
+  fmiss(open_counter(PERF_COUNT_HW_CACHE_MISSES)),
+  fref(open_counter(PERF_COUNT_HW_CACHE_REFERENCES))
+{}
+
+Cache_counters::~Cache_counters()
+{
+  if (fmiss>=0) close(fmiss);
+  if (fref>=0) close(fref);
+}
+
+void Cache_counters::start()
+{
+  if (!available()) return;
+  ioctl(fmiss,PERF_EVENT_IOC_RESET,0);
+  ioctl(fref,PERF_EVENT_IOC_RESET,0);
+  ioctl(fmiss,PERF_EVENT_IOC_ENABLE,0);
+  ioctl(fref,PERF_EVENT_IOC_ENABLE,0);
+}
+
+void Cache_counters::stop(long long &misses,long long &references)
+{
+  misses=references=-1;
+  if (!available()) return;
+  ioctl(fmiss,PERF_EVENT_IOC_DISABLE,0);
+  ioctl(fref,PERF_EVENT_IOC_DISABLE,0);
+  if (read(fmiss,&misses,sizeof(misses))!=sizeof(misses)) misses=-1;
+  if (read(fref,&references,sizeof(references))!=sizeof(references)) references=-1;
+}
+
+#else
+
+Cache_counters::Cache_counters() : fmiss(-1), fref(-1) {}
+Cache_counters::~Cache_counters() {}
+void Cache_counters::start() {}
+void Cache_counters::stop(long long &misses,long long &references) {misses=references=-1;}
+
+#endif /* __linux__ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// checking and timing
+
+// number of individuals whose neighbours or ancestors in r are not
+// those of g under newid
+long mismatches(CSRGraph &g,CSRGraph &r,const std::vector<int> &newid)
+{
+  long bad=0;
+  for (CSRGraph::igraph_t::NodeIt n(g.igraph); n!=lemon::INVALID; ++n) {
+    CSRGraph::Node rn(newid[n.i]);
+    std::vector<int> a,b;
+    for (CSRGraph::igraph_t::OutArcIt e(g.igraph,n); e!=lemon::INVALID; ++e)
+      a.push_back(newid[g.igraph.target(e).i]);
+    for (CSRGraph::igraph_t::OutArcIt e(r.igraph,rn); e!=lemon::INVALID; ++e)
+      b.push_back(r.igraph.target(e).i);
+    std::sort(a.begin(),a.end());
+    std::sort(b.begin(),b.end());
+    std::vector<int> pa,pb;
+    g.for_each_anode(n,[&](CSRGraph::hnode_t h) {pa.push_back(h.i);});
+    r.for_each_anode(rn,[&](CSRGraph::hnode_t h) {pb.push_back(h.i);});
+    if (a!=b || pa!=pb) ++bad;
+  }
+  return bad;
+}
+
+void bench(const char *name,CSRGraph &g,int sweeps,Cache_counters &counters)
+{
+  double dist=0;
+  long   narcs=0;
+  for (CSRGraph::igraph_t::NodeIt n(g.igraph); n!=lemon::INVALID; ++n)
+    for (CSRGraph::igraph_t::OutArcIt e(g.igraph,n); e!=lemon::INVALID; ++e) {
+      dist+=abs(g.igraph.target(e).i-n.i);
+      ++narcs;
+    }
+
+  SEEIIR_model<CSRGraph> model(g);
+  model.set_rate_constants(1.,1.,1.,1.,1.);
+  model.set_all_susceptible();
+  Forced_transition ft(0.,g.inode_count/5,0);      // infected scattered over the network
+  model.add_imported(&ft);
+  model.compute_all_rates();                        // warm up
+
+  long long misses,references;
+  counters.start();
+  auto t0=std::chrono::steady_clock::now();
+  for (int s=0; s<sweeps; ++s) model.compute_all_rates();
+  auto t1=std::chrono::steady_clock::now();
+  counters.stop(misses,references);
+
+  double ms=std::chrono::duration<double,std::milli>(t1-t0).count()/sweeps;
+  printf("%-8s %12.0f %11.2f",name,dist/narcs,ms);
+  if (misses>=0) printf(" %14.3f %14.3f\n",misses/1e6/sweeps,references/1e6/sweeps);
+  else printf(" %14s %14s\n","n/a","n/a");
+}
+
+int main(int argc,char *argv[])
+{
+  Random_number_generator RNG(1);
+  CSRGraph *g;
+  int sweeps=10;
+
+  if (argc>2 && strcmp(argv[1],"-g")==0) {
+    if (argc>4) show_usage(argv[0]);
+    g=spatial_households(atoi(argv[2]));
+    if (argc==4) sweeps=atoi(argv[3]);
+  } else {
+    if (argc<2 || argc>4) show_usage(argv[0]);
+    const char *groupfile=0;
+    if (argc>=3) {                   // groupfile, or sweeps if it is a number
+      char *end;
+      long s=strtol(argv[argc-1],&end,10);
+      if (*end==0) {
+	sweeps=s;
+	--argc;
+      }
+      if (argc==3) groupfile=argv[2];
+    }
+    g=CSRGraph::load(argv[1],groupfile);
+  }
+  if (sweeps<1) show_usage(argv[0]);
+
+  long narcs=0;
+  for (CSRGraph::igraph_t::NodeIt n(g->igraph); n!=lemon::INVALID; ++n)
+    for (CSRGraph::igraph_t::OutArcIt e(g->igraph,n); e!=lemon::INVALID; ++e) ++narcs;
+  printf("# %d individuals, %ld edges, %d sweeps each\n",g->inode_count,narcs/2,sweeps);
+
+  Cache_counters counters;
+  if (!counters.available())
+    printf("# Hardware cache counters not available, only times are given\n");
+  printf("# order    mean |i-j|    ms/sweep  misses/sweep(M)  refs/sweep(M)\n");
+  bench("none",*g,sweeps,counters);
+
+  static const struct {const char *name; CSRGraph::ordering_t kind;} orders[]=
+    {{"bfs",CSRGraph::bfs},{"rcm",CSRGraph::rcm},{"groups",CSRGraph::groups}};
+  for (auto &o: orders) {
+    std::vector<int> newid=g->ordering(o.kind);
+    CSRGraph *r=g->renumbered(newid);
+    long bad=mismatches(*g,*r,newid);
+    if (bad>0) {
+      std::cerr << o.name << ": " << bad << " individuals with wrong neighbours or ancestors\n";
+      return 1;
+    }
+    bench(o.name,*r,sweeps,counters);
+    delete r;
+  }
+  delete g;
+}
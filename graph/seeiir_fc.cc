@@ -22,7 +22,9 @@
 #include <string.h>
 
 #include "emodel.hh"
+#include "fcmodel.hh"
 #include "seir_collector.hh"
+#include "graph_cache.hh"
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -40,6 +42,7 @@ struct opt {
   int    Nnodes;
   enum {exp} beta_distribution;
   double exp_mu;
+  char   *trajfile;       // binary trajectory or run archive (optional)
   
 
   // Forced transitions
@@ -48,10 +51,10 @@ struct opt {
   std::string eifile;             // File to read imported infected cases
 
   // rates vs time
-  typedef std::vector<Rate_constant_change<MWFCGraph>> rates_vs_time_t;
+  typedef std::vector<Rate_constant_change<IFCGraph>> rates_vs_time_t;
   rates_vs_time_t                           rates_vs_time;
 
-  opt() : last_arg_read(0), deltat(1.) {}
+  opt() : last_arg_read(0), deltat(1.), trajfile(0) {}
 
 } options;
 
@@ -66,7 +69,10 @@ static int nargs=5;
 
 void show_usage(char *prog)
 {
-  std::cerr << "usage: " << prog << " parameterfile seed steps Nruns delta_t\n\n";
+  std::cerr << "usage: " << prog << " parameterfile seed steps Nruns delta_t [trajfile]\n\n"
+	    << "If trajfile is given, for a single run (Nruns=1) the trajectory is written there\n"
+	    << "in binary form instead of to standard output, otherwise the counts of every run\n"
+	    << "are archived there (convert it to text with traj2txt)\n";
   exit(1);
 }
 
@@ -85,13 +91,14 @@ void read_rates_vs_time(FILE*);
 
 void read_parameters(int argc,char *argv[])
 {
-  if (argc!=nargs+1) show_usage(argv[0]);
+  if (argc!=nargs+1 && argc!=nargs+2) show_usage(argv[0]);
 
   read_arg(argv,options.ifile);
   read_arg(argv,options.seed);
   read_arg(argv,options.steps);
   read_arg(argv,options.Nruns);
   read_arg(argv,options.deltat);
+  if (argc==nargs+2) read_arg(argv,options.trajfile);
 
   FILE *f=fopen(options.ifile,"r");
   if (f==0) throw std::runtime_error(strerror(errno));
@@ -164,7 +171,7 @@ void read_rates_vs_time(FILE *f)
     if (sscanf(buf,"%lg %lg %lg %lg %lg %lg",&time,&b,&s1,&s2,&g1,&g2)!=6) {
       std::cerr  << "couldn't read record: " << buf << "\n";
       throw std::runtime_error(strerror(errno));}
-    options.rates_vs_time.push_back(Rate_constant_change<MWFCGraph>(time,b,s1,s2,g1,g2));
+    options.rates_vs_time.push_back(Rate_constant_change<IFCGraph>(time,b,s1,s2,g1,g2));
   }
 }
 
@@ -218,32 +225,65 @@ int main(int argc,char* argv[])
   Random_number_generator RNG(options.seed);
 
   std::cerr << "# Building graph...\n";
-  MWFCGraph* egraph = MWFCGraph::create(options.Nnodes);
-
-  std::cerr << "#      ...setting weights\n";
-  switch (options.beta_distribution) {
-  case opt::exp:
-    egraph->set_weights_random_multiplicative(beta_from_exp_dist,options.exp_mu);
-    break;
+  IFCGraph* egraph = IFCGraph::create(options.Nnodes);
+
+  char key[200];
+  sprintf(key,"MWFCGraph N=%d exp mu=%.17g seed=%ld",options.Nnodes,options.exp_mu,options.seed);
+  Graph_cache cache(key,&RNG);
+  if (cache.find()) {
+    std::cerr << "#      ...reading weights from " << cache.file() << '\n';
+    egraph->load_weights(cache.file(),cache.offset());
+  } else {
+    std::cerr << "#      ...setting weights\n";
+    switch (options.beta_distribution) {
+    case opt::exp:
+      egraph->set_weights_random_multiplicative(beta_from_exp_dist,options.exp_mu);
+      break;
+    }
+    if (cache.enabled()) {
+      FILE *f=cache.begin_save();
+      egraph->save_weights(f);
+      cache.end_save(f);
+    }
   }
 
   std::cerr << "# Additional setup...\n";
-  SEEIIR_model<MWFCGraph> *SEEIIR = new SEEIIR_model<MWFCGraph>(*egraph);
-  SEEIIRcollector<MWFCGraph> *collector =
+  SEEIIR_model<IFCGraph> *SEEIIR = new SEEIIR_model<IFCGraph>(*egraph);
+  SEEIIRcollector<IFCGraph> *collector =
     options.Nruns > 1 ?
-    new SEEIIRcollector_av<MWFCGraph>(*SEEIIR,options.deltat) :
-    new SEEIIRcollector<MWFCGraph>(*SEEIIR);
-  
-  std::cout << collector->header() << '\n';
+    new SEEIIRcollector_av<IFCGraph>(*SEEIIR,options.deltat) :
+    new SEEIIRcollector<IFCGraph>(*SEEIIR);
+  Trajectory_writer *traj=0;
+  Run_archive       *archive=0;
+  if (options.trajfile && options.Nruns>1) {
+    archive=new Run_archive(options.trajfile,options.deltat);
+    archive->add_run_info(argc,argv,options.seed,options.ifile);
+    static_cast<SEEIIRcollector_av<IFCGraph>*>(collector)->set_archive(archive);
+  }
+  if (options.trajfile && !archive) {
+    traj=new Trajectory_writer(options.trajfile);
+    traj->add_run_info(argc,argv,options.seed,options.ifile);
+    collector->set_trajectory(traj);
+  } else {
+    std::cout << collector->header() << '\n';
+    if (options.Nruns==1) collector->set_async_output();
+  }
 
+  int extinct=0;
   for (int n=0; n<options.Nruns; ++n) {
     merge_events();
     Sampler *sampler =  new Gillespie_sampler(0,options.steps,options.deltat,collector);
-    run(SEEIIR,sampler,event_queue,options.steps);
+    extinct+=run(SEEIIR,sampler,event_queue,options.steps);
     delete sampler;
+    if (archive) archive->end_run();
+  }
+  if (options.Nruns>1) {
+    std::cout << *collector;
+    print_extinction(std::cout,extinct,options.Nruns);
   }
-  if (options.Nruns>1) std::cout << *collector;
   
+  delete traj;
+  delete archive;
   delete collector;
   delete SEEIIR;
   delete egraph;
@@ -0,0 +1,324 @@
+/*
+ * seeiir_hfc.cc -- hierarchical SEEIIR (as seeiir_h) on the implicit
+ *                  hierarchical fully-connected graph
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ * 
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ * 
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ * 
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "emodel.hh"
+#include "hfcmodel.hh"
+#include "seir_collector.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// simulation options and parameters
+
+struct opt {
+  int    last_arg_read;
+  
+  char   *ifile;
+  int    Nruns;
+  int    steps;
+  double deltat;
+  long   seed;
+
+  int               levels;       // tree depth (not counting individuals)
+  std::vector<int>  M;            // number of descendants at each level (negative=fluctuating)
+  std::vector<std::vector<double>> PM; // Distribution of descendants
+  char   *trajfile;       // binary trajectory or run archive (optional)
+  
+
+  // Forced transitions
+  typedef std::vector<Forced_transition> forced_transition_t;
+  forced_transition_t                    forced_transitions;
+  std::string eifile;             // File to read imported infected cases
+
+  // rates vs time
+  typedef std::vector<Rate_constant_change<HFCGraph>> rates_vs_time_t;
+  rates_vs_time_t                           rates_vs_time;
+
+  opt() : last_arg_read(0), deltat(1.), trajfile(0) {}
+
+} options;
+
+static int nargs=5;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Read parameters from command-line and file, and compute
+// derived parameters
+
+#include "../read_arg.hh"
+
+void show_usage(char *prog)
+{
+  std::cerr << "usage: " << prog << " parameterfile seed steps Nruns delta_t [trajfile]\n\n"
+	    << "If trajfile is given, for a single run (Nruns=1) the trajectory is written there\n"
+	    << "in binary form instead of to standard output, otherwise the counts of every run\n"
+	    << "are archived there (convert it to text with traj2txt)\n";
+  exit(1);
+}
+
+char *readbuf(FILE *f)
+{
+  static char buf[1000];
+  char *s;
+  do
+    s=fgets(buf,1000,f);
+  while (*buf=='#');
+  return buf;
+}
+
+void read_imported_infections();
+void read_rates_vs_time(FILE*);
+
+void read_parameters(int argc,char *argv[])
+{
+  if (argc!=nargs+1 && argc!=nargs+2) show_usage(argv[0]);
+
+  read_arg(argv,options.ifile);
+  read_arg(argv,options.seed);
+  read_arg(argv,options.steps);
+  read_arg(argv,options.Nruns);
+  read_arg(argv,options.deltat);
+  if (argc==nargs+2) read_arg(argv,options.trajfile);
+
+  FILE *f=fopen(options.ifile,"r");
+  if (f==0) throw std::runtime_error(strerror(errno));
+  char *buf;
+  printf("##### Parameters\n");
+
+  buf=readbuf(f);
+  sscanf(buf,"%d",&options.levels);
+  printf("# Nlevels = %d\n",options.levels);
+  if (options.levels<1) throw std::runtime_error("Invalid number of levels");
+
+  options.M.resize(options.levels+1);
+  options.PM.resize(options.levels+1);
+  for (int lev=options.levels; lev>0; --lev) {
+    buf=readbuf(f);
+    sscanf(buf,"%d",&(options.M[lev]));
+    if (options.M[lev]<0) {
+      options.PM[lev].resize(-options.M[lev]+1);
+      options.PM[lev][0]=0.;
+      for (int M=1; M<=-options.M[lev]; ++M) {
+	buf=readbuf(f);
+	sscanf(buf,"%lg",&(options.PM[lev][M]));
+      }
+    }
+  }
+
+  for (int lev=options.levels; lev>0; --lev) {
+    printf("# Number of descendants at level %d = ",lev);
+    if (options.M[lev]>0) printf("%d\n",options.M[lev]);
+    else {
+      printf(" 1 to %d, with weights: \n",-options.M[lev]);
+      for (int i=1; i<options.PM[lev].size(); ++i)
+	printf("#       %d:   %g\n",i,options.PM[lev][i]);
+    }
+  }
+
+  printf("#\n# Nruns = %d\n",options.Nruns);
+
+  // Imported infections
+  buf=readbuf(f);
+  options.eifile=buf;
+  options.eifile.erase(options.eifile.end()-1);   // remove trailing newline
+  read_imported_infections();
+
+  printf("# Infections and recoveries:\n");
+  printf("# Time   Infections   Recoveries\n");
+  int II=0;
+  int RR=0;
+  for (auto iir: options.forced_transitions)
+    printf("# %g %d %d\n",iir.time,II+=iir.new_infected,RR+=iir.new_recovered);
+
+  read_rates_vs_time(f);
+  fclose(f);
+  printf("#\n# Rate constants:\n");
+  printf("# time ");
+  for (int i=1; i<=options.levels; ++i) printf("beta_%d ",i);
+  printf("sigma_1 sigma_2 gamma_1 gamma_2\n");
+  for (auto r:options.rates_vs_time) {
+    printf("# %g ",r.time);
+    for (int i=1; i<=options.levels; ++i) printf("%g ",r.beta[i]);
+    printf("%g %g %g %g\n",r.sigma1,r.sigma2,r.gamma1,r.gamma2);
+  }
+}
+
+void read_imported_infections()
+{
+  FILE *f=fopen(options.eifile.c_str(),"r");
+  if (f==0) {
+    std::cerr << "Error opening file (" << options.eifile << ")\n";
+    throw std::runtime_error(strerror(errno));
+  }
+
+  double etime;
+  int   eI,eIold=0;
+  int   eR,eRold=0;
+  while (ungetc(fgetc(f),f)!=EOF) {
+    char *buf=readbuf(f);
+    if (sscanf(buf,"%lg %d %d",&etime,&eI,&eR)!=3) {
+      std::cerr  << "couldn't read record: " << buf << "\n";
+      throw std::runtime_error(strerror(errno));}
+    options.forced_transitions.push_back(Forced_transition(etime,eI-eIold,eR-eRold));
+    eIold=eI;
+    eRold=eR;
+  }
+  
+  fclose(f);
+}
+
+void read_rates_vs_time(FILE *f)
+{
+  double time,s1,s2,g1,g2;
+  std::vector<double> beta(options.levels+1,0.);
+  int ncread=0;
+
+  while (ungetc(fgetc(f),f)!=EOF) {
+    char *buf=readbuf(f);
+    if (sscanf(buf,"%lg %n",&time,&ncread)!=1) {
+      std::cerr  << "couldn't read record: " << buf << "\n";
+      throw std::runtime_error(strerror(errno));}
+    for (int i=1; i<=options.levels; ++i) {
+      buf+=ncread;
+      if (sscanf(buf,"%lg %n",&(beta[i]),&ncread)!=1 ) {
+	std::cerr  << "couldn't read record: " << buf << "\n";
+	throw std::runtime_error(strerror(errno));}
+    }
+    buf+=ncread;
+    if (sscanf(buf,"%lg %lg %lg %lg",&s1,&s2,&g1,&g2)!=4) {
+      std::cerr  << "couldn't read record: " << buf << "\n";
+      throw std::runtime_error(strerror(errno));}
+    options.rates_vs_time.push_back(Rate_constant_change<HFCGraph>(time,beta,s1,s2,g1,g2));
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// merge_events()
+
+event_queue_t event_queue;
+
+/*
+ * build a time ordered queue of beta and imported infection changes
+ * closes with dummy event at infinite time
+ *
+ */
+
+void merge_events()
+{
+  while (!event_queue.empty()) event_queue.pop();
+  
+  auto ii_begin=options.forced_transitions.begin();
+  auto ii_end=options.forced_transitions.end();
+  auto ir_begin=options.rates_vs_time.begin();
+  auto ir_end=options.rates_vs_time.end();
+  
+  auto ii=ii_begin;
+  auto ir=ir_begin;
+  while ( ii!=ii_end  || ir!=ir_end ) {
+
+    while (ii!=ii_end && (ir==ir_end || ii->time <= ir->time ) ) {
+      event_queue.push(&(*ii));
+      ++ii;
+    }
+
+    while (ir!=ir_end && (ii==ii_end || ir->time <= ii->time) ) {
+      event_queue.push(&(*ir));
+      ++ir;
+    }
+
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// noffspring provides the number of descendants at each tree level
+
+std::vector<Discrete_distribution*> Mdist;
+
+void prepare_noffspring()
+{
+  Mdist.resize(options.levels+1);
+  for (int l=options.levels; l>0; --l) {
+    if (options.M[l]<0)
+      Mdist[l]=new Discrete_distribution(options.PM[l].size(),&(options.PM[l][0]));
+  }
+}
+
+int noffspring(int level)
+{
+  if (options.M[level]>0) return options.M[level];
+  return (*(Mdist[level]))();
+}
+
+int main(int argc,char* argv[])
+{
+  read_parameters(argc,argv);
+  Random_number_generator RNG(options.seed);
+
+  std::cerr << "# Building graph...\n";
+  prepare_noffspring();
+  HFCGraph* egraph = HFCGraph::create(options.levels,noffspring);
+  printf("# N = %d\n",egraph->inode_count);
+
+  std::cerr << "# Additional setup...\n";
+  SEEIIR_model<HFCGraph> *SEEIIR = new SEEIIR_model<HFCGraph>(*egraph);
+  SEEIIRcollector<HFCGraph> *collector =
+    options.Nruns > 1 ?
+    new SEEIIRcollector_av<HFCGraph>(*SEEIIR,options.deltat) :
+    new SEEIIRcollector<HFCGraph>(*SEEIIR);
+  Trajectory_writer *traj=0;
+  Run_archive       *archive=0;
+  if (options.trajfile && options.Nruns>1) {
+    archive=new Run_archive(options.trajfile,options.deltat);
+    archive->add_run_info(argc,argv,options.seed,options.ifile);
+    static_cast<SEEIIRcollector_av<HFCGraph>*>(collector)->set_archive(archive);
+  }
+  if (options.trajfile && !archive) {
+    traj=new Trajectory_writer(options.trajfile);
+    traj->add_run_info(argc,argv,options.seed,options.ifile);
+    collector->set_trajectory(traj);
+  } else {
+    std::cout << collector->header() << '\n';
+    if (options.Nruns==1) collector->set_async_output();
+  }
+
+  int extinct=0;
+  for (int n=0; n<options.Nruns; ++n) {
+    merge_events();
+    Sampler *sampler =  new Gillespie_sampler(0,options.steps,options.deltat,collector);
+    extinct+=run(SEEIIR,sampler,event_queue,options.steps);
+    delete sampler;
+    if (archive) archive->end_run();
+  }
+  if (options.Nruns>1) {
+    std::cout << *collector;
+    print_extinction(std::cout,extinct,options.Nruns);
+  }
+  
+  delete traj;
+  delete archive;
+  delete collector;
+  delete SEEIIR;
+  delete egraph;
+}
@@ -0,0 +1,328 @@
+/*
+ * seeiir_ml.cc -- SEEIIR model on a multi-layer contact network
+ *
+ * Each layer (household, school, work, ...) is a network file read by
+ * CSRGraph::load(), see csrgraph.hh for the file formats, and has its
+ * own beta, so that interventions can act on single layers.
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ * 
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ * 
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ * 
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "emodel.hh"
+#include "mlmodel.hh"
+#include "seir_collector.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// simulation options and parameters
+
+struct opt {
+  int    last_arg_read;
+  
+  char   *ifile;
+  int    Nruns;
+  int    steps;
+  long   seed;
+
+  std::vector<std::string> netfiles;   // one network per layer (binary edge list or CSR graph)
+  std::vector<std::string> masks;      // activity of each layer over the schedule ("" if always active)
+  double slot_length;                  // length of the schedule slots (0 if no schedule)
+  std::string groupfile;          // group table, empty for none
+  char   *trajfile;       // binary trajectory or run archive (optional)
+
+  // imported infections
+  typedef std::vector<Forced_transition> forced_transition_t;
+  forced_transition_t                    forced_transitions;
+  std::string eifile;             // File to read imported infected cases
+
+  // rates vs time
+  typedef std::vector<Rate_constant_change<MLGraph>> rates_vs_time_t;
+  rates_vs_time_t                           rates_vs_time;
+
+  // layers switched on or off by the schedule
+  std::vector<Layer_activity_change>        activity_changes;
+
+  opt() : last_arg_read(0), slot_length(0), trajfile(0) {}
+
+} options;
+
+static int nargs=4;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Read parameters from command-line and file, and compute
+// derived parameters
+
+#include "../read_arg.hh"
+
+void show_usage(char *prog)
+{
+  std::cerr << "usage: " << prog << " parameterfile seed steps Nruns [trajfile]\n\n"
+	    << "If trajfile is given, for a single run (Nruns=1) the trajectory is written there\n"
+	    << "in binary form instead of to standard output, otherwise the counts of every run\n"
+	    << "are archived there (convert it to text with traj2txt)\n";
+  exit(1);
+}
+
+char *readbuf(FILE *f)
+{
+  static char buf[1000];
+  char *s;
+  do
+    s=fgets(buf,1000,f);
+  while (*buf=='#');
+  return buf;
+}
+
+void read_imported_infections();
+void read_rates_vs_time(FILE*);
+
+void read_parameters(int argc,char *argv[])
+{
+  if (argc!=nargs+1 && argc!=nargs+2) show_usage(argv[0]);
+
+  read_arg(argv,options.ifile);
+  read_arg(argv,options.seed);
+  read_arg(argv,options.steps);
+  read_arg(argv,options.Nruns);
+  if (argc==nargs+2) read_arg(argv,options.trajfile);
+
+  FILE *f=fopen(options.ifile,"r");
+  if (f==0) throw std::runtime_error(strerror(errno));
+  char *buf;
+  printf("##### Parameters\n");
+
+  int nlayers;
+  buf=readbuf(f);
+  int nr=sscanf(buf,"%d %lg",&nlayers,&options.slot_length);
+  if (nr<1 || nlayers<1)
+    throw std::runtime_error("Invalid number of layers");
+  if (nr==1) options.slot_length=0;
+  for (int l=0; l<nlayers; ++l) {
+    buf=readbuf(f);
+    char name[1000],mask[1000];
+    int nw=sscanf(buf,"%999s %999s",name,mask);
+    if (nw<1) throw std::runtime_error("Missing network file");
+    options.netfiles.push_back(name);
+    options.masks.push_back(nw==2 ? mask : "");
+  }
+  buf=readbuf(f);
+  options.groupfile=buf;
+  options.groupfile.erase(options.groupfile.end()-1);
+  if (options.groupfile=="-") options.groupfile.clear();
+  printf("# Layers = %d\n",nlayers);
+  for (int l=0; l<nlayers; ++l) {
+    printf("# Network file of layer %d = %s",l+1,options.netfiles[l].c_str());
+    if (!options.masks[l].empty()) printf(" (activity %s)",options.masks[l].c_str());
+    printf("\n");
+  }
+  printf("# Group file = %s\n",options.groupfile.empty() ? "(none)" : options.groupfile.c_str());
+  if (options.slot_length>0) printf("# Schedule slot length = %g\n",options.slot_length);
+
+  printf("#\n# Nruns = %d\n",options.Nruns);
+
+  // Imported infections
+  buf=readbuf(f);
+  options.eifile=buf;
+  options.eifile.erase(options.eifile.end()-1);   // remove trailing newline
+  read_imported_infections();
+
+  printf("# Imported infections:\n");
+  printf("# Time   Cases\n");
+  int II=0;
+  for (auto iir: options.forced_transitions)
+    printf("# %g %d\n",iir.time,II+=iir.new_infected);
+
+  read_rates_vs_time(f);
+  fclose(f);
+  printf("#\n# Rate constatst:\n");
+  printf("# time ");
+  for (int l=1; l<=nlayers; ++l) printf("beta_%d ",l);
+  printf("sigma_1 sigma_2 gamma_1 gamma_2\n");
+  for (auto r:options.rates_vs_time) {
+    printf("# %g ",r.time);
+    for (double b: r.beta) printf("%g ",b);
+    printf("%g %g %g %g\n",r.sigma1,r.sigma2,r.gamma1,r.gamma2);
+  }
+}
+
+void read_imported_infections()
+{
+  FILE *f=fopen(options.eifile.c_str(),"r");
+  if (f==0) {
+    std::cerr << "Error opening file (" << options.eifile << ")\n";
+    throw std::runtime_error(strerror(errno));
+  }
+
+  double etime;
+  int   eI,eIold=0;
+  while (ungetc(fgetc(f),f)!=EOF) {
+    char *buf=readbuf(f);
+    if (sscanf(buf,"%lg %d",&etime,&eI)!=2) {
+      std::cerr  << "couldn't read record: " << buf << "\n";
+      throw std::runtime_error(strerror(errno));}
+    options.forced_transitions.push_back(Forced_transition(etime,eI-eIold,0));
+    eIold=eI;
+  }
+  
+  fclose(f);
+}
+
+void read_rates_vs_time(FILE *f)
+{
+  double time,s1,s2,g1,g2;
+  std::vector<double> beta(options.netfiles.size());
+  int ncread=0;
+
+  while (ungetc(fgetc(f),f)!=EOF) {
+    char *buf=readbuf(f);
+    if (sscanf(buf,"%lg %n",&time,&ncread)!=1) {
+      std::cerr  << "couldn't read record: " << buf << "\n";
+      throw std::runtime_error(strerror(errno));}
+    for (double &b: beta) {
+      buf+=ncread;
+      if (sscanf(buf,"%lg %n",&b,&ncread)!=1) {
+	std::cerr  << "couldn't read record: " << buf << "\n";
+	throw std::runtime_error(strerror(errno));}
+    }
+    buf+=ncread;
+    if (sscanf(buf,"%lg %lg %lg %lg",&s1,&s2,&g1,&g2)!=4) {
+      std::cerr  << "couldn't read record: " << buf << "\n";
+      throw std::runtime_error(strerror(errno));}
+    options.rates_vs_time.push_back(Rate_constant_change<MLGraph>(time,beta,s1,s2,g1,g2));
+  }
+}
+
+// Activity masks are strings of 0 (inactive) and 1 (active), one
+// character per slot; layers without a mask are always active
+std::vector<std::vector<char>> activity_masks()
+{
+  size_t nslots=0;
+  for (auto &m: options.masks)
+    if (!m.empty()) {
+      if (nslots!=0 && m.size()!=nslots)
+	throw std::runtime_error("Activity masks must have the same number of slots");
+      nslots=m.size();
+    }
+  if (nslots==0) return std::vector<std::vector<char>>();
+  if (options.slot_length<=0)
+    throw std::runtime_error("Activity masks given but no slot length");
+  std::vector<std::vector<char>> activity;
+  for (auto &m: options.masks) {
+    activity.push_back(std::vector<char>(nslots,1));
+    for (size_t s=0; s<m.size(); ++s) {
+      if (m[s]!='0' && m[s]!='1')
+	throw std::runtime_error("Invalid activity mask " + m);
+      activity.back()[s]= m[s]=='1';
+    }
+  }
+  return activity;
+}
+
+// One event at the start of each slot where the set of active layers
+// changes
+void build_schedule(MLGraph *egraph)
+{
+  auto activity=activity_masks();
+  if (activity.empty()) return;
+  egraph->set_schedule(options.slot_length,activity);
+  std::vector<char> active(egraph->nlayers()),previous;
+  for (long k=0; k*egraph->slot_length()<options.steps; ++k) {
+    for (int l=0; l<egraph->nlayers(); ++l) active[l]=egraph->active(l,k);
+    if (active!=previous)
+      options.activity_changes.push_back(Layer_activity_change(k*egraph->slot_length(),active));
+    previous=active;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// merge_events()
+
+event_queue_t event_queue;
+
+/*
+ * build a time ordered queue of beta, layer activity and imported
+ * infection changes
+ *
+ */
+
+void merge_events()
+{
+  while (!event_queue.empty()) event_queue.pop();
+
+  std::vector<Event*> events;
+  for (auto &e: options.forced_transitions) events.push_back(&e);
+  for (auto &e: options.rates_vs_time) events.push_back(&e);
+  for (auto &e: options.activity_changes) events.push_back(&e);
+  std::stable_sort(events.begin(),events.end(),
+		   [](Event *a,Event *b) {return a->time < b->time;} );
+  for (Event *e: events) event_queue.push(e);
+}
+
+int main(int argc,char* argv[])
+{
+  read_parameters(argc,argv);
+  Random_number_generator RNG(options.seed);
+
+  MLGraph* egraph = MLGraph::load(options.netfiles,
+				  options.groupfile.empty() ? 0 : options.groupfile.c_str());
+  printf("# Individuals = %d\n",egraph->inode_count);
+  printf("# Aggregate nodes = %d\n",egraph->hgraph.nodeNum()-egraph->inode_count);
+  build_schedule(egraph);
+  SEEIIR_model<MLGraph> *SEEIIR = new SEEIIR_model<MLGraph>(*egraph);
+  SEEIIRcollector<MLGraph> *collector =
+    options.Nruns > 1 ?
+    new SEEIIRcollector_av<MLGraph>(*SEEIIR,1.) :
+    new SEEIIRcollector<MLGraph>(*SEEIIR);
+  Trajectory_writer *traj=0;
+  Run_archive       *archive=0;
+  if (options.trajfile && options.Nruns>1) {
+    archive=new Run_archive(options.trajfile,1.);
+    archive->add_run_info(argc,argv,options.seed,options.ifile);
+    static_cast<SEEIIRcollector_av<MLGraph>*>(collector)->set_archive(archive);
+  }
+  if (options.trajfile && !archive) {
+    traj=new Trajectory_writer(options.trajfile);
+    traj->add_run_info(argc,argv,options.seed,options.ifile);
+    collector->set_trajectory(traj);
+  } else {
+    std::cout << collector->header() << '\n';
+    if (options.Nruns==1) collector->set_async_output();
+  }
+  int extinct=0;
+  for (int n=0; n<options.Nruns; ++n) {
+    merge_events();
+    Sampler *sampler =  new Gillespie_sampler(0,options.steps,1.,collector);
+    extinct+=run(SEEIIR,sampler,event_queue,options.steps);
+    delete sampler;
+    if (archive) archive->end_run();
+  }
+  if (options.Nruns>1) {
+    std::cout << *collector;
+    print_extinction(std::cout,extinct,options.Nruns);
+  }
+  delete traj;
+  delete archive;
+  delete collector;
+  delete SEEIIR;
+  delete egraph;
+}
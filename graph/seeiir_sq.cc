@@ -22,6 +22,7 @@
 #include <string.h>
 
 #include "emodel.hh"
+#include "sqlattice.hh"
 #include "seir_collector.hh"
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -37,6 +38,8 @@ struct opt {
   long   seed;
 
   int    Lx,Ly;
+  bool   periodic;       // boundary conditions (default open)
+  char   *trajfile;       // binary trajectory or run archive (optional)
 
   // imported infections
   typedef std::vector<Forced_transition> forced_transition_t;
@@ -44,10 +47,10 @@ struct opt {
   std::string eifile;             // File to read imported infected cases
 
   // rates vs time
-  typedef std::vector<Rate_constant_change<SQGraph>> rates_vs_time_t;
+  typedef std::vector<Rate_constant_change<SQLattice>> rates_vs_time_t;
   rates_vs_time_t                           rates_vs_time;
 
-  opt() : last_arg_read(0) {}
+  opt() : last_arg_read(0), trajfile(0) {}
 
 } options;
 
@@ -62,7 +65,10 @@ static int nargs=4;
 
 void show_usage(char *prog)
 {
-  std::cerr << "usage: " << prog << " parameterfile seed steps Nruns\n\n";
+  std::cerr << "usage: " << prog << " parameterfile seed steps Nruns [trajfile]\n\n"
+	    << "If trajfile is given, for a single run (Nruns=1) the trajectory is written there\n"
+	    << "in binary form instead of to standard output, otherwise the counts of every run\n"
+	    << "are archived there (convert it to text with traj2txt)\n";
   exit(1);
 }
 
@@ -79,14 +85,23 @@ char *readbuf(FILE *f)
 void read_imported_infections();
 void read_rates_vs_time(FILE*);
 
+bool read_boundary(const char *bc)
+{
+  if (strcmp(bc,"periodic")==0) return true;
+  if (strcmp(bc,"open")!=0)
+    throw std::runtime_error(std::string("Unknown boundary conditions: ")+bc);
+  return false;
+}
+
 void read_parameters(int argc,char *argv[])
 {
-  if (argc!=nargs+1) show_usage(argv[0]);
+  if (argc!=nargs+1 && argc!=nargs+2) show_usage(argv[0]);
 
   read_arg(argv,options.ifile);
   read_arg(argv,options.seed);
   read_arg(argv,options.steps);
   read_arg(argv,options.Nruns);
+  if (argc==nargs+2) read_arg(argv,options.trajfile);
 
   FILE *f=fopen(options.ifile,"r");
   if (f==0) throw std::runtime_error(strerror(errno));
@@ -94,9 +109,12 @@ void read_parameters(int argc,char *argv[])
   printf("##### Parameters\n");
 
   buf=readbuf(f);
-  sscanf(buf,"%d %d",&options.Lx,&options.Ly);
+  char bc[20]="open";
+  sscanf(buf,"%d %d %19s",&options.Lx,&options.Ly,bc);
+  options.periodic=read_boundary(bc);
   printf("# Lx = %d\n",options.Lx);
   printf("# Ly = %d\n",options.Ly);
+  printf("# Boundary conditions: %s\n",options.periodic ? "periodic" : "open");
 
   printf("#\n# Nruns = %d\n",options.Nruns);
 
@@ -150,7 +168,7 @@ void read_rates_vs_time(FILE *f)
     if (sscanf(buf,"%lg %lg %lg %lg %lg %lg",&time,&b,&s1,&s2,&g1,&g2)!=6) {
       std::cerr  << "couldn't read record: " << buf << "\n";
       throw std::runtime_error(strerror(errno));}
-    options.rates_vs_time.push_back(Rate_constant_change<SQGraph>(time,b,s1,s2,g1,g2));
+    options.rates_vs_time.push_back(Rate_constant_change<SQLattice>(time,b,s1,s2,g1,g2));
   }
 }
 
@@ -197,19 +215,40 @@ int main(int argc,char* argv[])
   read_parameters(argc,argv);
   Random_number_generator RNG(options.seed);
 
-  SQGraph* egraph = SQGraph::create(options.Lx,options.Ly);
-  SEEIIR_model<SQGraph> SEEIIR(*egraph);
-  SEEIIRcollector<SQGraph> *collector =
+  SQLattice* egraph = SQLattice::create(options.Lx,options.Ly,options.periodic);
+  SEEIIR_model<SQLattice> SEEIIR(*egraph);
+  SEEIIRcollector<SQLattice> *collector =
     options.Nruns > 1 ?
-    new SEEIIRcollector_av<SQGraph>(SEEIIR,1.) :
-    new SEEIIRcollector<SQGraph>(SEEIIR);
-
-  std::cout << collector->header() << '\n';
+    new SEEIIRcollector_av<SQLattice>(SEEIIR,1.) :
+    new SEEIIRcollector<SQLattice>(SEEIIR);
+  Trajectory_writer *traj=0;
+  Run_archive       *archive=0;
+  if (options.trajfile && options.Nruns>1) {
+    archive=new Run_archive(options.trajfile,1.);
+    archive->add_run_info(argc,argv,options.seed,options.ifile);
+    static_cast<SEEIIRcollector_av<SQLattice>*>(collector)->set_archive(archive);
+  }
+  if (options.trajfile && !archive) {
+    traj=new Trajectory_writer(options.trajfile);
+    traj->add_run_info(argc,argv,options.seed,options.ifile);
+    collector->set_trajectory(traj);
+  } else {
+    std::cout << collector->header() << '\n';
+    if (options.Nruns==1) collector->set_async_output();
+  }
+  int extinct=0;
   for (int n=0; n<options.Nruns; ++n) {
     merge_events();
     Sampler *sampler =  new Gillespie_sampler(0,options.steps,1.,collector);
-    run(&SEEIIR,sampler,event_queue,options.steps);
+    extinct+=run(&SEEIIR,sampler,event_queue,options.steps);
     delete sampler;
+    if (archive) archive->end_run();
+  }
+  if (options.Nruns>1) {
+    std::cout << *collector;
+    print_extinction(std::cout,extinct,options.Nruns);
   }
-  if (options.Nruns>1) std::cout << *collector;
+  delete traj;
+  delete archive;
+  delete collector;
 }
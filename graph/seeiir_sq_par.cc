@@ -0,0 +1,263 @@
+/*
+ * seeiir_sq_par.cc -- SEEIIR model on the square lattice, in parallel
+ *                     (domain decomposition, see ddmodel.hh)
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ * 
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ * 
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ * 
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "emodel.hh"
+#include "ddmodel.hh"
+#include "seir_collector.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// simulation options and parameters
+
+struct opt {
+  int    last_arg_read;
+  
+  char   *ifile;
+  int    Nruns;
+  int    steps;
+  long   seed;
+
+  int    Lx,Ly;
+  bool   periodic;       // boundary conditions (default open)
+  int    nthreads;       // one domain per thread
+  char   *trajfile;       // binary trajectory or run archive (optional)
+
+  // imported infections
+  typedef std::vector<Forced_transition> forced_transition_t;
+  forced_transition_t                    forced_transitions;
+  std::string eifile;             // File to read imported infected cases
+
+  // rates vs time
+  typedef std::vector<Rate_constant_change<DDLattice>> rates_vs_time_t;
+  rates_vs_time_t                           rates_vs_time;
+
+  opt() : last_arg_read(0), trajfile(0) {}
+
+} options;
+
+static int nargs=5;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Read parameters from command-line and file, and compute
+// derived parameters
+
+#include "../read_arg.hh"
+
+void show_usage(char *prog)
+{
+  std::cerr << "usage: " << prog << " parameterfile seed steps Nruns nthreads [trajfile]\n\n"
+	    << "The lattice is split in nthreads strips, each simulated by one thread\n"
+	    << "(results are exact, not approximated, for any number of threads)\n\n"
+	    << "If trajfile is given, for a single run (Nruns=1) the trajectory is written there\n"
+	    << "in binary form instead of to standard output, otherwise the counts of every run\n"
+	    << "are archived there (convert it to text with traj2txt)\n";
+  exit(1);
+}
+
+char *readbuf(FILE *f)
+{
+  static char buf[1000];
+  char *s;
+  do
+    s=fgets(buf,1000,f);
+  while (*buf=='#');
+  return buf;
+}
+
+void read_imported_infections();
+void read_rates_vs_time(FILE*);
+
+bool read_boundary(const char *bc)
+{
+  if (strcmp(bc,"periodic")==0) return true;
+  if (strcmp(bc,"open")!=0)
+    throw std::runtime_error(std::string("Unknown boundary conditions: ")+bc);
+  return false;
+}
+
+void read_parameters(int argc,char *argv[])
+{
+  if (argc!=nargs+1 && argc!=nargs+2) show_usage(argv[0]);
+
+  read_arg(argv,options.ifile);
+  read_arg(argv,options.seed);
+  read_arg(argv,options.steps);
+  read_arg(argv,options.Nruns);
+  read_arg(argv,options.nthreads);
+  if (argc==nargs+2) read_arg(argv,options.trajfile);
+
+  FILE *f=fopen(options.ifile,"r");
+  if (f==0) throw std::runtime_error(strerror(errno));
+  char *buf;
+  printf("##### Parameters\n");
+
+  buf=readbuf(f);
+  char bc[20]="open";
+  sscanf(buf,"%d %d %19s",&options.Lx,&options.Ly,bc);
+  options.periodic=read_boundary(bc);
+  printf("# Lx = %d\n",options.Lx);
+  printf("# Ly = %d\n",options.Ly);
+  printf("# Boundary conditions: %s\n",options.periodic ? "periodic" : "open");
+
+  printf("#\n# Nruns = %d\n",options.Nruns);
+  printf("# Threads = %d\n",options.nthreads);
+
+  // Imported infections
+  buf=readbuf(f);
+  options.eifile=buf;
+  options.eifile.erase(options.eifile.end()-1);   // remove trailing newline
+  read_imported_infections();
+
+  printf("# Imported infections:\n");
+  printf("# Time   Cases\n");
+  int II=0;
+  for (auto iir: options.forced_transitions)
+    printf("# %g %d\n",iir.time,II+=iir.new_infected);
+
+  read_rates_vs_time(f);
+  fclose(f);
+  printf("#\n# Rate constatst:\n");
+  printf("# time beta sigma_1 sigma_2 gamma_1 gamma_2\n");
+  for (auto r:options.rates_vs_time)
+    printf("# %g %g %g %g %g %g\n",r.time,r.beta,r.sigma1,r.sigma2,r.gamma1,r.gamma2);
+}
+
+void read_imported_infections()
+{
+  FILE *f=fopen(options.eifile.c_str(),"r");
+  if (f==0) {
+    std::cerr << "Error opening file (" << options.eifile << ")\n";
+    throw std::runtime_error(strerror(errno));
+  }
+
+  double etime;
+  int   eI,eIold=0;
+  while (ungetc(fgetc(f),f)!=EOF) {
+    char *buf=readbuf(f);
+    if (sscanf(buf,"%lg %d",&etime,&eI)!=2) {
+      std::cerr  << "couldn't read record: " << buf << "\n";
+      throw std::runtime_error(strerror(errno));}
+    options.forced_transitions.push_back(Forced_transition(etime,eI-eIold,0));
+    eIold=eI;
+  }
+  
+  fclose(f);
+}
+
+void read_rates_vs_time(FILE *f)
+{
+  double time,b,s1,s2,g1,g2;
+  while (ungetc(fgetc(f),f)!=EOF) {
+    char *buf=readbuf(f);
+    if (sscanf(buf,"%lg %lg %lg %lg %lg %lg",&time,&b,&s1,&s2,&g1,&g2)!=6) {
+      std::cerr  << "couldn't read record: " << buf << "\n";
+      throw std::runtime_error(strerror(errno));}
+    options.rates_vs_time.push_back(Rate_constant_change<DDLattice>(time,b,s1,s2,g1,g2));
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// merge_events()
+
+event_queue_t event_queue;
+
+/*
+ * build a time ordered queue of beta and imported infection changes
+ * closes with dummy event at infinite time
+ *
+ */
+
+void merge_events()
+{
+  while (!event_queue.empty()) event_queue.pop();
+  
+  auto ii_begin=options.forced_transitions.begin();
+  auto ii_end=options.forced_transitions.end();
+  auto ir_begin=options.rates_vs_time.begin();
+  auto ir_end=options.rates_vs_time.end();
+  
+  auto ii=ii_begin;
+  auto ir=ir_begin;
+  while ( ii!=ii_end  || ir!=ir_end ) {
+
+    while (ii!=ii_end && (ir==ir_end || ii->time <= ir->time ) ) {
+      event_queue.push(&(*ii));
+      ++ii;
+    }
+
+    while (ir!=ir_end && (ii==ii_end || ir->time <= ii->time) ) {
+      event_queue.push(&(*ir));
+      ++ir;
+    }
+
+  }
+}
+
+int main(int argc,char* argv[])
+{
+  read_parameters(argc,argv);
+  Random_number_generator RNG(options.seed);
+
+  DDLattice* egraph = DDLattice::create(options.Lx,options.Ly,options.periodic,
+					options.nthreads);
+  SEEIIR_model<DDLattice> *SEEIIR = new SEEIIR_model<DDLattice>(*egraph);
+  SEEIIRcollector<DDLattice> *collector =
+    options.Nruns > 1 ?
+    new SEEIIRcollector_av<DDLattice>(*SEEIIR,1.) :
+    new SEEIIRcollector<DDLattice>(*SEEIIR);
+  Trajectory_writer *traj=0;
+  Run_archive       *archive=0;
+  if (options.trajfile && options.Nruns>1) {
+    archive=new Run_archive(options.trajfile,1.);
+    archive->add_run_info(argc,argv,options.seed,options.ifile);
+    static_cast<SEEIIRcollector_av<DDLattice>*>(collector)->set_archive(archive);
+  }
+  if (options.trajfile && !archive) {
+    traj=new Trajectory_writer(options.trajfile);
+    traj->add_run_info(argc,argv,options.seed,options.ifile);
+    collector->set_trajectory(traj);
+  } else {
+    std::cout << collector->header() << '\n';
+    if (options.Nruns==1) collector->set_async_output();
+  }
+  int extinct=0;
+  for (int n=0; n<options.Nruns; ++n) {
+    merge_events();
+    Sampler *sampler =  new Gillespie_sampler(0,options.steps,1.,collector);
+    extinct+=run(SEEIIR,sampler,event_queue,options.steps,1.);
+    delete sampler;
+    if (archive) archive->end_run();
+  }
+  if (options.Nruns>1) {
+    std::cout << *collector;
+    print_extinction(std::cout,extinct,options.Nruns);
+  }
+  delete traj;
+  delete archive;
+  delete collector;
+  delete SEEIIR;
+  delete egraph;
+}
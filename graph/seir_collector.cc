@@ -106,6 +106,34 @@ void SEIRcollector_base::print(std::ostream& o,bool print_time)
   print_detail(o,R);
 }
 
+int SEIRcollector_base::fill_row(double *row)
+{
+  int n=0;
+  row[n++]=time;
+  row[n++]=std::accumulate(S.begin(),S.end(),0.);
+  if (E.size()>0) row[n++]=std::accumulate(E.begin(),E.end(),0.);
+  row[n++]=std::accumulate(I.begin(),I.end(),0.);
+  row[n++]=std::accumulate(R.begin(),R.end(),0.);
+  for (auto v : {&S,&E,&I,&R})
+    if (v->size()>1)
+      for (double x : *v) row[n++]=x;
+  return n;
+}
+
+std::string SEIRcollector_base::column_formats()
+{
+  int n=1+(E.size()>0 ? 4 : 3);
+  for (auto v : {&S,&E,&I,&R})
+    if (v->size()>1) n+=v->size();
+  return std::string(n,'g');
+}
+
+void SEIRcollector_base::set_trajectory(Trajectory_writer *t)
+{
+  traj=t;
+  traj->begin(header(),column_formats());
+}
+
 static void print_detail(std::ostream& o,const std::vector<double>& v)
 {
   if (v.size()<=1) return;
@@ -21,7 +21,10 @@
 #ifndef SEIR_COLLECTOR_HH
 #define SEIR_COLLECTOR_HH
 
-#include "../geoave.hh"
+#include "../multi_geoave.hh"
+#include "../tdigest.hh"
+#include "../trajfile.hh"
+#include "../async_writer.hh"
 #include "esampler.hh"
 #include "sirmodel.hh"
 #include "seirmodel.hh"
@@ -36,7 +39,11 @@ public:
 
   virtual const char *header();
   virtual void print(std::ostream&,bool print_time=true);
-  virtual ~SEIRcollector_base() {}
+  void set_trajectory(Trajectory_writer*);   // collect() writes rows there (binary) instead
+                                             // of printing them (see trajfile.hh)
+  void set_async_output()                    // collect() leaves formatting and writing of
+  {async=new Text_rows(std::cout,column_formats(),row_end());}  // rows to a separate thread
+  virtual ~SEIRcollector_base() {delete async;}   // (see async_writer.hh)
 
   double time;
   std::vector<double> S,E,I,R;
@@ -44,12 +51,19 @@ public:
 protected:
   void create_colnums(int);
   void addSIRhdr();
+  int  fill_row(double *row);                // the values print() writes, returns how many
+  virtual std::string column_formats();      // 'g' (real) or 'd' (integer) for each column
+  virtual const char *row_end() {return " \n";}   // what print() leaves at the end of a row
   std::string hdr;
   std::string colnums;
+  Trajectory_writer *traj;
+  Text_rows         *async;
 } ;
 	       
 inline SEIRcollector_base::SEIRcollector_base(int NS,int NE,int NI,int NR) :
-  S(NS,0.), E(NE,0.), I(NI,0.), R(NR,0.)
+  S(NS,0.), E(NE,0.), I(NI,0.), R(NR,0.),
+  traj(0),
+  async(0)
 {}
 
 inline std::ostream& operator<<(std::ostream& o,SEIRcollector_base& state)
@@ -86,7 +100,13 @@ void SIRcollector<EGraph>::collect(double time_)
   I[0]=anode->NI;
   R[0]=anode->NR;
 
-  std::cout << *this << '\n';
+  if (traj || async) {
+    double row[4];
+    fill_row(row);
+    if (traj) traj->push(row);
+    else async->push(row);
+  } else
+    std::cout << *this << '\n';
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -100,18 +120,21 @@ public:
 
   SIRcollector_av(SIR_model<EGraph> &model,double deltat=1.) :
     SIRcollector<EGraph>(model),
-    Sav(-0.5*deltat,1.,deltat),
-    Iav(-0.5*deltat,1.,deltat),
-    Rav(-0.5*deltat,1.,deltat),
+    av(ncols,-0.5*deltat,1.,deltat),
+    archive(0),
     hdr( SEIRcollector_base::hdr)
   {}
 
   const char* header();
   void print(std::ostream&,bool print_time=true);
   void collect(double time);
+  void set_archive(Run_archive *a)    // also store every sample there (see trajfile.hh)
+  {archive=a; archive->begin("S I R");}
 
 private:
-  Geoave Sav,Iav,Rav;
+  enum {cS,cI,cR,ncols};
+  Multi_geoave av;
+  Run_archive  *archive;
   std::string &hdr;
   using SEIRcollector_base::time;
   using SEIRcollector_base::S;
@@ -138,28 +161,31 @@ void SIRcollector_av<EGraph>::collect(double time)
 {
   typename model_t::aggregate_node *anode=model.anodemap[model.hroot];
 
-  Sav.push(time,anode->NS);
-  Iav.push(time,anode->NI);
-  Rav.push(time,anode->NR);
+  double row[ncols];
+  row[cS]=anode->NS;
+  row[cI]=anode->NI;
+  row[cR]=anode->NR;
+  av.push(time,row);
+  if (archive) archive->push(time,row);
 }
 
 template <typename EGraph>
 void SIRcollector_av<EGraph>::print(std::ostream& o,bool print_time)
 {
-  std::vector<double> tim,Sa,Sv,Ia,Iv,Ra,Rv;
-  Sav.get_aves(tim,Sa,Sv);
-  Iav.get_aves(tim,Ia,Iv);
-  Rav.get_aves(tim,Ra,Rv);
+  std::vector<double> tim,ave,var;
+  av.get_aves(tim,ave,var);
 
-  for (int i=0; i<Sv.size(); ++i) {
+  for (int i=0; i<tim.size(); ++i) {
+    const double *a=&ave[i*ncols];
+    const double *v=&var[i*ncols];
     time=tim[i];
-    S[0]=Sa[i];
-    I[0]=Ia[i];
-    R[0]=Ra[i];
+    S[0]=a[cS];
+    I[0]=a[cI];
+    R[0]=a[cR];
     SEIRcollector_base::print(o,print_time);
-    S[0]=Sv[i];
-    I[0]=Iv[i];
-    R[0]=Rv[i];
+    S[0]=v[cS];
+    I[0]=v[cI];
+    R[0]=v[cR];
     SEIRcollector_base::print(o,false);
     o << '\n';
   }
@@ -187,6 +213,8 @@ public:
 
 protected:
   SEEIIR_model<EGraph> &model;
+  std::string column_formats() {return SEIRcollector_base::column_formats()+"ddddg";}
+  const char *row_end() {return "\n";}
 
 private:
   double time0;
@@ -209,7 +237,31 @@ template <typename EGraph>
 void SEEIIRcollector<EGraph>::collect(double time_)
 {
   time=time_;
-  std::cout << *this << '\n';
+  if (traj==0 && async==0) {
+    std::cout << *this << '\n';
+    return;
+  }
+
+  typename model_t::aggregate_data *anode=model.anodemap[model.hroot];
+  S[0]=anode->NS;
+  E[0]=anode->NE1;
+  E[1]=anode->NE2;
+  I[0]=anode->NI1;
+  I[1]=anode->NI2;
+  R[0]=anode->NR;
+
+  double row[14];
+  int n=fill_row(row);
+  row[n++]=anode->inf_imported;
+  row[n++]=anode->inf_close;
+  row[n++]=anode->inf_community;
+  row[n++]=anode->inf_accum;
+  row[n++]=model.tinf() * (anode->Eacc-Eacc0)/( (time-time0) * I0 );
+  time0=time;
+  Eacc0=anode->Eacc;
+  I0=anode->NI1+anode->NI2;
+  if (traj) traj->push(row);
+  else async->push(row);
 }
 
 template <typename EGraph>
@@ -231,7 +283,7 @@ void SEEIIRcollector<EGraph>::print(std::ostream& o,bool print_time)
 
   char buf[500];
   sprintf(buf,"%11d %11d %11d %11d %11.6g",anode->inf_imported,anode->inf_close,anode->inf_community,anode->inf_accum,RR);
-  std::cout << buf;
+  o << buf;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -245,19 +297,9 @@ public:
 
   SEEIIRcollector_av(SEEIIR_model<EGraph> &model,double deltat=1.) :
     SEEIIRcollector<EGraph>(model),
-    Sav(-0.5*deltat,1.,deltat),
-    E1av(-0.5*deltat,1.,deltat),
-    E2av(-0.5*deltat,1.,deltat),
-    I1av(-0.5*deltat,1.,deltat),
-    I2av(-0.5*deltat,1.,deltat),
-    Rav(-0.5*deltat,1.,deltat),
-    Impav(-0.5*deltat,1.,deltat),
-    Closeav(-0.5*deltat,1.,deltat),
-    Commav(-0.5*deltat,1.,deltat),
-    Nav(-0.5*deltat,1.,deltat),
-    Totalinf(-0.5*deltat,1.,deltat),
-    RR(-0.5*deltat,1.,deltat),
-    Eacc(-0.5*deltat,1.,deltat),
+    av(ncols,-0.5*deltat,1.,deltat),
+    quant(nqcols),
+    archive(0),
     time0(0),
     I0(0), Eacc0(0),
     hdr(SEIRcollector_base::hdr)
@@ -266,9 +308,15 @@ public:
   const char* header();
   void print(std::ostream&,bool print_time=true);
   void collect(double time);
+  void set_archive(Run_archive *a)    // also store every sample there (counts only, see trajfile.hh)
+  {archive=a; archive->begin("N S E1 E2 I1 I2 R Imported CloseCntct Community Total");}
 
 private:
-  Geoave Sav,E1av,E2av,I1av,I2av,Rav,Impav,Closeav,Commav,Nav,Totalinf,RR,Eacc;
+  enum {cN,cS,cE1,cE2,cI1,cI2,cR,cImp,cClose,cComm,cTotal,cRR,cEacc,ncols};
+  enum {qS,qE,qI,qR,nqcols};
+  Multi_geoave     av;
+  Window_quantiles quant;           // quantiles of S, E, I and R
+  Run_archive      *archive;
   double time0;
   int    I0,Eacc0;
 
@@ -288,14 +336,16 @@ template <typename EGraph>
 const char *SEEIIRcollector_av<EGraph>::header()
 {
   hdr.clear();
-  create_colnums(27);
+  create_colnums(27+nqcols*Window_quantiles::nprobs);
   hdr=colnums;
-  hdr+="#           |---------------------------------------------------------------------- Average --------------------------------------------------------------------------| |------------------------------------------------------------------------ Variance -----------------------------------------------------------------------|\n";
+  hdr+="#           |---------------------------------------------------------------------- Average --------------------------------------------------------------------------| |------------------------------------------------------------------------ Variance -----------------------------------------------------------------------| |----------------------------------------------------------------------------------------------------------------- Quantiles -----------------------------------------------------------------------------------------------------------------|\n";
   hdr+="#      time ";
   addSIRhdr();
   hdr+="   Imported  CloseCntct   Community       Total R(Rep.Rate) ";
   addSIRhdr();
   hdr+="   Imported  CloseCntct   Community       Total R(Rep.Rate)";
+  static const char* const qnames[nqcols]={"S","E","I","R"};
+  quant.add_header(hdr,qnames);
   return hdr.c_str();
 }  
 
@@ -304,18 +354,19 @@ void SEEIIRcollector_av<EGraph>::collect(double time_)
 {
   typename model_t::aggregate_data *anode=model.anodemap[model.hroot];
   time=time_;
-  Nav.push(time_,anode->Ntot);
-  Sav.push(time_,anode->NS);
-  E1av.push(time_,anode->NE1);
-  E2av.push(time_,anode->NE2);
-  I1av.push(time_,anode->NI1);
-  I2av.push(time_,anode->NI2);
-  Rav.push(time_,anode->NR);
-  Impav.push(time,anode->inf_imported);
-  Closeav.push(time,anode->inf_close);
-  Commav.push(time,anode->inf_community);
-  Totalinf.push(time,anode->inf_accum);
-  Eacc.push(time,anode->Eacc);
+  double row[ncols];
+  row[cN]=anode->Ntot;
+  row[cS]=anode->NS;
+  row[cE1]=anode->NE1;
+  row[cE2]=anode->NE2;
+  row[cI1]=anode->NI1;
+  row[cI2]=anode->NI2;
+  row[cR]=anode->NR;
+  row[cImp]=anode->inf_imported;
+  row[cClose]=anode->inf_close;
+  row[cComm]=anode->inf_community;
+  row[cTotal]=anode->inf_accum;
+  row[cEacc]=anode->Eacc;
 
   S[0]=anode->NS;
   E[0]=anode->NE1;
@@ -324,64 +375,71 @@ void SEEIIRcollector_av<EGraph>::collect(double time_)
   I[1]=anode->NI2;
   R[0]=anode->NR;
 
-  double RRi = model.tinf() * (anode->Eacc-Eacc0)/( (time-time0) * I0 );
+  row[cRR] = model.tinf() * (anode->Eacc-Eacc0)/( (time-time0) * I0 );
   time0=time;
   Eacc0=anode->Eacc;
   I0=anode->NI1+anode->NI2;
-  RR.push(time,RRi);
+  int n=av.push(time,row);
+
+  double qrow[nqcols];
+  qrow[qS]=anode->NS;
+  qrow[qE]=anode->NE1+anode->NE2;
+  qrow[qI]=anode->NI1+anode->NI2;
+  qrow[qR]=anode->NR;
+  quant.push(n,qrow);
+  if (archive) archive->push(time,row);    // the first columns (up to cTotal) are the counts
 }
 
 template <typename EGraph>
 void SEEIIRcollector_av<EGraph>::print(std::ostream& o,bool print_time)
 {
-  std::vector<double> tim,Sa,Sv,E1a,E1v,E2a,E2v,I1a,I1v,I2a,I2v,Ra,Rv,
-    impa,impv,closea,closev,comma,commv,totala,totalv,Na,Nv,RRa,RRv,Eacca,Eaccv;
-  Nav.get_aves(tim,Na,Nv);
-  Sav.get_aves(tim,Sa,Sv);
-  E1av.get_aves(tim,E1a,E1v);
-  E2av.get_aves(tim,E2a,E2v);
-  I1av.get_aves(tim,I1a,I1v);
-  I2av.get_aves(tim,I2a,I2v);
-  Rav.get_aves(tim,Ra,Rv);
-  Impav.get_aves(tim,impa,impv);
-  Closeav.get_aves(tim,closea,closev);
-  Commav.get_aves(tim,comma,commv);
-  Totalinf.get_aves(tim,totala,totalv);
-  RR.get_aves(tim,RRa,RRv);
-  Eacc.get_aves(tim,Eacca,Eaccv);
+  std::vector<double> tim,ave,var;
+  av.get_aves(tim,ave,var);
 
   char buf[500];
-  for (int i=0; i<Sv.size(); ++i) {
+  int  n=-1;
+  for (int i=0; i<tim.size(); ++i) {
+    const double *a=&ave[i*ncols];
+    const double *v=&var[i*ncols];
     time=tim[i];
-    S[0]=Sa[i];
-    E[0]=E1a[i];
-    E[1]=E2a[i];
-    I[0]=I1a[i];
-    I[1]=I2a[i];
-    R[0]=Ra[i];
+    S[0]=a[cS];
+    E[0]=a[cE1];
+    E[1]=a[cE2];
+    I[0]=a[cI1];
+    I[1]=a[cI2];
+    R[0]=a[cR];
 
     SEIRcollector_base::print(o,print_time);
 #ifdef ALT_R0
-    double RR = (i>0) ? model.tinf() * (Eacca[i]-Eacca[i-1])/( (time-tim[i-1]) * (I1a[i-1]+I2a[i]) ) : 0 ;
-    sprintf(buf,"%11.6g %11.6g %11.6g %11.6g %11.6g ",impa[i],closea[i],comma[i],totala[i],RR);
+    double RR=0;
+    if (i>0) {
+      const double *ap=&ave[(i-1)*ncols];
+      RR = model.tinf() * (a[cEacc]-ap[cEacc])/( (time-tim[i-1]) * (ap[cI1]+a[cI2]) );
+    }
+    sprintf(buf,"%11.6g %11.6g %11.6g %11.6g %11.6g ",a[cImp],a[cClose],a[cComm],a[cTotal],RR);
 #else
-    sprintf(buf,"%11.6g %11.6g %11.6g %11.6g %11.6g ",impa[i],closea[i],comma[i],totala[i],RRa[i]);
+    sprintf(buf,"%11.6g %11.6g %11.6g %11.6g %11.6g ",a[cImp],a[cClose],a[cComm],a[cTotal],a[cRR]);
 #endif
-    std::cout << buf;
-
-    S[0]=Sv[i];
-    E[0]=E1v[i];
-    E[1]=E2v[i];
-    I[0]=I1v[i];
-    I[1]=I2v[i];
-    R[0]=Rv[i];
+    o << buf;
+
+    S[0]=v[cS];
+    E[0]=v[cE1];
+    E[1]=v[cE2];
+    I[0]=v[cI1];
+    I[1]=v[cI2];
+    R[0]=v[cR];
     SEIRcollector_base::print(o,false);
 #ifdef ALT_R0
-    sprintf(buf,"%11.6g %11.6g %11.6g %11.6g      ----  ",impv[i],closev[i],commv[i],totalv[i]);
+    sprintf(buf,"%11.6g %11.6g %11.6g %11.6g      ----  ",v[cImp],v[cClose],v[cComm],v[cTotal]);
 #else
-    sprintf(buf,"%11.6g %11.6g %11.6g %11.6g %11.6g",impv[i],closev[i],commv[i],totalv[i],RRv[i]);
+    sprintf(buf,"%11.6g %11.6g %11.6g %11.6g %11.6g",v[cImp],v[cClose],v[cComm],v[cTotal],v[cRR]);
 #endif 
-    std::cout << buf << '\n';
+    o << buf;
+
+    // rows returned by get_aves() are the windows with data, in order
+    for (++n; av.Nsamp(n)==0; ++n) ;
+    quant.print(o,n);
+    o << '\n';
   }
 }
 
@@ -35,10 +35,10 @@ void SEEIIR_model<MWFCGraph>::compute_rates(typename MWFCGraph::igraph_t::Node n
       if (snode==node) continue;
       auto tnode=inodemap[snode];
       if (tnode.state==SEEIIR_node::I1 || tnode.state==SEEIIR_node::I2) {
-	w+=egraph.arc_weight(node,snode);
+	w+=egraph.node_factor(snode);
       }
     }
-    rate=beta*w;
+    rate=beta*egraph.node_factor(node)*w;
     break;
   case SEEIIR_node::E1:
     rate=sigma1;
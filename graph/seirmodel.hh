@@ -45,6 +45,10 @@ public:
 			  double gamma2);
 
   double tinf() { return 1./gamma1 + 1./gamma2;}
+  bool   extinct() {
+    aggregate_data *r=anodemap[hroot];
+    return r->NE1+r->NE2+r->NI1+r->NI2==0;
+  }
 
   struct SEEIIR_node {
     enum {S,E1,E2,I1,I2,R} state;
@@ -199,13 +203,10 @@ void SEEIIR_model<EGraph>::compute_rates(typename EGraph::igraph_t::Node node)
 
   switch(noded.state) {
   case SEEIIR_node::S:
-    w=0;
-    for (typename EGraph::igraph_t::OutArcIt arc(egraph.igraph,node); arc!=lemon::INVALID; ++arc) {
-      auto tnode=inodemap[egraph.igraph.target(arc)];
-      if (tnode.state==SEEIIR_node::I1 || tnode.state==SEEIIR_node::I2) {
-	w+=egraph.arc_weight(arc);
-      }
-    }
+    w=weight_to(egraph,node,
+		[this](typename EGraph::inode_t t) -> bool
+		{auto state=this->inodemap[t].state;
+		  return state==SEEIIR_node::I1 || state==SEEIIR_node::I2;} );
     rate=beta*w;
     break;
   case SEEIIR_node::E1:
@@ -345,11 +346,15 @@ public:
   double beta,sigma1,sigma2,gamma1,gamma2;
 } ;
 
+// With no exposed nor infected all rates are zero whatever the
+// constants, and imported infections recompute the rates they affect,
+// so the (full graph) recomputation is skipped after extinction
 template<typename EGraph>
 inline void Rate_constant_change<EGraph>::apply(Epidemiological_model *em)
 {
   (dynamic_cast<SEEIIR_model<EGraph>*>(em))->set_rate_constants(beta,sigma1,sigma2,gamma1,gamma2);
-  (dynamic_cast<SEEIIR_model<EGraph>*>(em))->compute_all_rates();
+  if (!em->extinct())
+    (dynamic_cast<SEEIIR_model<EGraph>*>(em))->compute_all_rates();
 }
 
 #endif /* SEIRMODEL_HH */
@@ -22,6 +22,11 @@
 #include <string.h>
 
 #include "emodel.hh"
+#ifdef DEBUG_FCGRAPH
+#include "fcmodel.hh"
+#else
+#include "sqlattice.hh"
+#endif
 #include "seir_collector.hh"
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -37,12 +42,14 @@ struct opt {
   long   seed;
 
   int    Lx,Ly;
+  bool   periodic;       // boundary conditions (default open)
   int    I0;
 
   double beta;
   double gamma;
+  char   *trajfile;       // binary trajectory or run archive (optional)
 
-  opt() : last_arg_read(0) {}
+  opt() : last_arg_read(0), trajfile(0) {}
 
 } options;
 
@@ -57,7 +64,10 @@ static int nargs=4;
 
 void show_usage(char *prog)
 {
-  std::cerr << "usage: " << prog << " parameterfile seed steps Nruns\n\n";
+  std::cerr << "usage: " << prog << " parameterfile seed steps Nruns [trajfile]\n\n"
+	    << "If trajfile is given, for a single run (Nruns=1) the trajectory is written there\n"
+	    << "in binary form instead of to standard output, otherwise the counts of every run\n"
+	    << "are archived there (convert it to text with traj2txt)\n";
   exit(1);
 }
 
@@ -71,27 +81,39 @@ char *readbuf(FILE *f)
   return buf;
 }
 
+bool read_boundary(const char *bc)
+{
+  if (strcmp(bc,"periodic")==0) return true;
+  if (strcmp(bc,"open")!=0)
+    throw std::runtime_error(std::string("Unknown boundary conditions: ")+bc);
+  return false;
+}
+
 void read_parameters(int argc,char *argv[])
 {
-  if (argc!=nargs+1) show_usage(argv[0]);
+  if (argc!=nargs+1 && argc!=nargs+2) show_usage(argv[0]);
 
   read_arg(argv,options.ifile);
   read_arg(argv,options.seed);
   read_arg(argv,options.steps);
   read_arg(argv,options.Nruns);
+  if (argc==nargs+2) read_arg(argv,options.trajfile);
 
   FILE *f=fopen(options.ifile,"r");
   if (f==0) throw std::runtime_error(strerror(errno));
   char *buf=readbuf(f);
   sscanf(buf,"%lg %lg",&options.beta,&options.gamma);
   buf=readbuf(f);
-  sscanf(buf,"%d %d %d",&options.Lx,&options.Ly,&options.I0);
+  char bc[20]="open";
+  sscanf(buf,"%d %d %d %19s",&options.Lx,&options.Ly,&options.I0,bc);
+  options.periodic=read_boundary(bc);
   fclose(f);
 
   printf("##### Parameters\n");
   printf("# beta = %g\n",options.beta);
   printf("# gamma = %g\n",options.gamma);
   printf("# Lx, Ly = %d, %d\n",options.Lx,options.Ly);
+  printf("# Boundary conditions: %s\n",options.periodic ? "periodic" : "open");
   printf("# I0 = %d\n",options.I0);
   printf("# Number of runs = %d\n",options.Nruns);
 }
@@ -103,21 +125,37 @@ int main(int argc,char* argv[])
   Random_number_generator RNG(options.seed);
 
 #ifdef DEBUG_FCGRAPH
-  FCGraph* egraph = FCGraph::create(options.Lx*options.Ly);
+  IFCGraph* egraph = IFCGraph::create(options.Lx*options.Ly);
 #else
-  SQGraph* egraph = SQGraph::create(options.Lx,options.Ly);
+  SQLattice* egraph = SQLattice::create(options.Lx,options.Ly,options.periodic);
 #endif
 
   { // open scope so that SIR_model object is destroyed before calling
     // delete on the graph
     
 #ifdef DEBUG_FCGRAPH
-    SIR_model<FCGraph> SIR(*egraph);
-    SIRcollector_av<FCGraph> collector(SIR);
+    SIR_model<IFCGraph> SIR(*egraph);
+    SIRcollector_av<IFCGraph> collector_av(SIR);
+    SIRcollector<IFCGraph> collector_traj(SIR);
 #else
-    SIR_model<SQGraph> SIR(*egraph);
-    SIRcollector_av<SQGraph> collector(SIR);
+    SIR_model<SQLattice> SIR(*egraph);
+    SIRcollector_av<SQLattice> collector_av(SIR);
+    SIRcollector<SQLattice> collector_traj(SIR);
 #endif
+    SEIRcollector_base *collector=&collector_av;
+    Trajectory_writer  *traj=0;
+    Run_archive        *archive=0;
+    if (options.trajfile && options.Nruns>1) {
+      archive=new Run_archive(options.trajfile,1.);
+      archive->add_run_info(argc,argv,options.seed,options.ifile);
+      collector_av.set_archive(archive);
+    }
+    if (options.trajfile && !archive) {
+      traj=new Trajectory_writer(options.trajfile);
+      traj->add_run_info(argc,argv,options.seed,options.ifile);
+      collector_traj.set_trajectory(traj);
+      collector=&collector_traj;
+    }
     SIR.set_beta(options.beta);
     SIR.set_gamma(options.gamma);
 
@@ -125,15 +163,20 @@ int main(int argc,char* argv[])
     Forced_transition iinf(1,options.I0,0);
     events.push(&iinf);
 
-    std::cout << collector.header() << '\n';
+    if (!traj) std::cout << collector->header() << '\n';
+    int extinct=0;
     for (int n=0; n<options.Nruns; ++n) {
       Sampler *sampler = options.Nruns>1 ?
-	static_cast<Sampler*>( new Gillespie_sampler(0,options.steps,1.,&collector)  ) :
-	new Passthrough_sampler(0,options.steps,&collector) ;
-      run(&SIR,sampler,events,options.steps);
+	static_cast<Sampler*>( new Gillespie_sampler(0,options.steps,1.,collector)  ) :
+	new Passthrough_sampler(0,options.steps,collector) ;
+      extinct+=run(&SIR,sampler,events,options.steps);
       delete sampler;
+      if (archive) archive->end_run();
     }
-    std::cout << collector;
+    delete archive;
+    if (traj) delete traj;
+    else std::cout << *collector;
+    if (options.Nruns>1) print_extinction(std::cout,extinct,options.Nruns);
   }
   
   delete egraph;
@@ -45,6 +45,7 @@ public:
   void add_imported(Forced_transition*);
   void set_beta(double b) {beta=b;}
   void set_gamma(double g) {gamma=g;}
+  bool extinct() {return this->anodemap[hroot]->NI==0;}
 
   struct SIR_node {
     enum {S,I,R} state;
@@ -186,11 +187,9 @@ void SIR_model<EGraph>::compute_rates(typename EGraph::igraph_t::Node node)
 
   switch(noded.state) {
   case SIR_node::S:
-    w=0;
-    for (typename EGraph::igraph_t::OutArcIt arc(egraph.igraph,node); arc!=lemon::INVALID; ++arc) {
-      auto tnode=inodemap[egraph.igraph.target(arc)];
-      if (tnode.state==SIR_node::I) w+=egraph.arc_weight(arc);
-    }
+    w=weight_to(egraph,node,
+		[this](typename EGraph::inode_t t) -> bool
+		{return this->inodemap[t].state==SIR_node::I;} );
     rate=beta*w;
     break;
   case SIR_node::I:
@@ -0,0 +1,47 @@
+/*
+ * sqlattice.cc -- implicit square lattice
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <limits>
+#include <stdexcept>
+
+#include "sqlattice.hh"
+
+SQLattice::SQLattice(int Lx,int Ly,bool periodic,double default_arc_weight) :
+  default_arc_weight(default_arc_weight)
+{
+  igraph.N=Lx*Ly;
+  igraph.Lx=Lx;
+  igraph.Ly=Ly;
+  igraph.periodic=periodic;
+  hgraph.root=igraph.N;
+  hroot=Node(igraph.N);
+  inode_count=igraph.N;
+}
+
+// With periodic boundaries each side must be at least 3, else the
+// neighbours in opposite directions would coincide
+SQLattice* SQLattice::create(int Lx,int Ly,bool periodic)
+{
+  if (Lx<1 || Ly<1 || (periodic && (Lx<3 || Ly<3)))
+    throw std::runtime_error("SQLattice: bad lattice size");
+  if ((long) Lx*Ly>=std::numeric_limits<int>::max())
+    throw std::runtime_error("SQLattice: too many nodes");
+  return new SQLattice(Lx,Ly,periodic);
+}
@@ -0,0 +1,227 @@
+/*
+ * sqlattice.hh -- implicit square lattice
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#ifndef SQLATTICE_HH
+#define SQLATTICE_HH
+
+#include <vector>
+
+#include <lemon/core.h>
+
+#include "../qdrandom.hh"
+#include "arcweight.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SQLattice
+//
+// Square lattice of Lx x Ly individuals with open or periodic
+// boundaries, offering the interface of Graph_base (as CSRGraph does)
+// but storing nothing per node or arc: node (x,y) is number x+y*Lx,
+// and its (up to four) neighbours are computed when the arcs are
+// scanned.  The arc weight is uniform.
+//
+// All individuals hang from the root, which is the only aggregate
+// node.  Unlike the other graphs, hgraph holds only the aggregate
+// nodes (i.e. only the root, numbered Lx*Ly), so that the models do
+// not keep per-individual aggregate data.
+//
+// The memory needed is thus only that of the model (about 40 bytes
+// per individual), so that lattices of 10^4 x 10^4 fit in a few GB.
+
+class SQLattice {
+public:
+  class Node {
+  public:
+    Node() {}
+    explicit Node(int i) : i(i) {}
+    Node(lemon::Invalid) : i(-1) {}
+    bool operator==(Node n) const {return i==n.i;}
+    bool operator!=(Node n) const {return i!=n.i;}
+    bool operator<(Node n) const {return i<n.i;}
+
+    int i;
+  } ;
+
+  // k is the direction (0 to 3: -y, -x, +x, +y), -1 for INVALID
+  class Arc {
+  public:
+    Arc() {}
+    Arc(int s,int t,int k) : s(s), t(t), k(k) {}
+    Arc(lemon::Invalid) : k(-1) {}
+    bool operator==(Arc a) const {return k==a.k && (k<0 || (s==a.s && t==a.t));}
+    bool operator!=(Arc a) const {return !(*this==a);}
+
+    int s,t,k;
+  } ;
+
+  // Individual (contact) graph
+  class Igraph {
+  public:
+    typedef SQLattice::Node Node;
+    typedef SQLattice::Arc  Arc;
+
+    Node source(Arc a) const {return Node(a.s);}
+    Node target(Arc a) const {return Node(a.t);}
+    int  id(Node n) const {return n.i;}
+    Node nodeFromId(int i) const {return Node(i);}
+    int  nodeNum() const {return N;}
+
+    // neighbour of node i=(x,y) in direction k, -1 if none
+    int  neighbour(int i,int x,int y,int k) const;
+
+    template <typename T>
+    class NodeMap : public std::vector<T> {
+    public:
+      NodeMap(const Igraph& g,const T& v=T()) : std::vector<T>(g.N,v) {}
+      T&       operator[](Node n) {return std::vector<T>::operator[](n.i);}
+      const T& operator[](Node n) const {return std::vector<T>::operator[](n.i);}
+    } ;
+
+    class NodeIt : public Node {
+    public:
+      NodeIt(lemon::Invalid) : Node(lemon::INVALID) {}
+      NodeIt(const Igraph& g) : Node(g.N>0 ? 0 : -1), N(g.N) {}
+      NodeIt& operator++() {if (++i==N) i=-1; return *this;}
+    private:
+      int N;
+    } ;
+
+    // Out- and in-arcs are the same links; the iterator finds the
+    // neighbour of the node at each direction and stores it as target
+    // (out) or source (in)
+    template <bool out>
+    class ArcIt : public Arc {
+    public:
+      ArcIt(lemon::Invalid) : Arc(lemon::INVALID) {}
+      ArcIt(const Igraph& g,Node n) :
+	Arc(n.i,n.i,-1), g(&g), x(n.i%g.Lx), y(n.i/g.Lx) {set();}
+      ArcIt& operator++() {set(); return *this;}
+    private:
+      const Igraph *g;
+      int          x,y;
+      void set() {
+	int j;
+	do {
+	  if (++k>3) {k=-1; return;}
+	  j=g->neighbour(out ? s : t,x,y,k);
+	} while (j<0);
+	if (out) t=j; else s=j;
+      }
+    } ;
+    typedef ArcIt<true>  OutArcIt;
+    typedef ArcIt<false> InArcIt;
+
+  private:
+    int  N,Lx,Ly;
+    bool periodic;
+
+    friend class SQLattice;
+  } ;
+
+  // Hierarchical graph (only the root, without arcs)
+  class Hgraph {
+  public:
+    typedef SQLattice::Node Node;
+    typedef SQLattice::Arc  Arc;
+
+    Node source(Arc a) const {return Node(a.s);}
+    Node target(Arc a) const {return Node(a.t);}
+    int  id(Node n) const {return n.i;}
+    Node nodeFromId(int i) const {return Node(i);}
+    int  nodeNum() const {return 1;}
+
+    template <typename T>
+    class NodeMap {
+    public:
+      NodeMap(const Hgraph&,const T& v=T()) : v(v) {}
+      T&       operator[](Node) {return v;}
+      const T& operator[](Node) const {return v;}
+    private:
+      T v;
+    } ;
+
+    class NodeIt : public Node {
+    public:
+      NodeIt(lemon::Invalid) : Node(lemon::INVALID) {}
+      NodeIt(const Hgraph& g) : Node(g.root) {}
+      NodeIt& operator++() {i=-1; return *this;}
+    } ;
+
+    class OutArcIt : public Arc {
+    public:
+      OutArcIt(lemon::Invalid) : Arc(lemon::INVALID) {}
+      OutArcIt(const Hgraph&,Node) : Arc(lemon::INVALID) {}
+      OutArcIt& operator++() {return *this;}
+    } ;
+
+  private:
+    int root;
+
+    friend class SQLattice;
+  } ;
+
+  typedef Igraph  igraph_t;
+  typedef Hgraph  hgraph_t;
+  typedef Node    hnode_t;
+  typedef Node    inode_t;
+  typedef Arc     iarc_t;
+  typedef Uniform_arc_weight arc_weight_policy;
+
+  igraph_t igraph;
+  hgraph_t hgraph;
+  double   arc_weight(iarc_t) {return default_arc_weight;}
+  double   uniform_arc_weight() const {return default_arc_weight;}
+  inode_t  random_inode() {return Node(ran(inode_count));}
+  int      id(inode_t n) {return n.i;}
+  inode_t  inode(int id) {return Node(id);}
+
+  template <typename Fun>
+  void     for_each_anode(inode_t,Fun fun) {fun(hroot);}
+
+  hnode_t  hroot;
+  int      inode_count;
+
+  static SQLattice* create(int Lx,int Ly,bool periodic=false);
+
+protected:
+  SQLattice(int Lx,int Ly,bool periodic,double default_arc_weight=1.);
+
+  double          default_arc_weight;
+  Uniform_integer ran;
+} ;
+
+// Directions are in the order of increasing neighbour number (for
+// inner nodes), as in the CSRGraph lattice
+inline int SQLattice::Igraph::neighbour(int i,int x,int y,int k) const
+{
+  switch(k) {
+  case 0:
+    return y>0 ? i-Lx : (periodic ? i+N-Lx : -1);
+  case 1:
+    return x>0 ? i-1 : (periodic ? i+Lx-1 : -1);
+  case 2:
+    return x<Lx-1 ? i+1 : (periodic ? i-Lx+1 : -1);
+  default:
+    return y<Ly-1 ? i+Lx : (periodic ? x : -1);
+  }
+}
+
+#endif /* SQLATTICE_HH */
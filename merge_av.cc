@@ -0,0 +1,90 @@
+/*
+ * merge_av.cc
+ *
+ * Combine averages saved by independent simulations (the optional
+ * avfile argument of sir_m, sir_f, seeiir_i? and seeiir_h) and print
+ * the resulting average and variance in the same format the
+ * simulation programs use.  Merging is exact (it gives the same
+ * result as a single run with all the samples), so an ensemble can be
+ * split among processes or machines and reduced afterwards.
+ *
+ * All files must have been written by the same kind of program (SIR
+ * or SEEIIR) with the same sampling interval.
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <stdexcept>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "popstate.hh"
+
+void show_usage(char *prog)
+{
+  std::cerr << "usage: " << prog << " avfile [avfile ...]\n\n"
+	    << "Merge and print averages saved by the simulation programs\n";
+  exit(1);
+}
+
+std::ifstream* open_avfile(char *fname)
+{
+  std::ifstream *f=new std::ifstream(fname,std::ios::binary);
+  if (!*f) {
+    std::cerr << "Error opening file (" << fname << ")\n";
+    throw std::runtime_error(strerror(errno));
+  }
+  return f;
+}
+
+template <typename State>
+void merge_and_print(int nfiles,char *fname[])
+{
+  State state;
+  for (int i=0; i<nfiles; ++i) {
+    std::ifstream *f=open_avfile(fname[i]);
+    state.merge(*f);
+    delete f;
+  }
+  std::cout << state.header() << '\n';
+  std::cout << state;
+}
+
+int main(int argc,char *argv[])
+{
+  if (argc<2) show_usage(argv[0]);
+
+  // The first line of the file tells which class wrote it
+  std::ifstream *f=open_avfile(argv[1]);
+  std::string kind;
+  std::getline(*f,kind);
+  delete f;
+
+  std::cout << "# Averages merged from " << argc-1 << " files\n";
+  if (kind=="SIRstate_av")
+    merge_and_print<SIRstate_av>(argc-1,argv+1);
+  else if (kind=="SEEIIRstate_av")
+    merge_and_print<SEEIIRstate_av>(argc-1,argv+1);
+  else {
+    std::cerr << argv[1] << ": not an averages file\n";
+    exit(1);
+  }
+}
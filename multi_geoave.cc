@@ -0,0 +1,177 @@
+/*
+ * multi_geoave.cc -- average several time series sharing the same
+ *                    (geometrically growing) time windows
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <iostream>
+#include <stdexcept>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+#include "multi_geoave.hh"
+
+Multi_geoave::Multi_geoave(int ncols,double t0_,double wfactor_,double base_) :
+  ncols_(ncols),
+  base(base_),
+  t0(t0_),
+  wfactor(wfactor_)
+{
+  logwf=log(wfactor);
+  read_fb=(wfactor-1)/base;
+  count.reserve(20);
+  rave.reserve(20*ncols);
+  rvarn.reserve(20*ncols);
+}
+
+// Window index for given time, -1 if time is before t0
+inline int Multi_geoave::window(double time) const
+{
+  if (time<t0) return -1;
+  if (time==t0) return 0;
+  if (wfactor==1) return floor( (time-t0)/base) + 1;
+
+  errno=0;
+  int n=floor( log(read_fb*(time-t0)+1)/logwf );
+  if (errno) {
+    std::cerr << "Time " << time << "(t0 = " <<t0<< ")\n";
+    throw std::runtime_error(strerror(errno));
+  }
+  return n+1;
+}
+
+void Multi_geoave::grow(int n)
+{
+  count.resize(n+10,0);
+  rave.resize((n+10)*ncols_,0);
+  rvarn.resize((n+10)*ncols_,0);
+}
+
+int Multi_geoave::push(double time,const double *e)
+{
+  int n=window(time);
+  if (n<0) return n;
+  if (n>=count.size()) grow(n);
+
+  double N=++count[n];
+  double Nm1=N-1;
+  double *a=rave.data()+n*ncols_;
+  double *v=rvarn.data()+n*ncols_;
+  for (int i=0; i<ncols_; ++i) {
+    double Q=e[i]-a[i];
+    double R=Q/N;
+    a[i]+=R;
+    v[i]+=Q*R*Nm1;
+  }
+  return n;
+}
+
+void Multi_geoave::get_aves(std::vector<double>& time,std::vector<double>& ave,
+			    std::vector<double>& var) const
+{
+  time.clear();
+  ave.clear();
+  var.clear();
+  if (count.empty()) return;
+
+  auto push_row=[&](int n,double t) {
+    time.push_back(t);
+    for (int i=0; i<ncols_; ++i) {
+      ave.push_back(rave[n*ncols_+i]);
+      var.push_back(rvarn[n*ncols_+i]/(count[n]-1));
+    }
+  } ;
+
+  if (count[0]>0) push_row(0,t0);
+
+  double t=t0+0.5*base;
+  double deltat=0.5*base*(1+wfactor);
+  for (int n=1; n<count.size(); n++, t+=deltat, deltat*=wfactor) {
+    if (count[n]==0) continue;
+    push_row(n,t);
+  }
+}
+
+// Combine with the data of another object (Chan, Golub and LeVeque
+// pairwise formula for the variance)
+void Multi_geoave::merge(const Multi_geoave& g)
+{
+  if (g.ncols_!=ncols_ || g.base!=base || g.t0!=t0 || g.wfactor!=wfactor)
+    throw std::runtime_error("Multi_geoave::merge: windows or number of columns do not match");
+  if (g.count.size()>count.size()) grow(g.count.size()-1);
+
+  for (int n=0; n<g.count.size(); ++n) {
+    if (g.count[n]==0) continue;
+    double NA=count[n];
+    double NB=g.count[n];
+    double N=NA+NB;
+    double *a=rave.data()+n*ncols_;
+    double *v=rvarn.data()+n*ncols_;
+    const double *ga=g.rave.data()+n*ncols_;
+    const double *gv=g.rvarn.data()+n*ncols_;
+    for (int i=0; i<ncols_; ++i) {
+      double delta=ga[i]-a[i];
+      a[i]+=delta*NB/N;
+      v[i]+=gv[i]+delta*delta*NA*NB/N;
+    }
+    count[n]+=g.count[n];
+  }
+}
+
+static const char multi_geoave_magic[]="Multi_geoave 1\n";
+
+void Multi_geoave::save(std::ostream& o) const
+{
+  unsigned long nw=count.size();
+  o.write(multi_geoave_magic,sizeof(multi_geoave_magic)-1);
+  o.write((const char*) &ncols_,sizeof(ncols_));
+  o.write((const char*) &t0,sizeof(t0));
+  o.write((const char*) &wfactor,sizeof(wfactor));
+  o.write((const char*) &base,sizeof(base));
+  o.write((const char*) &nw,sizeof(nw));
+  o.write((const char*) count.data(),nw*sizeof(unsigned long));
+  o.write((const char*) rave.data(),nw*ncols_*sizeof(double));
+  o.write((const char*) rvarn.data(),nw*ncols_*sizeof(double));
+  if (!o) throw std::runtime_error("Multi_geoave::save: write error");
+}
+
+void Multi_geoave::load(std::istream& is)
+{
+  char magic[sizeof(multi_geoave_magic)];
+  unsigned long nw;
+
+  is.read(magic,sizeof(multi_geoave_magic)-1);
+  if (!is || strncmp(magic,multi_geoave_magic,sizeof(multi_geoave_magic)-1)!=0)
+    throw std::runtime_error("Multi_geoave::load: not a Multi_geoave file");
+  is.read((char*) &ncols_,sizeof(ncols_));
+  is.read((char*) &t0,sizeof(t0));
+  is.read((char*) &wfactor,sizeof(wfactor));
+  is.read((char*) &base,sizeof(base));
+  is.read((char*) &nw,sizeof(nw));
+  if (!is) throw std::runtime_error("Multi_geoave::load: read error");
+  logwf=log(wfactor);
+  read_fb=(wfactor-1)/base;
+  count.resize(nw);
+  rave.resize(nw*ncols_);
+  rvarn.resize(nw*ncols_);
+  is.read((char*) count.data(),nw*sizeof(unsigned long));
+  is.read((char*) rave.data(),nw*ncols_*sizeof(double));
+  is.read((char*) rvarn.data(),nw*ncols_*sizeof(double));
+  if (!is) throw std::runtime_error("Multi_geoave::load: read error");
+}
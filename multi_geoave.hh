@@ -0,0 +1,85 @@
+/*
+ * multi_geoave.hh -- average several time series sharing the same
+ *                    (geometrically growing) time windows
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#ifndef MULTI_GEOAVE_HH
+#define MULTI_GEOAVE_HH
+
+#include <iostream>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Multi_geoave
+//
+// Same windowing and averaging as Geoave (see geoave.hh), but for
+// ncols quantities that are always sampled at the same time (e.g. all
+// the compartments of an epidemiological state).  push() takes a time
+// and a row of ncols values: the window index is computed only once,
+// and all columns are updated together with the West recurrence.  The
+// number of samples is shared by all the columns of a window, and
+// data are stored by rows (window n occupies ave[n*ncols
+// .. (n+1)*ncols-1]), so that the update is a simple loop over
+// contiguous memory which the compiler can vectorize.
+//
+// The fixed-window case (wfactor==1), which is what the *_av classes
+// use, avoids the logarithm (and the errno check) entirely.
+//
+// Results are the same as those obtained with ncols independent
+// Geoave objects.
+//
+// Partial results can be combined with merge() (the result is exactly
+// the same as if all points had been pushed into a single object, up
+// to rounding), and written to or read from a (binary) stream with
+// save() and load(), so that independent runs (e.g. different
+// processes) can be averaged together later without loss of
+// precision.
+
+class Multi_geoave {
+public:
+  Multi_geoave(int ncols,double t0=0,double wfactor=1.5,double base=1);
+
+  int  push(double time,const double *e);   // e must point to ncols values; returns the window index
+                                            // (-1 if time is before t0 and the point was ignored)
+  void merge(const Multi_geoave&);          // add the points of another object with the same windows
+  void save(std::ostream&) const;
+  void load(std::istream&);                 // replaces current contents
+  void get_aves(std::vector<double>& time,std::vector<double>& ave,
+		std::vector<double>& var) const; // Returns the abcissas and rows of averages and variances
+                                                 // (only for windows with data; vectors given are first cleared)
+  int    ncols() const {return ncols_;}
+  int    nwindows() const {return count.size();}
+  int    Nsamp(int n) const {return count[n];}
+  double ave(int n,int col) const {return rave[n*ncols_+col];}
+  double var(int n,int col) const {return rvarn[n*ncols_+col]/(count[n]-1);}
+
+private:
+  int    ncols_;
+  double base,t0,wfactor;
+  double logwf,read_fb;
+
+  std::vector<unsigned long> count;
+  std::vector<double>        rave,rvarn;
+
+  int  window(double time) const;
+  void grow(int n);
+} ;
+
+#endif /* MULTI_GEOAVE_HH */
@@ -0,0 +1,60 @@
+/*
+ * odeint.cc -- interface to GSL's integration of ODE systems
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <stdexcept>
+#include <string>
+
+#include <gsl/gsl_errno.h>
+
+#include "odeint.hh"
+
+ODE_integrator::ODE_integrator(int n,rhs_t f,double rtol,double atol) :
+  f(f),
+  nevals(0)
+{
+  sys.function=rhs;
+  sys.jacobian=0;               // not needed by explicit steppers
+  sys.dimension=n;
+  sys.params=this;
+  driver=gsl_odeiv2_driver_alloc_standard_new(&sys,gsl_odeiv2_step_rk8pd,1e-3,atol,rtol,1.,0.);
+  if (driver==0) throw std::runtime_error("ODE_integrator: could not allocate the GSL driver");
+}
+
+ODE_integrator::~ODE_integrator()
+{
+  gsl_odeiv2_driver_free(driver);
+}
+
+int ODE_integrator::rhs(double t,const double y[],double dydt[],void *self)
+{
+  ODE_integrator *oi=static_cast<ODE_integrator*>(self);
+  oi->f(t,y,dydt);
+  oi->nevals++;
+  return GSL_SUCCESS;
+}
+
+void ODE_integrator::integrate(double &t,double t1,double *y)
+{
+  if (t1<=t) return;
+  gsl_odeiv2_driver_reset(driver);        // y may have changed since the last call
+  int status=gsl_odeiv2_driver_apply(driver,&t,t1,y);
+  if (status!=GSL_SUCCESS)
+    throw std::runtime_error(std::string("ODE_integrator: ")+gsl_strerror(status));
+}
@@ -0,0 +1,57 @@
+/*
+ * odeint.hh -- interface to GSL's integration of ODE systems
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#ifndef ODEINT_HH
+#define ODEINT_HH
+
+#include <functional>
+
+#include <gsl/gsl_odeiv2.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ODE_integrator
+//
+// Integrates dy/dt=f(t,y) with GSL's odeiv2 driver (Runge-Kutta
+// Prince-Dormand 8(9), adaptive step with local error of each component
+// below atol+rtol*|y|).  integrate() stops exactly at the time
+// requested, so discontinuities (rate changes, imported infections)
+// are handled by integrating up to them, changing y or the parameters
+// of f, and going on.
+
+class ODE_integrator {
+public:
+  typedef std::function<void(double t,const double *y,double *dydt)> rhs_t;
+
+  ODE_integrator(int n,rhs_t f,double rtol=1e-8,double atol=1e-10);
+  ~ODE_integrator();
+  void integrate(double &t,double t1,double *y);   // advance y from t to t1
+  long evaluations() const {return nevals;}        // calls to f so far
+
+private:
+  rhs_t              f;
+  long               nevals;
+  gsl_odeiv2_system  sys;
+  gsl_odeiv2_driver  *driver;
+
+  static int rhs(double t,const double y[],double dydt[],void *self);
+} ;
+
+#endif /* ODEINT_HH */
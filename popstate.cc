@@ -21,15 +21,20 @@
 
 #include <iostream>
 #include <numeric>
+#include <stdexcept>
 #include <cstdio>
 
 #include "popstate.hh"
+#include "trajfile.hh"
+#include "async_writer.hh"
 
 ///////////////////////////////////////////////////////////////////////////////
 //
 // Population_state
 
 static void print_detail(std::ostream&,const std::vector<double>&);
+static void save_av(std::ostream&,const char *tag,const Multi_geoave&);
+static void merge_av(std::istream&,const char *tag,Multi_geoave&);
 
 const char *Population_state::header()
 {
@@ -109,6 +114,44 @@ void Population_state::print(std::ostream& o,bool print_time)
   print_detail(o,R);
 }
 
+int Population_state::fill_row(double *row)
+{
+  int n=0;
+  row[n++]=time;
+  row[n++]=std::accumulate(S.begin(),S.end(),0.);
+  if (E.size()>0) row[n++]=std::accumulate(E.begin(),E.end(),0.);
+  row[n++]=std::accumulate(I.begin(),I.end(),0.);
+  row[n++]=std::accumulate(R.begin(),R.end(),0.);
+  for (auto v : {&S,&E,&I,&R})
+    if (v->size()>1)
+      for (double x : *v) row[n++]=x;
+  return n;
+}
+
+std::string Population_state::column_formats()
+{
+  int n=1+(E.size()>0 ? 4 : 3);
+  for (auto v : {&S,&E,&I,&R})
+    if (v->size()>1) n+=v->size();
+  return std::string(n,'g');
+}
+
+void Population_state::set_trajectory(Trajectory_writer *t)
+{
+  traj=t;
+  traj->begin(header(),column_formats());
+}
+
+void Population_state::set_async_output()
+{
+  async=new Text_rows(std::cout,column_formats(),row_end());
+}
+
+Population_state::~Population_state()
+{
+  delete async;           // waits until all rows are written
+}
+
 static void print_detail(std::ostream& o,const std::vector<double>& v)
 {
   if (v.size()<=1) return;
@@ -121,6 +164,28 @@ static void print_detail(std::ostream& o,const std::vector<double>& v)
   }
 }
 
+//
+// Saving and merging of averages: the Multi_geoave data is preceded by
+// a line with the name of the class, so that files written by
+// different classes are not mixed up
+
+static void save_av(std::ostream& o,const char *tag,const Multi_geoave& av)
+{
+  o << tag << '\n';
+  av.save(o);
+}
+
+static void merge_av(std::istream& is,const char *tag,Multi_geoave& av)
+{
+  std::string rtag;
+  std::getline(is,rtag);
+  if (rtag!=tag)
+    throw std::runtime_error(std::string("expected averages written by ")+tag+", found "+rtag);
+  Multi_geoave pav(av.ncols());
+  pav.load(is);
+  av.merge(pav);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // SIRstate
@@ -132,7 +197,13 @@ void SIRstate::push(double time_,SIRistate &s)
   I[0]=s.I;
   R[0]=s.R;
 
-  std::cout << *this << '\n';
+  if (traj || async) {
+    double row[4];
+    fill_row(row);
+    if (traj) traj->push(row);
+    else async->push(row);
+  } else
+    std::cout << *this << '\n';
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -153,27 +224,46 @@ const char *SIRstate_av::header()
 
 void SIRstate_av::push(double time,SIRistate &s)
 {
-  Sav.push(time,s.S);
-  Iav.push(time,s.I);
-  Rav.push(time,s.R);
+  double row[ncols];
+  row[cS]=s.S;
+  row[cI]=s.I;
+  row[cR]=s.R;
+  av.push(time,row);
+  if (archive) archive->push(time,row);
+}
+
+void SIRstate_av::set_archive(Run_archive *a)
+{
+  archive=a;
+  archive->begin("S I R");
+}
+
+void SIRstate_av::save(std::ostream& o)
+{
+  save_av(o,"SIRstate_av",av);
+}
+
+void SIRstate_av::merge(std::istream& is)
+{
+  merge_av(is,"SIRstate_av",av);
 }
 
 void SIRstate_av::print(std::ostream& o,bool print_time)
 {
-  std::vector<double> tim,Sa,Sv,Ia,Iv,Ra,Rv;
-  Sav.get_aves(tim,Sa,Sv);
-  Iav.get_aves(tim,Ia,Iv);
-  Rav.get_aves(tim,Ra,Rv);
+  std::vector<double> tim,ave,var;
+  av.get_aves(tim,ave,var);
 
-  for (int i=0; i<Sv.size(); ++i) {
+  for (int i=0; i<tim.size(); ++i) {
+    const double *a=&ave[i*ncols];
+    const double *v=&var[i*ncols];
     time=tim[i];
-    S[0]=Sa[i];
-    I[0]=Ia[i];
-    R[0]=Ra[i];
+    S[0]=a[cS];
+    I[0]=a[cI];
+    R[0]=a[cR];
     Population_state::print(o,print_time);
-    S[0]=Sv[i];
-    I[0]=Iv[i];
-    R[0]=Rv[i];
+    S[0]=v[cS];
+    I[0]=v[cI];
+    R[0]=v[cR];
     Population_state::print(o,false);
     o << '\n';
   }
@@ -203,19 +293,38 @@ void SEEIIRstate::push(double time_,SEEIIRistate &s)
   I[0]=s.I1;
   I[1]=s.I2;
   R[0]=s.R;
-  Population_state::print(std::cout,true);
 
   double RR = s.tinf * (s.Eacc-Eacc0)/( (time-time0) * I0 );
   time0=time;
   Eacc0=s.Eacc;
   I0=s.I1+s.I2;
 
+  if (traj || async) {
+    double row[15];
+    int n=fill_row(row);
+    row[n++]=s.inf_imported;
+    row[n++]=s.inf_close;
+    row[n++]=s.inf_community;
+    row[n++]=s.N;
+    row[n++]=s.beta_out;
+    row[n++]=RR;
+    if (traj) traj->push(row);
+    else async->push(row);
+    return;
+  }
+
+  Population_state::print(std::cout,true);
   char buf[200];
   sprintf(buf,"%11d %11d %11d %11d %11.6g %11.6g",s.inf_imported,s.inf_close,s.inf_community,
 	  s.N,s.beta_out,RR);
   std::cout << buf << '\n';
 }
 
+std::string SEEIIRstate::column_formats()
+{
+  return Population_state::column_formats()+"ddddgg";
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // SEEIIRstate_av
@@ -223,75 +332,102 @@ void SEEIIRstate::push(double time_,SEEIIRistate &s)
 const char *SEEIIRstate_av::header()
 {
   hdr.clear();
-  create_colnums(29);
+  create_colnums(29+nqcols*Window_quantiles::nprobs);
   hdr=colnums;
-  hdr+="#           |------------------------------------------------------------------------------ Average ------------------------------------------------------------------------------| |----------------------------------------------------------------------------- Variance ------------------------------------------------------------------------------|\n";
+  hdr+="#           |------------------------------------------------------------------------------ Average ------------------------------------------------------------------------------| |----------------------------------------------------------------------------- Variance ------------------------------------------------------------------------------| |----------------------------------------------------------------------------------------------------------------- Quantiles -----------------------------------------------------------------------------------------------------------------|\n";
   hdr+="#      time ";
   addSIRhdr();
   hdr+="   Imported  CloseCntct   Community           N    beta_out R(Rep.Rate)";
   addSIRhdr();
   hdr+="    Imported  CloseCntct   Community           N    beta_out R(Rep.Rate)";
+  static const char* const qnames[nqcols]={"S","E","I","R"};
+  quant.add_header(hdr,qnames);
   return hdr.c_str();
 }  
 
 void SEEIIRstate_av::push(double time,SEEIIRistate &s)
 {
-  Nav.push(time,s.N);
-  Sav.push(time,s.S);
-  E1av.push(time,s.E1);
-  E2av.push(time,s.E2);
-  I1av.push(time,s.I1);
-  I2av.push(time,s.I2);
-  Rav.push(time,s.R);
-  Impav.push(time,s.inf_imported);
-  Closeav.push(time,s.inf_close);
-  Commav.push(time,s.inf_community);
-  betaav.push(time,s.beta_out);
-  double RR = s.tinf * (s.Eacc-Eacc0)/( (time-time0) * I0 );
+  double row[ncols];
+  row[cN]=s.N;
+  row[cS]=s.S;
+  row[cE1]=s.E1;
+  row[cE2]=s.E2;
+  row[cI1]=s.I1;
+  row[cI2]=s.I2;
+  row[cR]=s.R;
+  row[cImp]=s.inf_imported;
+  row[cClose]=s.inf_close;
+  row[cComm]=s.inf_community;
+  row[cbeta]=s.beta_out;
+  row[cRR] = s.tinf * (s.Eacc-Eacc0)/( (time-time0) * I0 );
   time0=time;
   Eacc0=s.Eacc;
   I0=s.I1+s.I2;
-  RRav.push(time,RR);
+  int n=av.push(time,row);
+
+  double qrow[nqcols];
+  qrow[qS]=s.S;
+  qrow[qE]=s.E1+s.E2;
+  qrow[qI]=s.I1+s.I2;
+  qrow[qR]=s.R;
+  quant.push(n,qrow);
+  if (archive) archive->push(time,row);    // the first columns (up to cComm) are the counts
+}
+
+void SEEIIRstate_av::set_archive(Run_archive *a)
+{
+  archive=a;
+  archive->begin("N S E1 E2 I1 I2 R Imported CloseCntct Community");
+}
+
+void SEEIIRstate_av::save(std::ostream& o)
+{
+  save_av(o,"SEEIIRstate_av",av);
+  quant.save(o);
+}
+
+void SEEIIRstate_av::merge(std::istream& is)
+{
+  merge_av(is,"SEEIIRstate_av",av);
+  Window_quantiles pquant(nqcols);
+  pquant.load(is);
+  quant.merge(pquant);
 }
 
 void SEEIIRstate_av::print(std::ostream& o,bool print_time)
 {
-  std::vector<double> tim,Sa,Sv,E1a,E1v,E2a,E2v,I1a,I1v,I2a,I2v,Ra,Rv,
-    impa,impv,closea,closev,comma,commv,betaa,betav,Na,Nv,RRa,RRv;
-  Nav.get_aves(tim,Na,Nv);
-  Sav.get_aves(tim,Sa,Sv);
-  E1av.get_aves(tim,E1a,E1v);
-  E2av.get_aves(tim,E2a,E2v);
-  I1av.get_aves(tim,I1a,I1v);
-  I2av.get_aves(tim,I2a,I2v);
-  Rav.get_aves(tim,Ra,Rv);
-  Impav.get_aves(tim,impa,impv);
-  Closeav.get_aves(tim,closea,closev);
-  Commav.get_aves(tim,comma,commv);
-  betaav.get_aves(tim,betaa,betav);
-  RRav.get_aves(tim,RRa,RRv);
+  std::vector<double> tim,ave,var;
+  av.get_aves(tim,ave,var);
 
   char buf[200];
-  for (int i=0; i<Sv.size(); ++i) {
+  int  n=-1;
+  for (int i=0; i<tim.size(); ++i) {
+    const double *a=&ave[i*ncols];
+    const double *v=&var[i*ncols];
     time=tim[i];
-    S[0]=Sa[i];
-    E[0]=E1a[i];
-    E[1]=E2a[i];
-    I[0]=I1a[i];
-    I[1]=I2a[i];
-    R[0]=Ra[i];
+    S[0]=a[cS];
+    E[0]=a[cE1];
+    E[1]=a[cE2];
+    I[0]=a[cI1];
+    I[1]=a[cI2];
+    R[0]=a[cR];
     Population_state::print(o,print_time);
-    sprintf(buf,"%11.6g %11.6g %11.6g %11.6g %11.6g %11.6g",impa[i],closea[i],comma[i],Na[i],betaa[i],RRa[i]);
-    std::cout << buf;
-
-    S[0]=Sv[i];
-    E[0]=E1v[i];
-    E[1]=E2v[i];
-    I[0]=I1v[i];
-    I[1]=I2v[i];
-    R[0]=Rv[i];
+    sprintf(buf,"%11.6g %11.6g %11.6g %11.6g %11.6g %11.6g",a[cImp],a[cClose],a[cComm],a[cN],a[cbeta],a[cRR]);
+    o << buf;
+
+    S[0]=v[cS];
+    E[0]=v[cE1];
+    E[1]=v[cE2];
+    I[0]=v[cI1];
+    I[1]=v[cI2];
+    R[0]=v[cR];
     Population_state::print(o,false);
-    sprintf(buf," %11.6g %11.6g %11.6g %11.6g %11.6g %11.6g",impv[i],closev[i],commv[i],Nv[i],betav[i],RRv[i]);
-    std::cout << buf << '\n';
+    sprintf(buf," %11.6g %11.6g %11.6g %11.6g %11.6g %11.6g",v[cImp],v[cClose],v[cComm],v[cN],v[cbeta],v[cRR]);
+    o << buf;
+
+    // rows returned by get_aves() are the windows with data, in order
+    for (++n; av.Nsamp(n)==0; ++n) ;
+    quant.print(o,n);
+    o << '\n';
   }
 }
@@ -25,7 +25,12 @@
 #include <ostream>
 #include <vector>
 
-#include "geoave.hh"
+#include "multi_geoave.hh"
+#include "tdigest.hh"
+
+class Trajectory_writer;
+class Run_archive;
+class Text_rows;
 
 //
 // Print source context (for debugging)
@@ -40,10 +45,14 @@
 class Population_state {
 public:
   Population_state(int NS=1,int NE=1,int NI=1,int NR=1);
-  virtual ~Population_state() {}
+  virtual ~Population_state();
 
   virtual const char *header();
   virtual void print(std::ostream&,bool print_time=true);
+  void set_trajectory(Trajectory_writer*);   // push() writes rows there (binary) instead of
+                                             // printing them (see trajfile.hh)
+  void set_async_output();                   // push() leaves formatting and writing of rows
+                                             // to a separate thread (see async_writer.hh)
 
   double time;
   std::vector<double> S,E,I,R;
@@ -51,12 +60,19 @@ public:
 protected:
   void create_colnums(int);
   void addSIRhdr();
+  int  fill_row(double *row);                // the values print() writes, returns how many
+  virtual std::string column_formats();      // 'g' (real) or 'd' (integer) for each column
+  virtual const char *row_end() {return " \n";}   // what print() leaves at the end of a row
   std::string hdr;
   std::string colnums;
+  Trajectory_writer *traj;
+  Text_rows         *async;
 } ;
 	       
 inline Population_state::Population_state(int NS,int NE,int NI,int NR) :
-  S(NS,0.), E(NE,0.), I(NI,0.), R(NR,0.)
+  S(NS,0.), E(NE,0.), I(NI,0.), R(NR,0.),
+  traj(0),
+  async(0)
 {}
 
 inline std::ostream& operator<<(std::ostream& o,Population_state& state)
@@ -88,18 +104,21 @@ class SIRstate_av : public SIRstate {
 public:
   SIRstate_av(double deltat=1.) :
     SIRstate(),
-    Sav(-0.5*deltat,1.,deltat),
-    Iav(-0.5*deltat,1.,deltat),
-    Rav(-0.5*deltat,1.,deltat)
+    av(ncols,-0.5*deltat,1.,deltat),
+    archive(0)
   {}
 
   const char* header();
   void print(std::ostream&,bool print_time=true);
   void push(double time,SIRistate &istate);
+  void save(std::ostream&);    // write accumulated averages (binary)
+  void merge(std::istream&);   // read averages written by save() and add them to ours
+  void set_archive(Run_archive*);   // also store every sample there (see trajfile.hh)
 
 private:
-  Geoave Sav,Iav,Rav;
-
+  enum {cS,cI,cR,ncols};
+  Multi_geoave av;
+  Run_archive  *archive;
 } ;
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -131,6 +150,10 @@ public:
   const char* header();
   virtual void push(double time,SEEIIRistate &s);
 
+protected:
+  std::string column_formats();
+  const char *row_end() {return "\n";}
+
 private:
   double time0;
   int    Eacc0,I0;
@@ -145,27 +168,25 @@ class SEEIIRstate_av : public SEEIIRstate {
 public:
   SEEIIRstate_av(double deltat=1.) :
     SEEIIRstate(),
-    Sav(-0.5*deltat,1.,deltat),
-    E1av(-0.5*deltat,1.,deltat),
-    E2av(-0.5*deltat,1.,deltat),
-    I1av(-0.5*deltat,1.,deltat),
-    I2av(-0.5*deltat,1.,deltat),
-    Rav(-0.5*deltat,1.,deltat),
-    Impav(-0.5*deltat,1.,deltat),
-    Closeav(-0.5*deltat,1.,deltat),
-    Commav(-0.5*deltat,1.,deltat),
-    Nav(-0.5*deltat,1.,deltat),
-    betaav(-0.5*deltat,1.,deltat),
-    RRav(-0.5*deltat,1.,deltat),
+    av(ncols,-0.5*deltat,1.,deltat),
+    quant(nqcols),
+    archive(0),
     time0(0), Eacc0(0), I0(0)
   {}
 
   const char* header();
-  void print(std::ostream&,bool print_time=true);
+  void print(std::ostream&,bool print_time=true);   // also prints quantiles of S, E, I and R
   void push(double time,SEEIIRistate &s);
+  void save(std::ostream&);    // write accumulated averages (binary)
+  void merge(std::istream&);   // read averages written by save() and add them to ours
+  void set_archive(Run_archive*);   // also store every sample there (counts only, see trajfile.hh)
 
 private:
-  Geoave Sav,E1av,E2av,I1av,I2av,Rav,Impav,Closeav,Commav,Nav,betaav,RRav;
+  enum {cN,cS,cE1,cE2,cI1,cI2,cR,cImp,cClose,cComm,cbeta,cRR,ncols};
+  enum {qS,qE,qI,qR,nqcols};
+  Multi_geoave     av;
+  Window_quantiles quant;
+  Run_archive      *archive;
 private:
   double time0;
   int    Eacc0,I0;
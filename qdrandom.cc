@@ -42,5 +42,5 @@ void Random_number_generator::load(std::istream& is)
  * Static data
  */
 
-gsl_rng* Random_number_generator::generator=0;
-Random_number_generator* Random_number_generator::glsim_generator=0;
+thread_local gsl_rng* Random_number_generator::generator=0;
+thread_local Random_number_generator* Random_number_generator::glsim_generator=0;
@@ -34,8 +34,11 @@ public:
   unsigned long range() const;
 
 private:
-  static gsl_rng *generator;
-  static Random_number_generator *glsim_generator;
+  // one generator per thread: threads that need random numbers create
+  // their own Random_number_generator, and the distributions they
+  // construct use it
+  static thread_local gsl_rng *generator;
+  static thread_local Random_number_generator *glsim_generator;
   
   template<typename T> friend class Random_distribution_base;
 
@@ -201,6 +204,62 @@ inline double Exponential_distribution::operator()(double mu_)
   return gsl_ran_exponential(generator,mu_);
 }
 
+/*****************************************************************************
+ *
+ * Gaussian distribution of mean mu and standard deviation sigma
+ *
+ */
+
+class Gaussian_distribution : public rdbase_double {
+public:
+  Gaussian_distribution(double mu_=0,double sigma_=1) :
+    mu(mu_), sigma(sigma_) {}
+  double operator()();
+  double operator()(double mu,double sigma);
+
+private:
+  double mu,sigma;
+} ;
+
+inline double Gaussian_distribution::operator()()
+{
+  return mu+gsl_ran_gaussian(generator,sigma);
+}
+
+inline double Gaussian_distribution::operator()(double mu_,double sigma_)
+{
+  return mu_+gsl_ran_gaussian(generator,sigma_);
+}
+
+/*****************************************************************************
+ *
+ * Binomial distribution (number of successes in n trials of
+ * probability p)
+ *
+ */
+
+class Binomial_distribution : public rdbase_ulong {
+public:
+  Binomial_distribution(unsigned long n_=1,double p_=0.5) :
+    n(n_), p(p_) {}
+  unsigned long operator()();
+  unsigned long operator()(unsigned long n,double p);
+
+private:
+  unsigned long n;
+  double        p;
+} ;
+
+inline unsigned long Binomial_distribution::operator()()
+{
+  return gsl_ran_binomial(generator,p,n);
+}
+
+inline unsigned long Binomial_distribution::operator()(unsigned long n_,double p_)
+{
+  return gsl_ran_binomial(generator,p_,n_);
+}
+
 /*****************************************************************************
  *
  * Vectors on the unit sphere
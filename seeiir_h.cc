@@ -33,13 +33,19 @@
 #define NDEBUG
 
 #include <iostream>
+#include <fstream>
 #include <cstdio>
 #include <list>
 #include <queue>
 #include <cmath>
 #include <limits>
 #include <algorithm>
+#include <memory>
 #include <type_traits>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include <assert.h>
 #include <stdlib.h>
@@ -52,6 +58,8 @@
 #include "bsearch.hh"
 #include "gillespie_sampler.hh"
 #include "avevar.hh"
+#include "async_writer.hh"
+#include "trajfile.hh"
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -113,8 +121,22 @@ struct opt {
   char *dfile;        // detailed level info file
   int  detail_level;  // print detail info down to level, negative means don't print
   detail_info_type dinfo_type;
-
-  opt() : last_arg_read(0), detail_level(-1) {}
+  char *avfile;       // file to save averages for later merging (optional)
+  char *trajfile;     // binary trajectory or run archive (optional)
+#ifdef PARAMETER_SWEEP
+  char *sweepfile;    // parameter sets (see run_sweep())
+#endif
+#ifdef ABC_SMC
+  char *priorfile;    // rates with the prior ranges of the fitted ones (see read_prior())
+  char *datafile;     // observed cases (see read_observed())
+  int  Nparticles;
+  int  Ngenerations;
+#endif
+#if defined(PARAMETER_SWEEP) || defined(ABC_SMC)
+  int  Nthreads;
+#endif
+
+  opt() : last_arg_read(0), detail_level(-1), avfile(0), trajfile(0) {}
 
 } options;
 
@@ -125,17 +147,55 @@ struct opt {
  */
 #include "read_arg.hh"
 
+#ifdef PARAMETER_SWEEP
+
+static int nargs=5;
+
+void show_usage(char *prog)
+{
+  std::cerr << "usage: " << prog << " parameterfile sweepfile seed steps Nruns [Nthreads]\n\n"
+	    << "Does Nruns runs for each parameter set in sweepfile, whose lines give rate\n"
+	    << "constants vs time as in the parameter file (which replace those of the\n"
+	    << "parameter file).  A value can be given as a range a:b:n (n values from a to b),\n"
+	    << "the line then stands for all the combinations of the values of its ranges.\n"
+	    << "Nthreads defaults to the number of cores\n";
+  exit(1);
+}
+
+#elif defined(ABC_SMC)
+
+static int nargs=6;
+
+void show_usage(char *prog)
+{
+  std::cerr << "usage: " << prog << " parameterfile priorfile datafile seed Nparticles Ngenerations [Nthreads]\n\n"
+	    << "Fits rate constants to the observed cases in datafile by ABC-SMC.  priorfile\n"
+	    << "gives the rate constants vs time as in the parameter file (which replace those\n"
+	    << "of the parameter file), a value a:b is fitted with uniform prior in [a,b].\n"
+	    << "Nthreads defaults to the number of cores\n";
+  exit(1);
+}
+
+#else
+
 static int nargs=7;
 
 void show_usage(char *prog)
 {
-  std::cerr << "usage: " << prog << " parameterfile seed steps Nruns\n\n"
-	    << "    or " << prog << " parameterfile seed steps Nruns detail_level detail_field detail_file\n\n"
-	    << "detail_fileld must be I, R or S\n\n";
+  std::cerr << "usage: " << prog << " parameterfile seed steps Nruns [avfile [trajfile]]\n\n"
+	    << "    or " << prog << " parameterfile seed steps Nruns detail_level detail_field detail_file [avfile [trajfile]]\n\n"
+	    << "detail_fileld must be I, R or S\n\n"
+	    << "If avfile is given, the averages are also saved there (in binary form) so that\n"
+	    << "they can later be combined with those of other runs using merge_av\n"
+	    << "If trajfile is given, for a single run (Nruns=1, use - as avfile) the trajectory\n"
+	    << "is written there in binary form instead of to standard output, otherwise the\n"
+	    << "counts of every run are archived there (convert it to text with traj2txt)\n";
     ;
   exit(1);
 }
 
+#endif
+
 char *readbuf(FILE *f)
 {
   static char buf[5000];
@@ -148,15 +208,60 @@ char *readbuf(FILE *f)
 
 void read_imported_infections();
 void read_rates_vs_time(FILE*);
+void read_parameter_file();
+
+#ifdef PARAMETER_SWEEP
+
+void read_sweep();
 
 void read_parameters(int argc,char *argv[])
 {
-  if (argc!=nargs+1 && argc!=nargs-2) show_usage(argv[0]);
+  if (argc!=nargs+1 && argc!=nargs+2) show_usage(argv[0]);
   read_arg(argv,options.ifile);
+  read_arg(argv,options.sweepfile);
   read_arg(argv,options.seed);
   read_arg(argv,options.steps);
   read_arg(argv,options.Nruns);
-  if (argc==nargs+1) {
+  options.Nthreads=std::max(1U,std::thread::hardware_concurrency());
+  if (argc==nargs+2) read_arg(argv,options.Nthreads);
+  read_parameter_file();
+  read_sweep();
+}
+
+#elif defined(ABC_SMC)
+
+void read_prior();
+void read_observed();
+
+void read_parameters(int argc,char *argv[])
+{
+  if (argc!=nargs+1 && argc!=nargs+2) show_usage(argv[0]);
+  read_arg(argv,options.ifile);
+  read_arg(argv,options.priorfile);
+  read_arg(argv,options.datafile);
+  read_arg(argv,options.seed);
+  read_arg(argv,options.Nparticles);
+  read_arg(argv,options.Ngenerations);
+  options.Nthreads=std::max(1U,std::thread::hardware_concurrency());
+  if (argc==nargs+2) read_arg(argv,options.Nthreads);
+  options.Nruns=1;
+  read_parameter_file();
+  read_prior();
+  read_observed();
+}
+
+#else
+
+void read_parameters(int argc,char *argv[])
+{
+  if (argc<nargs-2 || argc>nargs+3) show_usage(argv[0]);
+  bool with_detail = argc>=nargs+1;
+  int  nopt = with_detail ? argc-nargs-1 : argc-nargs+2;    // avfile and trajfile
+  read_arg(argv,options.ifile);
+  read_arg(argv,options.seed);
+  read_arg(argv,options.steps);
+  read_arg(argv,options.Nruns);
+  if (with_detail) {
     char* dtypes;
     read_arg(argv,options.detail_level);
     read_arg(argv,dtypes);
@@ -175,7 +280,18 @@ void read_parameters(int argc,char *argv[])
     }
     read_arg(argv,options.dfile);
   }
+  if (nopt>=1) {
+    read_arg(argv,options.avfile);
+    if (strcmp(options.avfile,"-")==0) options.avfile=0;
+  }
+  if (nopt==2) read_arg(argv,options.trajfile);
+  read_parameter_file();
+}
 
+#endif
+
+void read_parameter_file()
+{
   FILE *f=fopen(options.ifile,"r");
   if (f==0) throw std::runtime_error(strerror(errno));
 
@@ -290,6 +406,29 @@ void read_rates_vs_time(FILE *f)
   }
 }
 
+/*
+ * Rates vs time from a list of values, in the order of the rate table
+ * of the parameter file (time beta_1 ... beta_Nlevels sigma_1 sigma_2
+ * gamma_1 gamma_2, repeated for each record)
+ *
+ */
+opt::rates_vs_time_t rates_from_values(const std::vector<double> &v)
+{
+  const int nrec=options.levels+5;
+  opt::rates_vs_time_t rates_vs_time;
+  for (int r=0; r+nrec<=(int) v.size(); r+=nrec) {
+    rates_t rates(options.levels);
+    rates.time=v[r];
+    for (int l=1; l<=options.levels; ++l) rates.beta[l]=v[r+l];
+    rates.sigma1=v[r+options.levels+1];
+    rates.sigma2=v[r+options.levels+2];
+    rates.gamma1=v[r+options.levels+3];
+    rates.gamma2=v[r+options.levels+4];
+    rates_vs_time.push_back(rates);
+  }
+  return rates_vs_time;
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -309,14 +448,14 @@ event_queue_t             event_queue;
  * closes with dummy event at infinite time
  *
  */
-void merge_events()
+void merge_events(const opt::rates_vs_time_t &rates_vs_time,event_queue_t &event_queue)
 {
   while (!event_queue.empty()) event_queue.pop();
   
   auto ii_begin=options.imported_infections.begin();
   auto ii_end=options.imported_infections.end();
-  auto ir_begin=options.rates_vs_time.begin();
-  auto ir_end=options.rates_vs_time.end();
+  auto ir_begin=rates_vs_time.begin();
+  auto ir_end=rates_vs_time.end();
   
   auto ii=ii_begin;
   auto ir=ir_begin;
@@ -401,7 +540,7 @@ public:
   SEIRPopulation(int levels,int (*noffspring)(int));
   void rebuild_hierarchy();
   void set_all_S();
-  void set_rate_parameters(rates_t& r) {rates=r;}
+  void set_rate_parameters(const rates_t& r) {rates=r;}
   void force_infection_recover(int I,int R);
   void add_imported(int I);
   void force_recover(int R);
@@ -513,11 +652,13 @@ void SEIRPopulation::set_all_S()
     noded.E1=noded.E2=noded.I1=noded.I2=noded.R=0;
   }
   recompute_counts();
+  listR.clear();        // runs may end before the forced recoveries are undone
   gdata.infections_imported=0;
   gdata.forcibly_recovered=0;
   gdata.infections_level.resize(levels+1,0);
   gdata.Eacc=0;
   std::fill(gdata.infections_level.begin(),gdata.infections_level.end(),0.);
+  rates=rates_t(levels);  // as new: the rates of a previous run must not drive the first step
 }
 
 // This recomputes all cumulative counts and rebuilds lists
@@ -968,6 +1109,75 @@ void SEIRPopulation::unrecover(int S)  // Make S of the forcibly recovered susce
 #endif /* FORCE_RECOVER_WHOLE_FAMILIES */
 
 
+///////////////////////////////////////////////////////////////////////////////
+//
+// Detail_writer: formats and writes the by-level details (in a
+// separate thread, see async_writer.hh).  Records are the time
+// followed by the detail value of every node, from level levels
+// (the root) down to level 1; nnodes[l] gives the number of nodes at
+// level l.
+
+class Detail_writer : public Async_writer {
+public:
+  Detail_writer(FILE *f,const std::vector<int>& nnodes,int dlevel);
+  ~Detail_writer() {finish();}
+
+  static size_t record_size(const std::vector<int>& nnodes);
+
+protected:
+  void write(const char *record);
+
+private:
+  FILE             *f;
+  int              levels,dlevel;
+  std::vector<int> nnodes,offset;  // offset[l]: first value of level l in record
+} ;
+
+size_t Detail_writer::record_size(const std::vector<int>& nnodes)
+{
+  size_t n=0;
+  for (int nn: nnodes) n+=nn;
+  size_t size=sizeof(double)+n*sizeof(int);
+  return (size+7)/8*8;              // keep records aligned
+}
+
+Detail_writer::Detail_writer(FILE *f,const std::vector<int>& nnodes,int dlevel) :
+  Async_writer(record_size(nnodes)),
+  f(f),
+  levels(nnodes.size()-1),
+  dlevel(dlevel),
+  nnodes(nnodes),
+  offset(nnodes.size())
+{
+  int o=0;
+  for (int l=levels; l>0; --l) {
+    offset[l]=o;
+    o+=nnodes[l];
+  }
+}
+
+void Detail_writer::write(const char *record)
+{
+  double    time=*(const double*) record;
+  const int *value=(const int*) (record+sizeof(double));
+
+  fprintf(f,"%11.6g ",time);
+
+  AveVar<false> av;
+  for (int l=levels-1; l>0; --l) {
+    av.clear();
+    for (int n=0; n<nnodes[l]; ++n)
+      av.push(value[offset[l]+n]);
+    fprintf(f,"%11.6g %11.6g ",av.ave(),av.var());
+  }
+
+  for (int l=levels; l>=dlevel; --l)
+    for (int n=0; n<nnodes[l]; ++n)
+      fprintf(f,"%11d ",value[offset[l]+n]);
+
+  fprintf(f,"\n");
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // commputing and printing aggregate data at the different hierarchical levels
@@ -987,11 +1197,13 @@ private:
   detail_info_type dinfo_type;
   char *file;
   FILE *f;
+  Detail_writer *detail;
 } ;
 
 SEEIIR_observer::SEEIIR_observer(SEEIIRstate *state,SEIRPopulation& pop,
 				 int dlevel,detail_info_type dinfo_type, char *dfile) :
-  state(state), dlevel(dlevel), dinfo_type(dinfo_type), file(dfile)
+  state(state), dlevel(dlevel), dinfo_type(dinfo_type), file(dfile),
+  detail(0)
 {
   if (dlevel<0) return;
   f=fopen(file,"w");
@@ -1031,11 +1243,17 @@ SEEIIR_observer::SEEIIR_observer(SEEIIRstate *state,SEIRPopulation& pop,
       fprintf(f,"   Node %3d ",n);
 
   fprintf(f,"\n");
+
+  std::vector<int> nnodes(pop.levels+1,0);
+  for (int l=1; l<=pop.levels; ++l)
+    nnodes[l]=pop.level_nodes[l].size();
+  detail=new Detail_writer(f,nnodes,dlevel);
 }
 
 SEEIIR_observer::~SEEIIR_observer()
 {
-  if (dlevel>0) fclose(f);
+  delete detail;               // waits until everything is written
+  if (dlevel>=0) fclose(f);
 }
 
 void SEEIIR_observer::push(double time,SEIRPopulation& pop)
@@ -1061,68 +1279,74 @@ void SEEIIR_observer::push(double time,SEIRPopulation& pop)
 
   if (dlevel<0) return;
 
-  fprintf(f,"%11.6g ",time);
-  
-  AveVar<false> av;
-  for (int l=pop.levels-1; l>0; --l) {
-    av.clear();
-    for (node_t node: pop.level_nodes[l]) {
-      node_data &noded=pop.treemap[node];
-      int detail_data; 
-      switch (dinfo_type) {
-      case S: detail_data=noded.S; break;
-      case I: detail_data=noded.I1+noded.I2; break;
-      case R: detail_data=noded.R; break;
-      }
-      av.push(detail_data);
-    }
-    fprintf(f,"%11.6g %11.6g ",av.ave(),av.var());
-  }
-
-  for (int l=pop.levels; l>=dlevel; --l) {
+  // Only copy the data here, Detail_writer formats and writes them
+  char *record=detail->reserve();
+  *(double*) record=time;
+  int *value=(int*) (record+sizeof(double));
+  for (int l=pop.levels; l>0; --l) {
     for (node_t node: pop.level_nodes[l]) {
       node_data &noded=pop.treemap[node];
       switch (dinfo_type) {
-      case S:
-	fprintf(f,"%11d ",noded.S);
-	break;
-      case I:
-	fprintf(f,"%11d ",noded.I1+noded.I2);
-	break;
-      case R: 
-	fprintf(f,"%11d ",noded.R);
-	break;
+      case S: *value++=noded.S; break;
+      case I: *value++=noded.I1+noded.I2; break;
+      case R: *value++=noded.R; break;
       }
     }
   }
-
-  fprintf(f,"\n");
+  detail->commit();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 //
 // simulation driver: uses a given SEIRpopulation object to drive the
 // dynamics (Gillespie).  Output through a SEEIIRstate object
-
-void run(SEIRPopulation &pop,SEEIIRstate *state)
+//
+// When there are no infected (nor exposed) and no more infections are
+// to be imported the state is absorbing: the rates are no longer
+// computed and time jumps from one event to the next (forced
+// recoveries and rate changes still apply).  Returns true in that
+// case.
+// rates_vs_time are the rates referred to by the events.  If stop is
+// given, the run is abandoned (returning false) as soon as *stop
+// becomes true (set by the state, see ABC_distance).
+
+bool run(SEIRPopulation &pop,SEEIIRstate *state,const opt::rates_vs_time_t &rates_vs_time,
+	 const event_queue_t &event_queue,const bool *stop=0)
 {
   Exponential_distribution rexp;
   Uniform_real ran(0,1.);
   double deltat,time=0;
   double last=-10;
+  bool   extinct=false;
 
   event_queue_t events=event_queue;
+  int pending_infections=0,Iprev=0;
+  for (event_queue_t q=event_queue; !q.empty(); q.pop())
+    if (q.front().kind==event::infection && q.front().time<std::numeric_limits<double>::max()
+	&& options.imported_infections[q.front().enumber].I>Iprev) {
+      ++pending_infections;
+      Iprev=options.imported_infections[q.front().enumber].I;
+    }
+
   SEEIIR_observer observer(state,pop,options.detail_level,options.dinfo_type,options.dfile);
   Gillespie_sampler<SEEIIR_observer,SEIRPopulation> gsamp(observer,0.,options.steps,1.);
   gsamp.push_data(pop);
 
+  node_data &rootd=pop.treemap[pop.root];
   while (time<=options.steps) {
 
-    // compute transition probabilities
-    pop.compute_rates();
-    double mutot=pop.total_rate;
+    if (stop && *stop) return false;
+
+    double mutot=0;
+    if (pending_infections==0 && rootd.E1+rootd.E2+rootd.I1+rootd.I2==0)  // absorbing state
+      extinct=true;
+    else {
+      // compute transition probabilities
+      pop.compute_rates();
+      mutot=pop.total_rate;
+    }
     // advance time
-    deltat=rexp(1./mutot);
+    deltat= mutot>0 ? rexp(1./mutot) : std::numeric_limits<double>::infinity();
     time+=deltat;
 
     if (time>=events.front().time) {              // imported infections or beta change
@@ -1133,10 +1357,12 @@ void run(SEIRPopulation &pop,SEEIIRstate *state)
 
       switch (events.front().kind) {
       case event::infection:
+	if (options.imported_infections[events.front().enumber].I>pop.gdata.infections_imported)
+	  --pending_infections;
   	pop.force_infection_recover(options.imported_infections[events.front().enumber].I,options.imported_infections[events.front().enumber].R);
   	break;
       case event::rate_change:
-  	pop.set_rate_parameters(options.rates_vs_time[events.front().enumber]);
+  	pop.set_rate_parameters(rates_vs_time[events.front().enumber]);
   	break;
       }
       events.pop();
@@ -1154,6 +1380,7 @@ void run(SEIRPopulation &pop,SEEIIRstate *state)
     gsamp.push_data(pop);
 
   }
+  return extinct;
 } 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1161,15 +1388,17 @@ void run(SEIRPopulation &pop,SEEIIRstate *state)
 // main and noffspring
 //
 // noffspring provides the number of descendants at each tree level
+// (the distributions are per thread, because they use the random
+// number generator of the thread that creates them)
 
-std::vector<Discrete_distribution*> Mdist;
+thread_local std::vector<std::unique_ptr<Discrete_distribution>> Mdist;
 
 void prepare_noffspring()
 {
-  Mdist.resize(options.levels);
+  Mdist.resize(options.levels+1);
   for (int l=options.levels; l>0; --l) {
     if (options.M[l]<0) 
-      Mdist[l]=new Discrete_distribution(options.PM[l].size(),&(options.PM[l][0]));
+      Mdist[l].reset(new Discrete_distribution(options.PM[l].size(),&(options.PM[l][0])));
   }
 }
 
@@ -1179,17 +1408,33 @@ int noffspring(int level)
   return (*(Mdist[level]))();
 }
 
+#if !defined(PARAMETER_SWEEP) && !defined(ABC_SMC)
+
 int main(int argc,char *argv[])
 {
   read_parameters(argc,argv);
   Random_number_generator RNG(options.seed);
-  merge_events();
+  merge_events(options.rates_vs_time,event_queue);
 
   // Prepare global state (for output) and population
   SEEIIRstate *state;
-  state = options.Nruns>1 ?
+  state = options.Nruns>1 || options.avfile ?
           new SEEIIRstate_av : new SEEIIRstate;
-  std::cout << state->header() << '\n';
+  Trajectory_writer *traj=0;
+  Run_archive       *archive=0;
+  if (options.trajfile && (options.Nruns>1 || options.avfile)) {
+    archive=new Run_archive(options.trajfile,1.);
+    archive->add_run_info(argc,argv,options.seed,options.ifile);
+    static_cast<SEEIIRstate_av*>(state)->set_archive(archive);
+  }
+  if (options.trajfile && !archive) {
+    traj=new Trajectory_writer(options.trajfile);
+    traj->add_run_info(argc,argv,options.seed,options.ifile);
+    state->set_trajectory(traj);
+  } else {
+    std::cout << state->header() << '\n';
+    if (options.Nruns==1 && !options.avfile) state->set_async_output();
+  }
 
   prepare_noffspring();
   SEIRPopulation pop(options.levels,noffspring);
@@ -1198,15 +1443,591 @@ int main(int argc,char *argv[])
   // return 1;
 
   // Do runs and print results
+  int extinct=0;
   for (int n=0; n<options.Nruns; ++n) {
     // std::cout << "# N = " << pop.gstate.N << '\n';
-    run(pop,state);
+    extinct+=run(pop,state,options.rates_vs_time,event_queue);
+    if (archive) archive->end_run();
     // pop.check_structures();
     pop.set_all_S();
   }
 
-  if (options.Nruns>1)
+  if (options.Nruns>1 || options.avfile) {
     std::cout << *state;
+    double p=(double) extinct/options.Nruns;
+    printf("# Extinct runs: %d of %d, extinction probability %g +- %g\n",extinct,
+	   options.Nruns,p,sqrt(p*(1-p)/options.Nruns));
+  }
+  if (options.avfile) {
+    std::ofstream avf(options.avfile,std::ios::binary);
+    static_cast<SEEIIRstate_av*>(state)->save(avf);
+  }
 
+  delete traj;
+  delete archive;
   delete state;
 }
+
+#elif defined(PARAMETER_SWEEP)
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Parameter sweep (seeiir_h_sweep)
+//
+// Each line of the sweep file is a parameter set: one or more records
+// of rate constants (time beta_1 ... beta_Nlevels sigma_1 sigma_2
+// gamma_1 gamma_2), which replace the rates of the parameter file.
+// Any value can be a range a:b:n, and the line then expands to all the
+// combinations of the values of its ranges (the last one varying
+// fastest).  Sets are numbered from 0 in order of appearance.
+
+struct sweep_point {
+  opt::rates_vs_time_t rates;
+  std::string          desc;      // the values, for the output header
+} ;
+
+std::vector<sweep_point> sweep_points;
+
+void read_sweep()
+{
+  std::ifstream f(options.sweepfile);
+  if (!f) throw std::runtime_error(std::string("Cannot open ")+options.sweepfile);
+
+  const int nrec=options.levels+5;        // values in a rates record
+  std::string line;
+  while (std::getline(f,line)) {
+    if (line.empty() || line[0]=='#') continue;
+    std::istringstream ls(line);
+    std::vector<std::vector<double>> values;
+    std::string field;
+    while (ls >> field) {
+      double a,b;
+      int    n;
+      std::vector<double> v;
+      if (sscanf(field.c_str(),"%lg:%lg:%d",&a,&b,&n)==3 && n>0)
+	for (int i=0; i<n; ++i) v.push_back(n>1 ? a+(b-a)*i/(n-1) : a);
+      else if (sscanf(field.c_str(),"%lg",&a)==1)
+	v.push_back(a);
+      else
+	throw std::runtime_error("Bad value in sweep file: "+field);
+      values.push_back(v);
+    }
+    if (values.empty()) continue;
+    if (values.size()%nrec!=0)
+      throw std::runtime_error("Wrong number of values in sweep file line: "+line);
+
+    std::vector<int> ix(values.size(),0);   // odometer over the ranges
+    do {
+      sweep_point p;
+      std::vector<double> v(values.size());
+      char buf[30];
+      for (int i=0; i<(int) values.size(); ++i) {
+	v[i]=values[i][ix[i]];
+	sprintf(buf," %g",v[i]);
+	p.desc+=buf;
+      }
+      p.rates=rates_from_values(v);
+      sweep_points.push_back(p);
+
+      int i;
+      for (i=values.size()-1; i>=0; --i) {
+	if (++ix[i]<(int) values[i].size()) break;
+	ix[i]=0;
+      }
+      if (i<0) break;
+    } while (true);
+  }
+
+  printf("#\n# Parameter sets (time beta_1 ... beta_%d sigma_1 sigma_2 gamma_1 gamma_2 ...):\n",
+	 options.levels);
+  for (int k=0; k<(int) sweep_points.size(); ++k)
+    printf("# %7d %s\n",k,sweep_points[k].desc.c_str());
+  printf("#\n# Threads = %d\n",options.Nthreads);
+}
+
+/*
+ * run_sweep
+ *
+ * Each thread builds its own population, with the seed of the command
+ * line (so that all threads have the same hierarchy), and reuses it
+ * for all the parameter sets it takes.  Set k is simulated with seed
+ * seed+1+k, so the results do not depend on the number of threads.
+ * The averages of each set are printed (by the main thread, in order)
+ * as the seeiir_h averages, preceded by the index of the set.
+ *
+ */
+
+// the header of SEEIIRstate_av, with the parameter set column added
+std::string sweep_header()
+{
+  SEEIIRstate_av state;
+  std::istringstream hs(state.header());
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(hs,line)) lines.push_back(line);
+
+  std::string hdr="#     ( 1)|";
+  int nc=std::count(lines[0].begin(),lines[0].end(),'(');
+  char buf[30];
+  for (int i=2; i<=nc+1; ++i) {
+    sprintf(buf," |     (%2d)|",i);
+    hdr+=buf;
+  }
+  hdr+="\n";
+  for (int i=1; i<(int) lines.size(); ++i)
+    hdr+=(i==(int) lines.size()-1 ? "#  paramset " : "#           ")+(" "+lines[i].substr(1))+"\n";
+  return hdr;
+}
+
+void run_sweep()
+{
+  const int npoints=sweep_points.size();
+  const int ahead=4*options.Nthreads;      // results waiting to be printed are at most this
+  std::vector<SEEIIRstate_av*> result(npoints,(SEEIIRstate_av*) 0);
+  std::mutex              mtx;
+  std::condition_variable cv;
+  int next=0,printed=0;
+
+  auto worker=[&]() {
+    Random_number_generator RNG(options.seed);
+    prepare_noffspring();
+    SEIRPopulation pop(options.levels,noffspring);
+    event_queue_t  events;
+    for (;;) {
+      int k;
+      {
+	std::unique_lock<std::mutex> lock(mtx);
+	cv.wait(lock,[&]() {return next>=npoints || next<printed+ahead;});
+	if (next>=npoints) return;
+	k=next++;
+      }
+      RNG.set_seed(options.seed+1+k);
+      merge_events(sweep_points[k].rates,events);
+      SEEIIRstate_av *state=new SEEIIRstate_av;
+      for (int n=0; n<options.Nruns; ++n) {
+	run(pop,state,sweep_points[k].rates,events);
+	pop.set_all_S();
+      }
+      {
+	std::lock_guard<std::mutex> lock(mtx);
+	result[k]=state;
+      }
+      cv.notify_all();
+    }
+  };
+
+  std::cout << sweep_header();
+  std::vector<std::thread> threads;
+  for (int t=0; t<options.Nthreads; ++t) threads.emplace_back(worker);
+
+  for (int k=0; k<npoints; ++k) {
+    SEEIIRstate_av *state;
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      cv.wait(lock,[&]() {return result[k]!=0;});
+      state=result[k];
+    }
+    std::ostringstream rows;
+    state->print(rows,true);
+    std::istringstream rs(rows.str());
+    std::string row;
+    char buf[20];
+    sprintf(buf,"%11d ",k);
+    while (std::getline(rs,row)) std::cout << buf << row << '\n';
+    delete state;
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      printed=k+1;
+    }
+    cv.notify_all();
+  }
+  for (auto &t: threads) t.join();
+}
+
+int main(int argc,char *argv[])
+{
+  read_parameters(argc,argv);
+  run_sweep();
+}
+
+#else /* ABC_SMC */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ABC-SMC calibration (seeiir_h_abc)
+//
+// Fits the rate constants given as ranges in the prior file to a
+// series of observed cases, with the ABC population Monte Carlo of
+// Beaumont et al. (Biometrika 96, 983 (2009)).  The particles of the
+// first generation are drawn from the prior (uniform in the ranges);
+// those of the following ones by picking a particle of the previous
+// generation according to its weight and moving each parameter with a
+// gaussian kernel of twice the (weighted) variance of the previous
+// generation, truncated to the prior ranges (the move is redrawn until
+// inside, and the weights divide the kernel by its mass inside the
+// prior).  A particle is accepted if the distance between the
+// cases of a run and the observed ones is not larger than the
+// tolerance, which is the median of the distances of the previous
+// generation (infinite for the first one).
+//
+// The distance is accumulated as the run is sampled, and since it can
+// only grow the run is abandoned as soon as it exceeds the tolerance.
+
+struct free_parameter {
+  int         index;      // position in the values of the prior file
+  double      a,b;        // prior range
+  std::string name;
+} ;
+
+std::vector<double>         prior_values;   // values of the prior file (fitted ones are set per particle)
+std::vector<free_parameter> free_parameters;
+
+struct observation {
+  double time;
+  double cases;
+} ;
+
+std::vector<observation>    observed;
+
+/*
+ * The prior file gives the rate constants vs time as the rate table of
+ * the parameter file (the records may be split across lines); values
+ * of the form a:b are fitted, with uniform prior in [a,b].  Record
+ * times are fixed (a fitted time could put the records out of order)
+ *
+ */
+void read_prior()
+{
+  std::ifstream f(options.priorfile);
+  if (!f) throw std::runtime_error(std::string("Cannot open ")+options.priorfile);
+
+  const int nrec=options.levels+5;        // values in a rates record
+  std::vector<std::string> fields;
+  std::string line,field;
+  while (std::getline(f,line)) {
+    if (line.empty() || line[0]=='#') continue;
+    std::istringstream ls(line);
+    while (ls >> field) fields.push_back(field);
+  }
+  if (fields.empty() || fields.size()%nrec!=0)
+    throw std::runtime_error("Wrong number of values in prior file");
+
+  static const char *rname[]={"sigma_1","sigma_2","gamma_1","gamma_2"};
+  for (int i=0; i<(int) fields.size(); ++i) {
+    double a,b;
+    int col=i%nrec;                       // 0 is the record time
+    if (sscanf(fields[i].c_str(),"%lg:%lg",&a,&b)==2) {
+      if (col==0) throw std::runtime_error("Record times cannot be fitted: "+fields[i]);
+      if (b<=a) throw std::runtime_error("Empty prior range: "+fields[i]);
+      free_parameter fp;
+      fp.index=i;
+      fp.a=a;
+      fp.b=b;
+      fp.name= col<=options.levels ? "beta_"+std::to_string(col) : rname[col-options.levels-1];
+      if ((int) fields.size()>nrec) fp.name+="("+std::to_string(i/nrec+1)+")";
+      free_parameters.push_back(fp);
+      prior_values.push_back(a);
+    } else if (sscanf(fields[i].c_str(),"%lg",&a)==1)
+      prior_values.push_back(a);
+    else
+      throw std::runtime_error("Bad value in prior file: "+fields[i]);
+  }
+  if (free_parameters.empty())
+    throw std::runtime_error("No parameter to fit in prior file");
+
+  printf("#\n# Fitted parameters (uniform prior), record number in parenthesis:\n");
+  for (auto &fp: free_parameters)
+    printf("# %11s in [%g,%g]\n",fp.name.c_str(),fp.a,fp.b);
+}
+
+/*
+ * The data file gives the observed cases: each line has an (integer)
+ * time and the number of new cases since the time of the previous
+ * line (or since the start, for the first one).  The runs go up to the
+ * last time.
+ *
+ */
+void read_observed()
+{
+  FILE *f=fopen(options.datafile,"r");
+  if (f==0) throw std::runtime_error(strerror(errno));
+
+  observation o;
+  while (ungetc(fgetc(f),f)!=EOF) {
+    char *buf=readbuf(f);
+    if (sscanf(buf,"%lg %lg",&o.time,&o.cases)!=2) {
+      std::cerr  << "couldn't read record: " << buf << "\n";
+      throw std::runtime_error("Bad record in data file");
+    }
+    if (o.time!=floor(o.time) || o.time<0 || (!observed.empty() && o.time<=observed.back().time))
+      throw std::runtime_error("Observation times must be increasing integers");
+    observed.push_back(o);
+  }
+  fclose(f);
+  if (observed.empty()) throw std::runtime_error("No observations in data file");
+  options.steps=observed.back().time;
+
+  printf("#\n# %d observations, from time %g to %g\n",(int) observed.size(),
+	 observed.front().time,observed.back().time);
+  printf("#\n# Threads = %d\n",options.Nthreads);
+}
+
+/*
+ * ABC_distance: takes the place of SEEIIRstate in run(), comparing the
+ * cases of the run (infections imported, by close contact or
+ * community) with the observed ones at the observation times.  The
+ * distance is the euclidean norm of the differences; rejected becomes
+ * true as soon as it exceeds the tolerance.
+ *
+ */
+class ABC_distance : public SEEIIRstate {
+public:
+  void   start(double tolerance);
+  void   push(double time,SEEIIRistate &s);
+  double distance() const {return sqrt(d2);}
+  double last_time() const {return tlast;}   // last sampled time
+
+  bool   rejected;
+
+private:
+  double tol2,d2,tlast;
+  int    next,cprev;
+} ;
+
+void ABC_distance::start(double tolerance)
+{
+  tol2=tolerance*tolerance;
+  d2=0;
+  tlast=0;
+  next=0;
+  cprev=0;
+  rejected=false;
+}
+
+void ABC_distance::push(double time,SEEIIRistate &s)
+{
+  tlast=time;
+  if (next>=(int) observed.size() || time+0.5<observed[next].time) return;
+  int    c=s.inf_imported+s.inf_close+s.inf_community;
+  double x=c-cprev-observed[next].cases;
+  d2+=x*x;
+  cprev=c;
+  ++next;
+  if (d2>tol2) rejected=true;
+}
+
+struct particle {
+  std::vector<double> theta;      // the fitted parameters
+  double              distance;
+  double              weight;
+} ;
+
+// Simulate with parameters theta, returns true if accepted
+bool simulate(SEIRPopulation &pop,const std::vector<double> &theta,double tolerance,
+	      ABC_distance &dist,event_queue_t &events)
+{
+  std::vector<double> v=prior_values;
+  for (int k=0; k<(int) theta.size(); ++k) v[free_parameters[k].index]=theta[k];
+  opt::rates_vs_time_t rates=rates_from_values(v);
+  merge_events(rates,events);
+  dist.start(tolerance);
+  run(pop,&dist,rates,events,&dist.rejected);
+  pop.set_all_S();
+  return !dist.rejected;
+}
+
+/*
+ * run_abc
+ *
+ * The threads live through all the generations, each with its own
+ * population, built with the seed of the command line (so that all
+ * threads have the same hierarchy).  Particle i of generation g is
+ * drawn and simulated (as many times as needed until accepted) with
+ * seed seed+1+g*Nparticles+i, so the results do not depend on the
+ * number of threads.
+ *
+ */
+void run_abc()
+{
+  const int    np=free_parameters.size();
+  const int    N=options.Nparticles;
+  const double quantile=0.5;              // tolerance quantile of the previous distances
+
+  std::vector<particle> prev,cur(N);
+  std::vector<double>   wprev(N),ksigma(np);
+  double tolerance=std::numeric_limits<double>::infinity();
+
+  std::mutex              mtx;
+  std::condition_variable cv;
+  int    gen=-1,next=0,idle=0;
+  bool   quit=false;
+  long   nsim=0;
+  double tsim=0;
+
+  auto worker=[&]() {
+    Random_number_generator RNG(options.seed);
+    prepare_noffspring();
+    SEIRPopulation          pop(options.levels,noffspring);
+    Uniform_real            ran(0,1.);
+    Gaussian_distribution   gauss;
+    ABC_distance            dist;
+    event_queue_t           events;
+    std::vector<double>     theta(np);
+    for (int g=0; ; ++g) {
+      {
+	std::unique_lock<std::mutex> lock(mtx);
+	cv.wait(lock,[&]() {return quit || gen==g;});
+	if (quit) return;
+      }
+      Discrete_distribution *pick= g>0 ? new Discrete_distribution(N,wprev.data()) : 0;
+      long   ns=0;
+      double ts=0;
+      for (;;) {
+	int i;
+	{
+	  std::lock_guard<std::mutex> lock(mtx);
+	  if (next>=N) break;
+	  i=next++;
+	}
+	RNG.set_seed(options.seed+1+(long) g*N+i);
+	do {
+	  if (g==0)
+	    for (int k=0; k<np; ++k)
+	      theta[k]=free_parameters[k].a+(free_parameters[k].b-free_parameters[k].a)*ran();
+	  else {
+	    const particle &p=prev[(*pick)()];
+	    bool inside;
+	    do {                               // perturb until inside the prior
+	      inside=true;
+	      for (int k=0; k<np; ++k) {
+		theta[k]=gauss(p.theta[k],ksigma[k]);
+		inside = inside && theta[k]>=free_parameters[k].a && theta[k]<=free_parameters[k].b;
+	      }
+	    } while (!inside);
+	  }
+	  ++ns;
+	  bool accepted=simulate(pop,theta,tolerance,dist,events);
+	  ts+=dist.last_time();
+	  if (accepted) break;
+	} while (true);
+	cur[i].theta=theta;
+	cur[i].distance=dist.distance();
+      }
+      delete pick;
+      {
+	std::lock_guard<std::mutex> lock(mtx);
+	nsim+=ns;
+	tsim+=ts;
+	++idle;
+      }
+      cv.notify_all();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int t=0; t<options.Nthreads; ++t) threads.emplace_back(worker);
+
+  printf("#\n");
+  for (int g=0; g<options.Ngenerations; ++g) {
+
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      next=idle=0;
+      nsim=0;
+      tsim=0;
+      gen=g;
+      cv.notify_all();
+      cv.wait(lock,[&]() {return idle==options.Nthreads;});
+    }
+
+    // weights: prior (constant inside the ranges) over the density of the proposal
+    if (g==0)
+      for (auto &p: cur) p.weight=1./N;
+    else {
+      // log of the mass inside the prior of the kernel around each
+      // previous particle
+      std::vector<double> logZ(N,0.);
+      for (int j=0; j<N; ++j)
+	for (int k=0; k<np; ++k) {
+	  double za=(free_parameters[k].a-prev[j].theta[k])/(M_SQRT2*ksigma[k]);
+	  double zb=(free_parameters[k].b-prev[j].theta[k])/(M_SQRT2*ksigma[k]);
+	  logZ[j]+=log(0.5*(erf(zb)-erf(za)));
+	}
+      std::vector<double> logw(N),e(N);
+      for (int i=0; i<N; ++i) {
+	double m=-std::numeric_limits<double>::infinity();
+	for (int j=0; j<N; ++j) {
+	  double s=0;
+	  for (int k=0; k<np; ++k) {
+	    double z=(cur[i].theta[k]-prev[j].theta[k])/ksigma[k];
+	    s+=z*z;
+	  }
+	  e[j]=-0.5*s-logZ[j];
+	  m=std::max(m,e[j]);
+	}
+	double sum=0;
+	for (int j=0; j<N; ++j) sum+=prev[j].weight*exp(e[j]-m);
+	logw[i]=-m-log(sum);
+      }
+      double mx=*std::max_element(logw.begin(),logw.end());
+      double tot=0;
+      for (int i=0; i<N; ++i) tot+=cur[i].weight=exp(logw[i]-mx);
+      for (auto &p: cur) p.weight/=tot;
+    }
+
+    double ess=0;
+    for (auto &p: cur) ess+=p.weight*p.weight;
+    printf("# Generation %d: tolerance %g, %ld simulations (acceptance %g), %.1f%% of the observed period simulated, ESS %g\n",
+	   g,tolerance,nsim,(double) N/nsim,100*tsim/(nsim*options.steps),1./ess);
+
+    // kernel widths, posterior summary and next tolerance
+    for (int k=0; k<np; ++k) {
+      double m=0,m2=0;
+      for (auto &p: cur) {
+	m+=p.weight*p.theta[k];
+	m2+=p.weight*p.theta[k]*p.theta[k];
+      }
+      double var=std::max(0.,m2-m*m);
+      printf("#     %11s = %g +- %g\n",free_parameters[k].name.c_str(),m,sqrt(var));
+      ksigma[k]=sqrt(2*var);
+      if (ksigma[k]==0) ksigma[k]=1e-6*(free_parameters[k].b-free_parameters[k].a);
+    }
+    fflush(stdout);
+
+    std::vector<double> d(N);
+    for (int i=0; i<N; ++i) d[i]=cur[i].distance;
+    std::nth_element(d.begin(),d.begin()+(int) (quantile*(N-1)),d.end());
+    tolerance=d[(int) (quantile*(N-1))];
+
+    prev.swap(cur);
+    cur.resize(N);
+    for (int i=0; i<N; ++i) wprev[i]=prev[i].weight;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    quit=true;
+  }
+  cv.notify_all();
+  for (auto &t: threads) t.join();
+
+  // the last generation
+  int nc=3+np;
+  printf("#\n#     ( 1)|");
+  for (int i=2; i<=nc; ++i) printf(" |     (%2d)|",i);
+  printf("\n#  particle %11s %11s ","weight","distance");
+  for (auto &fp: free_parameters) printf("%11s ",fp.name.c_str());
+  printf("\n");
+  for (int i=0; i<N; ++i) {
+    printf("%11d %11g %11g ",i,prev[i].weight,prev[i].distance);
+    for (double x: prev[i].theta) printf("%11g ",x);
+    printf("\n");
+  }
+}
+
+int main(int argc,char *argv[])
+{
+  read_parameters(argc,argv);
+  run_abc();
+}
+
+#endif
@@ -0,0 +1,561 @@
+/*
+ * seeiir_h_ode.cc
+ *
+ * Deterministic counterpart of the hierarchical SEEIIR of seeiir_h.
+ * Within the families (level 1) the dynamics is kept exactly, through
+ * the household master equation (as in seeiir_ode): the unknowns are
+ * the expected number of families of each size and composition.  At
+ * the higher levels (neighbourhoods, towns, ...) the nodes are large,
+ * and the infected in a node outside one's own family are taken as
+ * their expected number, i.e. each level adds a mean-field force of
+ * infection, weighted with the 1/(N_l-1) normalisation of seeiir_h
+ * (N_l being the expected size of the level l nodes).  The result
+ * approximates the average of seeiir_h over many runs, and takes
+ * milliseconds to compute, so it can be used to explore the
+ * parameters before running the stochastic model.
+ *
+ * Command-line arguments are the parameter file (the same as for
+ * seeiir_h, see seeiir_h_par.dat) and the maximum time; optionally,
+ * the relative tolerance of the integration.  Imported infections,
+ * forced recoveries (and their undoing) and the rate changes are
+ * applied at their times, integrating up to them.  Output has the
+ * columns of a single run of seeiir_h, with expected (real) numbers,
+ * followed by the cumulative infections transmitted at each level
+ * (1 = within the family).  The close contact and community columns
+ * are classified as in seeiir_h, when the infected become I1 (close
+ * if another member of the family is then infected or recovered);
+ * the infections by level are instead counted when they happen
+ * (S->E1), according to the level through which they are transmitted.
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <vector>
+#include <map>
+#include <array>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "popstate.hh"
+#include "odeint.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// options and parameters
+
+struct rates_t {
+  double time;
+  std::vector<double> beta;
+  double sigma1,sigma2,gamma1,gamma2;
+
+  rates_t(int levels) :
+    time(0.),
+    beta(levels+1,0.),
+    sigma1(0), sigma2(0), gamma1(0), gamma2(0)
+  {}
+} ;
+
+struct opt {
+  int    last_arg_read;
+
+  char   *ifile;
+  int    steps;
+  double rtol;
+
+  int               levels;       // tree depth (not counting individuals)
+  std::vector<int>  M;            // number of descendants at each level (negative=fluctuating)
+  std::vector<std::vector<double>> PM; // Distribution of descendants
+  std::string eifile;             // File to read imported infected cases
+
+  // imported infections
+  struct ei {double time; int I; int R;} ;
+  typedef std::vector<ei>               imported_infections_t;
+  imported_infections_t                 imported_infections;
+  // rates vs time
+  typedef std::vector<rates_t>          rates_vs_time_t;
+  rates_vs_time_t                       rates_vs_time;
+
+  opt() : last_arg_read(0), rtol(1e-8) {}
+
+} options;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Read parameters from command-line and file
+
+#include "read_arg.hh"
+
+static int nargs=2;
+
+void show_usage(char *prog)
+{
+  std::cerr << "usage: " << prog << " parameterfile steps [rtol]\n\n"
+	    << "rtol is the relative tolerance of the integration (default 1e-8)\n";
+  exit(1);
+}
+
+char *readbuf(FILE *f)
+{
+  static char buf[5000];
+  char *s;
+  do
+    s=fgets(buf,1000,f);
+  while (*buf=='#');
+  return buf;
+}
+
+void read_imported_infections()
+{
+  FILE *f=fopen(options.eifile.c_str(),"r");
+  if (f==0) {
+    std::cerr << "Error opening file (" << options.eifile << ")\n";
+    throw std::runtime_error(strerror(errno));
+  }
+
+  opt::ei ei;
+  while (ungetc(fgetc(f),f)!=EOF) {
+    char *buf=readbuf(f);
+    if (sscanf(buf,"%lg  %d  %d",&ei.time,&ei.I,&ei.R)!=3) {
+      std::cerr  << "couldn't read record: " << buf << "\n";
+      throw std::runtime_error(strerror(errno));}
+    options.imported_infections.push_back(ei);
+  }
+
+  fclose(f);
+}
+
+void read_rates_vs_time(FILE *f)
+{
+  rates_t rates(options.levels);
+  int ncread=0;
+
+  while (ungetc(fgetc(f),f)!=EOF) {
+    char *buf=readbuf(f);
+    if (sscanf(buf,"%lg %n",&rates.time,&ncread)!=1) {
+      std::cerr  << "couldn't read record: " << buf << "\n";
+      throw std::runtime_error(strerror(errno));}
+    for (int i=1; i<=options.levels; ++i) {
+      buf+=ncread;
+      if (sscanf(buf,"%lg %n",&(rates.beta[i]),&ncread)!=1 ) {
+	std::cerr  << "couldn't read record: " << buf << "\n";
+	throw std::runtime_error(strerror(errno));}
+    }
+    buf+=ncread;
+    if (sscanf(buf,"%lg %lg %lg %lg",&(rates.sigma1),&(rates.sigma2),&(rates.gamma1),
+	       &(rates.gamma2) )!=4) {
+	std::cerr  << "couldn't read record: " << buf << "\n";
+	throw std::runtime_error(strerror(errno));}
+    options.rates_vs_time.push_back(rates);
+  }
+}
+
+void read_parameters(int argc,char *argv[])
+{
+  if (argc!=nargs+1 && argc!=nargs+2) show_usage(argv[0]);
+  read_arg(argv,options.ifile);
+  read_arg(argv,options.steps);
+  if (argc==nargs+2) read_arg(argv,options.rtol);
+
+  FILE *f=fopen(options.ifile,"r");
+  if (f==0) throw std::runtime_error(strerror(errno));
+
+  char *buf=readbuf(f);
+  sscanf(buf,"%d",&options.levels);
+  printf("##### Parameters\n");
+  printf("# Nlevels = %d\n",options.levels);
+
+  options.M.resize(options.levels+1);
+  options.PM.resize(options.levels+1);
+  for (int lev=options.levels; lev>0; --lev) {
+    buf=readbuf(f);
+    sscanf(buf,"%d",&(options.M[lev]));
+    if (options.M[lev]<0) {
+      options.PM[lev].resize(-options.M[lev]+1);
+      options.PM[lev][0]=0.;
+      for (int M=1; M<=-options.M[lev]; ++M) {
+	buf=readbuf(f);
+	sscanf(buf,"%lg",&(options.PM[lev][M]));
+      }
+    }
+  }
+
+  for (int lev=options.levels; lev>0; --lev) {
+    printf("# Number of descendants at level %d = ",lev);
+    if (options.M[lev]>0) printf("%d\n",options.M[lev]);
+    else {
+      printf(" 1 to %d, with weights: \n",-options.M[lev]);
+      for (int i=1; i<options.PM[lev].size(); ++i)
+	printf("#       %d:   %g\n",i,options.PM[lev][i]);
+    }
+  }
+
+  buf=readbuf(f);
+  options.eifile=buf;
+  options.eifile.erase(options.eifile.end()-1);   // remove trailing newline
+  read_imported_infections();
+
+  printf("# Imported infections:\n");
+  printf("# Time   Imported_inf  Forced_R\n");
+  for (auto iir: options.imported_infections)
+    printf("# %g %d %d\n",iir.time,iir.I,iir.R);
+
+  read_rates_vs_time(f);
+  fclose(f);
+
+  printf("#\n# Rate constatst:\n");
+  printf("# time ");
+  for (int i=1; i<=options.levels; ++i) printf("beta_%d ",i);
+  printf("sigma_1 sigma_2 gamma_1 gamma_2\n");
+  for (auto r:options.rates_vs_time) {
+    printf("# %g ",r.time);
+    for (int i=1; i<=options.levels; ++i) printf("%g ",r.beta[i]);
+    printf("%g %g %g %g\n",r.sigma1,r.sigma2,r.gamma1,r.gamma2);
+  }
+  printf("#\n# Deterministic (household master equation + mean field), rtol = %g\n",
+	 options.rtol);
+}
+
+// Average number of descendants at level lev
+double mean_offspring(int lev)
+{
+  if (options.M[lev]>0) return options.M[lev];
+  double sum=0,sumw=0;
+  for (int M=1; M<(int) options.PM[lev].size(); ++M) {
+    sum+=M*options.PM[lev][M];
+    sumw+=options.PM[lev][M];
+  }
+  return sum/sumw;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Hierarchical_ODE
+//
+// y holds the expected number of families of each composition, then
+// the cumulative number of infections transmitted at each level, and
+// the cumulative close contact and community infections.  The
+// compositions count, besides the SEEIIR states, the forcibly
+// recovered (RF), which can be made susceptible again; they are
+// reported as R.
+
+class Hierarchical_ODE {
+public:
+  Hierarchical_ODE(int levels);
+
+  enum {S,E1,E2,I1,I2,R,RF,nstates};
+  typedef std::array<int,nstates> comp_t;
+
+  int    size() const {return comp.size()+levels+2;}
+  void   set_all_S(double *y) const;
+  void   add_imported(double *y,double I) const;
+  void   force_recover(double *y,double R) const;
+  void   unrecover(double *y,double R) const;
+  void   rhs(const double *y,double *dydt) const;
+  void   totals(const double *y,double *n) const;  // individuals in each state
+
+  double  N;               // population (expected)
+  rates_t rates;
+
+private:
+  int    levels,Mmax;
+  int    iinf;             // y[iinf+l-1]: infections through level l
+  int    iclose;           // y[iclose], y[iclose+1]: close contact and community
+
+  std::vector<comp_t>  comp;
+  std::map<comp_t,int> index;       // of each composition in comp
+  std::vector<int>     first;       // first composition of each size
+  std::vector<double>  nfam0;       // families of each size
+  // transitions: moves one individual from state from[tr] to state tr_to[tr]
+  enum {SE1,E1E2,E2I1,I1I2,I2R,SI1,SRF,RFS,ntrans};
+  static const int from[ntrans],tr_to[ntrans];
+  std::vector<std::array<int,ntrans>> to;   // composition after each transition
+  // weight of the infected within the family and of the total number
+  // of infected in the infection through level l of the members of a
+  // family of size M: w_in[l][M], w_out[l][M]
+  std::vector<std::vector<double>> w_in,w_out;
+
+  void add_compositions(comp_t &c,int state,int left);
+  void move(double *y,int tr,int count_state,double n) const;
+} ;
+
+const int Hierarchical_ODE::from[ntrans]={S,E1,E2,I1,I2,S,S,RF};
+const int Hierarchical_ODE::tr_to[ntrans]={E1,E2,I1,I2,R,I1,RF,S};
+
+Hierarchical_ODE::Hierarchical_ODE(int levels) :
+  rates(levels),
+  levels(levels),
+  w_in(levels+1),
+  w_out(levels+1)
+{
+  // families of each size, and expected size of the nodes of each level
+  std::vector<double> PM;
+  if (options.M[1]>0) {
+    Mmax=options.M[1];
+    PM.assign(Mmax+1,0.);
+    PM[Mmax]=1.;
+  } else {
+    Mmax=-options.M[1];
+    PM=options.PM[1];
+  }
+  double Ptot=0;
+  for (int M=1; M<=Mmax; ++M) Ptot+=PM[M];
+  double Nfamilies=1;
+  for (int l=2; l<=levels; ++l) Nfamilies*=mean_offspring(l);
+  nfam0.assign(Mmax+1,0.);
+  N=0;
+  for (int M=1; M<=Mmax; ++M) {
+    nfam0[M]=Nfamilies*PM[M]/Ptot;
+    N+=M*nfam0[M];
+  }
+
+  // A susceptible in a family of size M with i infected sees in its
+  // level l node (l>1) the i plus the expected infected among the
+  // other N_l-M members, (Itot-i)(N_l-M)/(N-M); at the top level
+  // N_l=N and this is just Itot
+  std::vector<double> Nl(levels+1);
+  Nl[1]=mean_offspring(1);
+  for (int l=2; l<=levels; ++l) Nl[l]=Nl[l-1]*mean_offspring(l);
+  for (int l=1; l<=levels; ++l) {
+    w_in[l].assign(Mmax+1,0.);
+    w_out[l].assign(Mmax+1,0.);
+    for (int M=1; M<=Mmax; ++M) {
+      if (l==1 || Nl[l]<=M) {        // the node is just the family
+	if (M>1) w_in[l][M]=1./(M-1);
+	continue;
+      }
+      double out=(Nl[l]-M)/(N-M);
+      w_in[l][M]=(1.-out)/(Nl[l]-1);
+      w_out[l][M]=out/(Nl[l]-1);
+    }
+  }
+
+  // all the compositions of each size
+  first.resize(Mmax+2);
+  for (int M=0; M<=Mmax; ++M) {
+    first[M]=comp.size();
+    comp_t c;
+    add_compositions(c,0,M);
+  }
+  first[Mmax+1]=comp.size();
+  iinf=comp.size();
+  iclose=iinf+levels;
+
+  to.resize(comp.size());
+  for (int k=0; k<(int) comp.size(); ++k)
+    for (int tr=0; tr<ntrans; ++tr) {
+      comp_t c=comp[k];
+      if (c[from[tr]]==0) {to[k][tr]=-1; continue;}
+      c[from[tr]]--; c[tr_to[tr]]++;
+      to[k][tr]=index[c];
+    }
+}
+
+// Recursively list the compositions with left individuals in states
+// state and following (those with more S first, so that the first of
+// each size is all S)
+void Hierarchical_ODE::add_compositions(comp_t &c,int state,int left)
+{
+  if (state==nstates-1) {
+    c[state]=left;
+    index[c]=comp.size();
+    comp.push_back(c);
+    return;
+  }
+  for (c[state]=left; c[state]>=0; --c[state])
+    add_compositions(c,state+1,left-c[state]);
+}
+
+void Hierarchical_ODE::set_all_S(double *y) const
+{
+  for (int k=0; k<size(); ++k) y[k]=0;
+  for (int M=1; M<=Mmax; ++M)
+    y[first[M]]=nfam0[M];             // the first composition of each size is all S
+}
+
+// Apply transition tr to n randomly chosen individuals in state
+// count_state, in proportion to their number in each composition
+void Hierarchical_ODE::move(double *y,int tr,int count_state,double n) const
+{
+  double tot=0;
+  for (int k=0; k<(int) comp.size(); ++k) tot+=comp[k][count_state]*y[k];
+  if (n>tot*(1+1e-8)) throw std::runtime_error("Not enough individuals to move");
+  if (n<=0) return;
+  n=std::min(n,tot);                  // tot may be short by rounding errors
+  std::vector<double> dy(comp.size(),0.);
+  for (int k=0; k<(int) comp.size(); ++k) {
+    if (comp[k][count_state]==0) continue;
+    double moved=n*comp[k][count_state]*y[k]/tot;
+    dy[k]-=moved;
+    dy[to[k][tr]]+=moved;
+  }
+  for (int k=0; k<(int) comp.size(); ++k) y[k]+=dy[k];
+}
+
+void Hierarchical_ODE::add_imported(double *y,double I) const
+{
+  move(y,SI1,S,I);
+}
+
+void Hierarchical_ODE::force_recover(double *y,double R) const
+{
+  move(y,SRF,S,R);
+}
+
+void Hierarchical_ODE::unrecover(double *y,double R) const
+{
+  move(y,RFS,RF,R);
+}
+
+void Hierarchical_ODE::rhs(const double *y,double *dydt) const
+{
+  double Itot=0;
+  for (int k=0; k<(int) comp.size(); ++k) Itot+=(comp[k][I1]+comp[k][I2])*y[k];
+
+  // infection rate per susceptible of a family of size M with i infected:
+  // a[M]*i + b[M]
+  std::vector<double> a(Mmax+1,0.),b(Mmax+1,0.);
+  for (int l=1; l<=levels; ++l)
+    for (int M=1; M<=Mmax; ++M) {
+      a[M]+=rates.beta[l]*w_in[l][M];
+      b[M]+=rates.beta[l]*w_out[l][M]*Itot;
+    }
+  double r_tr[5]={0,rates.sigma1,rates.sigma2,rates.gamma1,rates.gamma2};
+
+  for (int k=0; k<size(); ++k) dydt[k]=0;
+  for (int M=1; M<=Mmax; ++M)
+    for (int k=first[M]; k<first[M+1]; ++k) {
+      if (y[k]==0) continue;
+      const comp_t &c=comp[k];
+      int    i=c[I1]+c[I2];
+      double r[5];
+      r[SE1]=c[S]*(a[M]*i+b[M])*y[k];
+      for (int tr=E1E2; tr<=I2R; ++tr) r[tr]=r_tr[tr]*c[from[tr]]*y[k];
+      for (int tr=SE1; tr<=I2R; ++tr) {
+	if (r[tr]==0) continue;
+	dydt[k]-=r[tr];
+	dydt[to[k][tr]]+=r[tr];
+      }
+      // classified when becoming I1, by whether others in the family
+      // are (or have been) infected, as count_infection_kind() does
+      if (c[I1]+c[I2]+c[R]+c[RF]>0) dydt[iclose]+=r[E2I1];
+      else dydt[iclose+1]+=r[E2I1];
+      if (r[SE1]==0) continue;
+      for (int l=1; l<=levels; ++l)
+	dydt[iinf+l-1]+=rates.beta[l]*c[S]*(w_in[l][M]*i+w_out[l][M]*Itot)*y[k];
+    }
+}
+
+// n[0..5]: S,E1,E2,I1,I2,R (including the forcibly recovered);
+// n[6..5+levels]: infections through each level; n[6+levels],
+// n[7+levels]: close contact and community infections
+void Hierarchical_ODE::totals(const double *y,double *n) const
+{
+  for (int s=0; s<=R; ++s) n[s]=0;
+  for (int k=0; k<(int) comp.size(); ++k) {
+    for (int s=0; s<=R; ++s) n[s]+=comp[k][s]*y[k];
+    n[R]+=comp[k][RF]*y[k];
+  }
+  for (int l=1; l<=levels; ++l) n[R+l]=y[iinf+l-1];
+  n[R+levels+1]=y[iclose];
+  n[R+levels+2]=y[iclose+1];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// main
+
+void print(SEEIIRstate &state,double time,const double *n,int levels,double imported,
+	   double N,double beta_out,double RR)
+{
+  state.time=time;
+  state.S[0]=n[0];
+  state.E[0]=n[1];
+  state.E[1]=n[2];
+  state.I[0]=n[3];
+  state.I[1]=n[4];
+  state.R[0]=n[5];
+  state.print(std::cout,true);
+  printf("%11.6g %11.6g %11.6g %11.6g %11.6g %11.6g",imported,n[6+levels],n[7+levels],N,
+	 beta_out,RR);
+  for (int l=1; l<=levels; ++l) printf(" %11.6g",n[5+l]);
+  printf("\n");
+}
+
+int main(int argc,char *argv[])
+{
+  read_parameters(argc,argv);
+
+  Hierarchical_ODE model(options.levels);
+  std::vector<double> y(model.size());
+  model.set_all_S(y.data());
+
+  ODE_integrator ode(model.size(),
+		     [&model](double,const double *y,double *dydt) {model.rhs(y,dydt);},
+		     options.rtol,options.rtol*1e-3);
+
+  SEEIIRstate state;
+  printf("# Columns %d to %d: infections transmitted at levels 1 to %d\n",16,
+	 15+options.levels,options.levels);
+  std::cout << state.header() << '\n';
+
+  // imported infections go before rate changes at the same time, as in seeiir_h
+  auto ii=options.imported_infections.begin();
+  auto ir=options.rates_vs_time.begin();
+  const double inf=std::numeric_limits<double>::infinity();
+  double t=0,imported=0,recovered=0,Eacc0=0,I0=0,t0=0;
+  std::vector<double> n(8+options.levels);
+  for (int k=0; k<=options.steps; ++k) {
+    // integrate up to k, stopping at the events
+    for (;;) {
+      double tii= ii==options.imported_infections.end() ? inf : ii->time;
+      double tir= ir==options.rates_vs_time.end() ? inf : ir->time;
+      double te=std::min(tii,tir);
+      ode.integrate(t,std::min(te,(double) k),y.data());
+      if (te>k) break;
+      if (tii==te) {
+	if (ii->I<imported)
+	  throw std::runtime_error("Imported infections must be monotonically increasing");
+	model.add_imported(y.data(),ii->I-imported);
+	imported=ii->I;
+	if (ii->R>recovered) model.force_recover(y.data(),ii->R-recovered);
+	else model.unrecover(y.data(),recovered-ii->R);
+	recovered=ii->R;
+	++ii;
+      } else {
+	model.rates=*ir;
+	++ir;
+      }
+    }
+    model.totals(y.data(),n.data());
+    double Eacc=0;
+    for (int l=1; l<=options.levels; ++l) Eacc+=n[5+l];
+    double tinf=1./model.rates.gamma1+1./model.rates.gamma2;
+    double RR=tinf*(Eacc-Eacc0)/((t-t0)*I0);
+    print(state,t,n.data(),options.levels,imported,model.N,model.rates.beta[2],RR);
+    Eacc0=Eacc;
+    I0=n[3]+n[4];
+    t0=t;
+  }
+  printf("# %ld evaluations of the rates\n",ode.evaluations());
+}
@@ -166,7 +166,7 @@ void SEIRPopulation::set_all_S()
   for (int fn=0; fn<families.size(); ++fn) {
     Family* f=families[fn];
     f->S=f->M;
-    f->E1=f->E2=f->I1=f->I2=0;
+    f->E1=f->E2=f->I1=f->I2=f->R=0;
     f->infected_families_in_list=-1;
     f->first_susceptible_in_list=listS.size();
     for (int iS=0; iS<f->S; iS++)
@@ -248,7 +248,6 @@ void SEIRPopulation::local_infection(int fn) {
   families[fn]->E1++;
   gstate.E1++;
   gstate.Eacc++;
-  gstate.inf_close++;
 
   listE1.push_back(fn);
   erase_susceptible(fn);
@@ -0,0 +1,229 @@
+/*
+ * seeiir_m.cc
+ *
+ * Continuous time (Gillespie) Monte Carlo simulation of mean-field
+ * (fully-connected) stochastic SEEIIR, with the rates of seeiir_i3
+ * without families (a susceptible is infected at rate
+ * beta*(I1+I2)/(N-1), and the exposed and infected stages last on
+ * average 1/(2 sigma) and 1/(2 gamma) each).  Runs are done
+ * ensemble_lanes at a time in lockstep (see ensemble.hh), which is
+ * several times faster than one after another.
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <vector>
+#include <math.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "qdrandom.hh"
+#include "ensemble.hh"
+#include "popstate.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// simulation options and parameters
+
+struct opt {
+  int    last_arg_read;
+
+  char   *ifile;
+  int    Nruns;
+  int    N;
+  int    steps;
+  long   seed;
+  char   *avfile;    // file to save averages for later merging (optional)
+
+  double beta,sigma,gamma;
+  double S0,I0;      // initial susceptible / infected fraction
+
+  opt() : last_arg_read(0), avfile(0) {}
+
+} options;
+
+static int nargs=5;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Read parameters from command-line and file
+
+#include "read_arg.hh"
+
+void show_usage(char *prog)
+{
+  std::cerr << "usage: " << prog << " parameterfile seed N steps Nruns [avfile]\n\n"
+	    << "If avfile is given, the averages are also saved there (in binary form) so that\n"
+	    << "they can later be combined with those of other runs using merge_av\n";
+  exit(1);
+}
+
+char *readbuf(FILE *f)
+{
+  static char buf[1000];
+  char *s;
+  do
+    s=fgets(buf,1000,f);
+  while (*buf=='#');
+  return buf;
+}
+
+void read_parameters(int argc,char *argv[])
+{
+  if (argc!=nargs+1 && argc!=nargs+2) show_usage(argv[0]);
+
+  read_arg(argv,options.ifile);
+  read_arg(argv,options.seed);
+  read_arg(argv,options.N);
+  read_arg(argv,options.steps);
+  read_arg(argv,options.Nruns);
+  if (argc==nargs+2) read_arg(argv,options.avfile);
+
+  FILE *f=fopen(options.ifile,"r");
+  if (f==0) throw std::runtime_error(strerror(errno));
+  char *buf=readbuf(f);
+  sscanf(buf,"%lg %lg %lg",&options.beta,&options.sigma,&options.gamma);
+  buf=readbuf(f);
+  sscanf(buf,"%lg %lg",&options.S0,&options.I0);
+  fclose(f);
+
+  printf("##### Parameters\n");
+  printf("# beta = %g\n",options.beta);
+  printf("# sigma = %g\n",options.sigma);
+  printf("# gamma = %g\n",options.gamma);
+  printf("# S0 = %g\n",options.S0);
+  printf("# I0 = %g\n",options.I0);
+  printf("# N = %d\n",options.N);
+  printf("# Nruns = %d\n",options.Nruns);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Simulation
+//
+// The lanes record their samples (at integer times up to
+// options.steps, with the state before the first event after the
+// sampling time, as Gillespie_sampler does), which are pushed run by
+// run when the whole block is done, because SEEIIRstate needs
+// consecutive samples of the same run.
+
+void run_lanes(SEEIIRstate *state,int nruns)
+{
+  const int L=ensemble_lanes;
+  Lane_random<L> lran;
+  std::vector<SEEIIRistate> samples[L];
+
+  double r_inf=options.beta/(options.N-1);
+  double r_E=2*options.sigma;
+  double r_I=2*options.gamma;
+
+  for (int first=0; first<nruns; first+=L) {
+    int    S[L],E1[L],E2[L],I1[L],I2[L],R[L],Eacc[L],Icomm[L],ev[L],live[L];
+    double time[L],tnew[L],tsamp[L],u1[L],u2[L];
+    int    nlive=0;
+    for (int l=0; l<L; ++l) {
+      S[l]=options.S0*options.N;
+      I1[l]=options.I0*options.N;
+      E1[l]=E2[l]=I2[l]=0;
+      R[l]=options.N-S[l]-I1[l];
+      Eacc[l]=Icomm[l]=0;
+      time[l]=0;
+      tsamp[l]=0;
+      live[l]= first+l<nruns;
+      nlive+=live[l];
+      samples[l].clear();
+    }
+
+    while (nlive>0) {
+      lran.uniform_pos(u1);
+      lran.uniform(u2);
+      for (int l=0; l<L; ++l) {
+	double c1=r_inf*S[l]*(I1[l]+I2[l]);   // cumulative rates of the 5 transitions
+	double c2=c1+r_E*E1[l];
+	double c3=c2+r_E*E2[l];
+	double c4=c3+r_I*I1[l];
+	double tot=c4+r_I*I2[l];
+	tnew[l]= tot>0 ? time[l]-lane_log(u1[l])/tot : HUGE_VAL;
+	double x=u2[l]*tot;
+	ev[l]=(x>=c1)+(x>=c2)+(x>=c3)+(x>=c4);
+      }
+
+      for (int l=0; l<L; ++l) {
+	if (!live[l] || tnew[l]<=tsamp[l]) continue;
+	SEEIIRistate s;
+	s.N=options.N;
+	s.S=S[l]; s.E1=E1[l]; s.E2=E2[l]; s.I1=I1[l]; s.I2=I2[l]; s.R=R[l];
+	s.inf_imported=options.I0*options.N;
+	s.inf_community=Icomm[l];
+	s.Eacc=Eacc[l];
+	s.beta_out=options.beta;
+	s.tinf=1./options.gamma;
+	for (; tsamp[l]<tnew[l] && tsamp[l]<=options.steps; tsamp[l]+=1.)
+	  samples[l].push_back(s);
+	if (tnew[l]>=options.steps) {live[l]=0; --nlive;}
+      }
+
+      for (int l=0; l<L; ++l) {
+	int k=ev[l], on=live[l];
+	int se=on & (k==0), ee=on & (k==1), ei=on & (k==2), ii=on & (k==3), ir=on & (k==4);
+	S[l]-=se;
+	E1[l]+=se-ee;
+	E2[l]+=ee-ei;
+	I1[l]+=ei-ii;
+	I2[l]+=ii-ir;
+	R[l]+=ir;
+	Eacc[l]+=se;
+	Icomm[l]+=ei;
+	time[l]=tnew[l];
+      }
+    }
+
+    for (int l=0; l<L && first+l<nruns; ++l)
+      for (int n=0; n<(int) samples[l].size(); ++n)
+	state->push(n,samples[l][n]);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// main
+
+int main(int argc,char *argv[])
+{
+  read_parameters(argc,argv);
+  Random_number_generator RNG(options.seed);
+
+  SEEIIRstate *state;
+  state = options.Nruns>1 || options.avfile ?
+          new SEEIIRstate_av : new SEEIIRstate;
+  std::cout << state->header() << '\n';
+  if (options.Nruns==1 && !options.avfile) state->set_async_output();
+
+  run_lanes(state,options.Nruns);
+
+  if (options.Nruns>1 || options.avfile)
+    std::cout << *state;
+  if (options.avfile) {
+    std::ofstream avf(options.avfile,std::ios::binary);
+    static_cast<SEEIIRstate_av*>(state)->save(avf);
+  }
+  delete state;
+}
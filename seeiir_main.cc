@@ -71,6 +71,7 @@
 // #undef SEEIIR_IMPLEMENTATION_3
 
 #include <iostream>
+#include <fstream>
 #include <cstdio>
 #include <list>
 #include <queue>
@@ -83,6 +84,7 @@
 
 #include "qdrandom.hh"
 #include "popstate.hh"
+#include "trajfile.hh"
 #include "bsearch.hh"
 
 
@@ -97,6 +99,8 @@ struct opt {
   int    Nruns;
   int    steps;
   long   seed;
+  char   *avfile;           // file to save averages for later merging (optional)
+  char   *trajfile;         // binary trajectory or run archive (optional)
 
   int         Nfamilies;    // Total number of families
   int         Mmax;         // Maximum family size
@@ -116,7 +120,7 @@ struct opt {
   // Epidemic parameters
   double beta_in,beta_out,sigma,gamma;
 
-  opt() : last_arg_read(0) {}
+  opt() : last_arg_read(0), avfile(0), trajfile(0) {}
   ~opt() {delete[] PM;}
 
 } options;
@@ -132,8 +136,12 @@ static int nargs=4;
 
 void show_usage(char *prog)
 {
-  std::cerr << "usage: " << prog << " parameterfile seed steps Nruns\n\n"
-    ;
+  std::cerr << "usage: " << prog << " parameterfile seed steps Nruns [avfile [trajfile]]\n\n"
+	    << "If avfile is given, the averages are also saved there (in binary form) so that\n"
+	    << "they can later be combined with those of other runs using merge_av\n"
+	    << "If trajfile is given, for a single run (Nruns=1, use - as avfile) the trajectory\n"
+	    << "is written there in binary form instead of to standard output, otherwise the\n"
+	    << "counts of every run are archived there (convert it to text with traj2txt)\n";
   exit(1);
 }
 
@@ -152,11 +160,16 @@ void read_beta_vs_time();
 
 void read_parameters(int argc,char *argv[])
 {
-  if (argc!=nargs+1) show_usage(argv[0]);
+  if (argc<nargs+1 || argc>nargs+3) show_usage(argv[0]);
   read_arg(argv,options.ifile);
   read_arg(argv,options.seed);
   read_arg(argv,options.steps);
   read_arg(argv,options.Nruns);
+  if (argc>=nargs+2) {
+    read_arg(argv,options.avfile);
+    if (strcmp(options.avfile,"-")==0) options.avfile=0;
+  }
+  if (argc==nargs+3) read_arg(argv,options.trajfile);
 
   FILE *f=fopen(options.ifile,"r");
   if (f==0) throw std::runtime_error(strerror(errno));
@@ -312,9 +325,23 @@ int main(int argc,char *argv[])
 
   // Prepare global state (for output) and population
   SEEIIRstate *state;
-  state = options.Nruns>1 ?
+  state = options.Nruns>1 || options.avfile ?
           new SEEIIRstate_av : new SEEIIRstate;
-  std::cout << state->header() << '\n';
+  Trajectory_writer *traj=0;
+  Run_archive       *archive=0;
+  if (options.trajfile && (options.Nruns>1 || options.avfile)) {
+    archive=new Run_archive(options.trajfile,1.);
+    archive->add_run_info(argc,argv,options.seed,options.ifile);
+    static_cast<SEEIIRstate_av*>(state)->set_archive(archive);
+  }
+  if (options.trajfile && !archive) {
+    traj=new Trajectory_writer(options.trajfile);
+    traj->add_run_info(argc,argv,options.seed,options.ifile);
+    state->set_trajectory(traj);
+  } else {
+    std::cout << state->header() << '\n';
+    if (options.Nruns==1 && !options.avfile) state->set_async_output();
+  }
 
   SEIRPopulation pop(options.Nfamilies,options.beta_in,options.beta_out,
 		     options.sigma,options.gamma,options.Mmax,options.PM);
@@ -325,11 +352,18 @@ int main(int argc,char *argv[])
   for (int n=0; n<options.Nruns; ++n) {
     // std::cout << "# N = " << pop.gstate.N << '\n';
     run(pop,state);
+    if (archive) archive->end_run();
     pop.set_all_S();
   }
 
-  if (options.Nruns>1)
+  if (options.Nruns>1 || options.avfile)
     std::cout << *state;
+  if (options.avfile) {
+    std::ofstream avf(options.avfile,std::ios::binary);
+    static_cast<SEEIIRstate_av*>(state)->save(avf);
+  }
 
+  delete traj;
+  delete archive;
   delete state;
 }
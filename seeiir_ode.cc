@@ -0,0 +1,419 @@
+/*
+ * seeiir_ode.cc
+ *
+ * Deterministic (infinite population) limit of the SEEIIR model with
+ * families of seeiir_i3: the household master equation of Ball and
+ * House.  The unknowns are the expected number of families of each
+ * size M and composition (S,E1,E2,I1,I2,R), which obey linear rate
+ * equations except for the infection from outside the family, which
+ * depends on the total number of infected.  The result is the average
+ * of the stochastic model when the number of families is large (the
+ * family sizes are not large, so the fluctuations within a family are
+ * kept exactly).
+ *
+ * Command-line arguments are the parameter file (the same as for
+ * seeiir_i3, see seeiir_par.dat) and the maximum time; optionally, the
+ * relative tolerance of the integration.  The imported infections and
+ * the changes of beta_out are applied as in seeiir_i3 (integrating up
+ * to their times).  Output is as that of a single run of seeiir_i3,
+ * but with expected (real) numbers.  As in seeiir_i3, infections are
+ * classified when the infected become I1: close contact if another
+ * member of the family is then infected or recovered, community
+ * otherwise.
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <queue>
+#include <vector>
+#include <map>
+#include <array>
+#include <limits>
+#include <stdexcept>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "popstate.hh"
+#include "odeint.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// options and parameters
+
+struct opt {
+  int    last_arg_read;
+
+  char   *ifile;
+  int    steps;
+  double rtol;
+
+  int         Nfamilies;    // Total number of families
+  int         Mmax;         // Maximum family size
+  double      *PM;          // Family size distribution
+  std::string eifile;       // File to read imported infected cases
+  std::string betafile;     // File to read beta_out vs time
+
+  // imported infections
+  struct ei {double time; int I;} ;
+  typedef std::queue<ei>                imported_infections_t;
+  imported_infections_t                 imported_infections;
+  // beta vs time
+  struct eb {double time; double beta;} ;
+  typedef std::queue<eb>                beta_vs_time_t;
+  beta_vs_time_t                        beta_vs_time;
+
+  // Epidemic parameters
+  double beta_in,beta_out,sigma,gamma;
+
+  opt() : last_arg_read(0), rtol(1e-8), PM(0) {}
+  ~opt() {delete[] PM;}
+
+} options;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Read parameters from command-line and file
+
+#include "read_arg.hh"
+
+static int nargs=2;
+
+void show_usage(char *prog)
+{
+  std::cerr << "usage: " << prog << " parameterfile steps [rtol]\n\n"
+	    << "rtol is the relative tolerance of the integration (default 1e-8)\n";
+  exit(1);
+}
+
+char *readbuf(FILE *f)
+{
+  static char buf[1000];
+  char *s;
+  do
+    s=fgets(buf,1000,f);
+  while (*buf=='#');
+  return buf;
+}
+
+void read_imported_infections()
+{
+  FILE *f=fopen(options.eifile.c_str(),"r");
+  if (f==0) throw std::runtime_error(strerror(errno));
+
+  opt::ei ei;
+  while (ungetc(fgetc(f),f)!=EOF) {
+    char *buf=readbuf(f);
+    if (sscanf(buf,"%lg %d",&ei.time,&ei.I)!=2) {
+      std::cerr  << "couldn't read record: " << buf << "\n";
+      throw std::runtime_error(strerror(errno));}
+    options.imported_infections.push(ei);
+  }
+
+  fclose(f);
+}
+
+void read_beta_vs_time()
+{
+  FILE *f=fopen(options.betafile.c_str(),"r");
+  if (f==0) throw std::runtime_error(strerror(errno));
+
+  opt::eb bi;
+  while (ungetc(fgetc(f),f)!=EOF) {
+    char *buf=readbuf(f);
+    if (sscanf(buf,"%lg %lg",&bi.time,&bi.beta)!=2) {
+      std::cerr  << "couldn't read record: " << buf << "\n";
+      throw std::runtime_error(strerror(errno));}
+    options.beta_vs_time.push(bi);
+  }
+  fclose(f);
+}
+
+void read_parameters(int argc,char *argv[])
+{
+  if (argc!=nargs+1 && argc!=nargs+2) show_usage(argv[0]);
+  read_arg(argv,options.ifile);
+  read_arg(argv,options.steps);
+  if (argc==nargs+2) read_arg(argv,options.rtol);
+
+  FILE *f=fopen(options.ifile,"r");
+  if (f==0) throw std::runtime_error(strerror(errno));
+  char *buf=readbuf(f);
+  sscanf(buf,"%d %d",&options.Nfamilies,&options.Mmax);
+  options.PM=new double[options.Mmax+1];
+  options.PM[0]=0;
+  for (int M=1; M<=options.Mmax; ++M) {
+    buf=readbuf(f);
+    sscanf(buf,"%lg",options.PM+M);
+  }
+  buf=readbuf(f);
+  sscanf(buf,"%lg %lg %lg %lg",&options.beta_in,&options.beta_out,&options.sigma,&options.gamma);
+  buf=readbuf(f);
+  options.eifile=buf;
+  options.eifile.erase(options.eifile.end()-1);   // remove trailing newline
+  read_imported_infections();
+  if (options.beta_out<0) {                      // beta_out comes from beta vs time file
+    buf=readbuf(f);
+    options.betafile=buf;
+    options.betafile.erase(options.betafile.end()-1);   // remove trailing newline
+    read_beta_vs_time();
+  }
+  fclose(f);
+
+  printf("##### Parameters\n");
+  printf("# beta_in = %g\n",options.beta_in);
+  printf("# beta_out = %g\n",options.beta_out);
+  printf("# sigma = %g\n",options.sigma);
+  printf("# gamma = %g\n",options.gamma);
+  printf("# Nfamilies = %d\n",options.Nfamilies);
+  printf("# Mmax      = %d\n",options.Mmax);
+  for (int i=1; i<=options.Mmax; ++i)
+    printf("# P[%d]    = %g\n",i,options.PM[i]);
+  printf("# Imported infections:\n");
+  printf("# Time   Cases\n");
+  opt::imported_infections_t ii=options.imported_infections;
+  while (!ii.empty()) {
+    printf("# %g %d\n",ii.front().time,ii.front().I);
+    ii.pop();
+  }
+  if (options.beta_out<0) {
+    printf("#\n# Beta_out:\n");
+    printf("# Time   Beta_out\n");
+    opt::beta_vs_time_t ib=options.beta_vs_time;
+    while (!ib.empty()) {
+      printf("# %g %g\n",ib.front().time,ib.front().beta);
+      ib.pop();
+    }
+  }
+  printf("#\n# Deterministic (household master equation), rtol = %g\n",options.rtol);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Household_ODE
+//
+// y holds the expected number of families of each composition, then
+// the cumulative numbers of close contact and community infections
+// (classified at E2->I1, see rhs()) and of all infections (S->E1).
+
+class Household_ODE {
+public:
+  Household_ODE(int Nfamilies,int Mmax,const double *PM,double beta_in,double sigma,
+		double gamma);
+
+  enum {S,E1,E2,I1,I2,R,nstates};
+  typedef std::array<int,nstates> comp_t;
+
+  int    size() const {return comp.size()+3;}
+  void   set_all_S(double *y) const;
+  void   add_imported(double *y,double I) const;
+  void   rhs(const double *y,double *dydt) const;
+  void   totals(const double *y,double *n) const;  // individuals in each state
+
+  double N;                // population (expected)
+  double beta_out;
+
+private:
+  double Nfamilies;
+  double beta_in,sigma,gamma;
+  int    iclose,icomm,iinf;
+
+  std::vector<comp_t>  comp;
+  std::map<comp_t,int> index;       // of each composition in comp
+  std::vector<int>     first;       // first composition of each size
+  std::vector<std::array<int,5>> to;   // composition after each of the 5 transitions
+  std::vector<double>  nfam0;       // families of each size
+} ;
+
+Household_ODE::Household_ODE(int Nfamilies,int Mmax,const double *PM,double beta_in,
+			     double sigma,double gamma) :
+  beta_out(0),
+  Nfamilies(Nfamilies),
+  beta_in(beta_in),
+  sigma(sigma),
+  gamma(gamma),
+  first(Mmax+2),
+  nfam0(Mmax+1,0.)
+{
+  double Ptot=0;
+  for (int M=1; M<=Mmax; ++M) Ptot+=PM[M];
+  N=0;
+  for (int M=1; M<=Mmax; ++M) {
+    nfam0[M]=Nfamilies*PM[M]/Ptot;
+    N+=M*nfam0[M];
+  }
+
+  // all the compositions of each size
+  for (int M=0; M<=Mmax; ++M) {
+    first[M]=comp.size();
+    comp_t c;
+    for (c[S]=M; c[S]>=0; --c[S])
+      for (c[E1]=0; c[S]+c[E1]<=M; ++c[E1])
+	for (c[E2]=0; c[S]+c[E1]+c[E2]<=M; ++c[E2])
+	  for (c[I1]=0; c[S]+c[E1]+c[E2]+c[I1]<=M; ++c[I1])
+	    for (c[I2]=0; c[S]+c[E1]+c[E2]+c[I1]+c[I2]<=M; ++c[I2]) {
+	      c[R]=M-c[S]-c[E1]-c[E2]-c[I1]-c[I2];
+	      index[c]=comp.size();
+	      comp.push_back(c);
+	    }
+  }
+  first[Mmax+1]=comp.size();
+  iclose=comp.size();
+  icomm=iclose+1;
+  iinf=iclose+2;
+
+  to.resize(comp.size());
+  for (int k=0; k<(int) comp.size(); ++k)
+    for (int tr=0; tr<5; ++tr) {          // tr moves one individual from state tr to tr+1
+      comp_t c=comp[k];
+      if (c[tr]==0) {to[k][tr]=-1; continue;}
+      c[tr]--; c[tr+1]++;
+      to[k][tr]=index[c];
+    }
+}
+
+void Household_ODE::set_all_S(double *y) const
+{
+  for (int k=0; k<size(); ++k) y[k]=0;
+  for (int M=1; M<(int) first.size()-1; ++M)
+    y[first[M]]=nfam0[M];             // the first composition of each size is all S
+}
+
+// Infect (to I1) I randomly chosen susceptibles, in proportion to the
+// susceptibles of each composition
+void Household_ODE::add_imported(double *y,double I) const
+{
+  double Stot=0;
+  for (int k=0; k<(int) comp.size(); ++k) Stot+=comp[k][S]*y[k];
+  if (I>Stot) throw std::runtime_error("Too many imported infections");
+  std::vector<double> dy(comp.size(),0.);
+  for (int k=0; k<(int) comp.size(); ++k) {
+    if (comp[k][S]==0) continue;
+    comp_t c=comp[k];
+    c[S]--; c[I1]++;
+    double moved=I*comp[k][S]*y[k]/Stot;
+    dy[k]-=moved;
+    dy[index.at(c)]+=moved;
+  }
+  for (int k=0; k<(int) comp.size(); ++k) y[k]+=dy[k];
+}
+
+void Household_ODE::rhs(const double *y,double *dydt) const
+{
+  double Itot=0;
+  for (int k=0; k<(int) comp.size(); ++k) Itot+=(comp[k][I1]+comp[k][I2])*y[k];
+  double lambda_out=beta_out*Itot/(N-1);
+
+  for (int k=0; k<size(); ++k) dydt[k]=0;
+  for (int k=0; k<(int) comp.size(); ++k) {
+    if (y[k]==0) continue;
+    const comp_t &c=comp[k];
+    double r[5]={(beta_in*(c[I1]+c[I2])+lambda_out)*c[S]*y[k],2*sigma*c[E1]*y[k],
+		 2*sigma*c[E2]*y[k],2*gamma*c[I1]*y[k],2*gamma*c[I2]*y[k]};
+    for (int tr=0; tr<5; ++tr) {
+      if (r[tr]==0) continue;
+      dydt[k]-=r[tr];
+      dydt[to[k][tr]]+=r[tr];
+    }
+    // as in seeiir_i3 (E2I1()), close contact if others in the family
+    // are (or have been) infected
+    if (c[I1]+c[I2]+c[R]>0) dydt[iclose]+=r[E2];
+    else dydt[icomm]+=r[E2];
+    dydt[iinf]+=r[S];
+  }
+}
+
+// n[0..5]: S,E1,E2,I1,I2,R; n[6],n[7]: close contact and community
+// infections; n[8]: all infections
+void Household_ODE::totals(const double *y,double *n) const
+{
+  for (int s=0; s<nstates; ++s) n[s]=0;
+  for (int k=0; k<(int) comp.size(); ++k)
+    for (int s=0; s<nstates; ++s) n[s]+=comp[k][s]*y[k];
+  n[6]=y[iclose];
+  n[7]=y[icomm];
+  n[8]=y[iinf];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// main
+
+void print(SEEIIRstate &state,double time,const double *n,double imported,double N,
+	   double beta_out,double RR)
+{
+  state.time=time;
+  state.S[0]=n[0];
+  state.E[0]=n[1];
+  state.E[1]=n[2];
+  state.I[0]=n[3];
+  state.I[1]=n[4];
+  state.R[0]=n[5];
+  state.print(std::cout,true);
+  printf("%11.6g %11.6g %11.6g %11.6g %11.6g %11.6g\n",imported,n[6],n[7],N,beta_out,RR);
+}
+
+int main(int argc,char *argv[])
+{
+  read_parameters(argc,argv);
+
+  Household_ODE model(options.Nfamilies,options.Mmax,options.PM,options.beta_in,
+		      options.sigma,options.gamma);
+  std::vector<double> y(model.size());
+  model.set_all_S(y.data());
+  model.beta_out= options.beta_out<0 ? 0 : options.beta_out;
+
+  ODE_integrator ode(model.size(),
+		     [&model](double,const double *y,double *dydt) {model.rhs(y,dydt);},
+		     options.rtol,options.rtol*1e-3);
+
+  SEEIIRstate state;
+  std::cout << state.header() << '\n';
+
+  opt::imported_infections_t ii=options.imported_infections;
+  opt::beta_vs_time_t        bt=options.beta_vs_time;
+  const double inf=std::numeric_limits<double>::infinity();
+  double t=0,imported=0,Eacc0=0,I0=0,t0=0;
+  double n[9];
+  for (int k=0; k<=options.steps; ++k) {
+    // integrate up to k, stopping at the events
+    for (;;) {
+      double te=std::min(ii.empty() ? inf : ii.front().time,bt.empty() ? inf : bt.front().time);
+      ode.integrate(t,std::min(te,(double) k),y.data());
+      if (te>k) break;
+      if (!ii.empty() && ii.front().time==te) {
+	model.add_imported(y.data(),ii.front().I-imported);
+	imported=ii.front().I;
+	ii.pop();
+      } else {
+	model.beta_out=bt.front().beta;
+	bt.pop();
+      }
+    }
+    model.totals(y.data(),n);
+    double Eacc=n[8];
+    double RR=(Eacc-Eacc0)/((t-t0)*I0*options.gamma);
+    print(state,t,n,imported,model.N,model.beta_out,RR);
+    Eacc0=Eacc;
+    I0=n[3]+n[4];
+    t0=t;
+  }
+  printf("# %ld evaluations of the rates\n",ode.evaluations());
+}
@@ -25,6 +25,7 @@
 #include <iostream>
 #include <cstdio>
 #include <math.h>
+#include <algorithm>
 
 #include <stdlib.h>
 #include <string.h>
@@ -41,10 +42,11 @@ struct opt {
   int    last_arg_read;
   
   char   *ifile;
-  bool   gillespie;
+  char   method;     // G, M or B
   int    N;
   int    steps;
   long   seed;
+  double dt;         // time step of the binomial chain
 
   double R0;
   double inf_time;   // infection time (days)
@@ -53,7 +55,7 @@ struct opt {
   double beta;
   double gamma;
 
-  opt() : last_arg_read(0) {}
+  opt() : last_arg_read(0), dt(1.) {}
 
 } options;
 
@@ -66,8 +68,9 @@ struct opt {
 
 void show_usage(char *prog)
 {
-  std::cerr << "usage: " << prog << " [G or M] parameterfile seed N steps\n\n"
-	    << "The first argument is G for Gillespie algorithm or M for discrete-time Monte Carlo\n";
+  std::cerr << "usage: " << prog << " [G, M or B] parameterfile seed N steps [dt]\n\n"
+	    << "The first argument is G for Gillespie algorithm, M for discrete-time Monte Carlo\n"
+	    << "or B for the binomial chain with time step dt (default 1, must be 1/integer)\n";
 
   exit(1);
 }
@@ -84,15 +87,19 @@ char *readbuf(FILE *f)
 
 void read_parameters(int argc,char *argv[])
 {
-  if (argc!=nargs+1) show_usage(argv[0]);
+  if (argc!=nargs+1 && argc!=nargs+2) show_usage(argv[0]);
 
   char *A;
   read_arg(argv,A);
-  options.gillespie= (*A=='G');
+  options.method=*A;
   read_arg(argv,options.ifile);
   read_arg(argv,options.seed);
   read_arg(argv,options.N);
   read_arg(argv,options.steps);
+  if (argc==nargs+2) read_arg(argv,options.dt);
+  if (options.dt<=0 || options.dt>1 ||
+      fabs(1./options.dt-lround(1./options.dt))>1e-9/options.dt)
+    throw std::runtime_error("dt must be 1/n for integer n (samples are at whole days)");
 
   FILE *f=fopen(options.ifile,"r");
   if (f==0) throw std::runtime_error(strerror(errno));
@@ -147,6 +154,44 @@ void run_MC()
 }
 
 
+/*
+ * Version with binomial chain: in each step of length dt, each
+ * susceptible is infected with probability 1-exp(-beta I dt/(N-1))
+ * and each infected recovers with probability 1-exp(-gamma dt), so
+ * the numbers of infections and recoveries are binomial.  The cost of
+ * a step does not depend on N.  This is the Gillespie process when dt
+ * goes to 0 (the rates are kept fixed during a step), so comparing
+ * with G for decreasing dt checks the step.
+ *
+ */
+
+void run_binomial()
+{
+  Binomial_distribution bin;
+
+  long S=options.S0*options.N;
+  long I=options.I0*options.N;
+  long R=options.N-S-I;
+  int  nsub=lround(1./options.dt);
+  double dt=1./nsub;
+  double prec=-expm1(-options.gamma*dt);
+
+  printf("#\n#  Using binomial chain with time step %g *****\n",dt);
+  printf("#\n#  time    S     I    R\n");
+  printf(" 0  %g %g %g\n",(double) S/options.N,(double) I/options.N,(double) R/options.N);
+
+  for (int t=1; t<=options.steps; ++t) {
+    for (int k=0; k<nsub; ++k) {
+      long nI=bin(S,-expm1(-options.beta*I*dt/(options.N-1)));
+      long nR=bin(I,prec);
+      S-=nI;
+      I+=nI-nR;
+      R+=nR;
+    }
+    printf(" %d  %g %g %g\n",t,(double) S/options.N,(double) I/options.N,(double) R/options.N);
+  }
+}
+
 /*
  * Version with Gillespie (kinetic MC) algorithm
  *
@@ -207,8 +252,11 @@ int main(int argc,char *argv[])
   read_parameters(argc,argv);
   Random_number_generator RNG(options.seed);
 
-  if (options.gillespie) run_gillespie();
-  else run_MC();
+  switch (options.method) {
+  case 'G': run_gillespie(); break;
+  case 'B': run_binomial(); break;
+  default:  run_MC();
+  }
 }
 
    
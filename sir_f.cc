@@ -2,7 +2,10 @@
  * sir_f.cc
  *
  * Stochastic SIR with population separated in families, simulated in
- * continuous time (Gillespie algorithm).
+ * continuous time (Gillespie algorithm).  Compiled with
+ * BINOMIAL_CHAIN defined (program sir_fb), it is instead simulated in
+ * discrete time by a binomial chain on the family compositions (see
+ * class Family_classes).
  *
  * This file is part of COVIDm.
  *
@@ -22,14 +25,17 @@
  */
 
 #include <iostream>
+#include <fstream>
 #include <cstdio>
 #include <math.h>
+#include <algorithm>
 
 #include <stdlib.h>
 #include <string.h>
 
 #include "qdrandom.hh"
 #include "popstate.hh"
+#include "trajfile.hh"
 #include "bsearch.hh"
 #include "gillespie_sampler.hh"
 
@@ -45,6 +51,9 @@ struct opt {
   int    Nruns;
   int    steps;
   long   seed;
+  char   *avfile;   // file to save averages for later merging (optional)
+  char   *trajfile; // binary trajectory or run archive (optional)
+  double dt;        // time step (binomial chain)
 
   int    Nfamilies; // Total number of families
   int    Mmax;
@@ -52,7 +61,7 @@ struct opt {
   double beta_in,beta_out,gamma;
   double I0;      // initial infected fraction  
 
-  opt() : last_arg_read(0) {}
+  opt() : last_arg_read(0), avfile(0), trajfile(0), dt(1.) {}
   ~opt() {delete[] PM;}
 
 } options;
@@ -64,12 +73,25 @@ struct opt {
 
 #include "read_arg.hh"
 
+#ifdef BINOMIAL_CHAIN
+static int nargs=5;
+#else
 static int nargs=4;
+#endif
 
 void show_usage(char *prog)
 {
-  std::cerr << "usage: " << prog << " parameterfile seed steps Nruns\n\n"
-    ;
+#ifdef BINOMIAL_CHAIN
+  std::cerr << "usage: " << prog << " parameterfile seed steps Nruns dt [avfile [trajfile]]\n\n"
+	    << "dt is the time step of the binomial chain (1/integer)\n"
+#else
+  std::cerr << "usage: " << prog << " parameterfile seed steps Nruns [avfile [trajfile]]\n\n"
+#endif
+	    << "If avfile is given, the averages are also saved there (in binary form) so that\n"
+	    << "they can later be combined with those of other runs using merge_av\n"
+	    << "If trajfile is given, for a single run (Nruns=1, use - as avfile) the trajectory\n"
+	    << "is written there in binary form instead of to standard output, otherwise the\n"
+	    << "counts of every run are archived there (convert it to text with traj2txt)\n";
   exit(1);
 }
 
@@ -85,11 +107,23 @@ char *readbuf(FILE *f)
 
 void read_parameters(int argc,char *argv[])
 {
-  if (argc!=nargs+1) show_usage(argv[0]);
+  if (argc<nargs+1 || argc>nargs+3) show_usage(argv[0]);
   read_arg(argv,options.ifile);
   read_arg(argv,options.seed);
   read_arg(argv,options.steps);
   read_arg(argv,options.Nruns);
+#ifdef BINOMIAL_CHAIN
+  read_arg(argv,options.dt);
+  if (options.dt<=0 || options.dt>1 ||
+      fabs(1./options.dt-lround(1./options.dt))>1e-9/options.dt)
+    throw std::runtime_error("dt must be 1/n for integer n (samples are at whole days)");
+  options.dt=1./lround(1./options.dt);
+#endif
+  if (argc>=nargs+2) {
+    read_arg(argv,options.avfile);
+    if (strcmp(options.avfile,"-")==0) options.avfile=0;
+  }
+  if (argc==nargs+3) read_arg(argv,options.trajfile);
 
   FILE *f=fopen(options.ifile,"r");
   if (f==0) throw std::runtime_error(strerror(errno));
@@ -117,6 +151,9 @@ void read_parameters(int argc,char *argv[])
     printf("# P[%d]    = %g\n",i,options.PM[i]);
   printf("# I0 = %g\n",options.I0);
   printf("# Nruns = %d\n",options.Nruns);
+#ifdef BINOMIAL_CHAIN
+  printf("# dt = %g (binomial chain)\n",options.dt);
+#endif
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -294,6 +331,147 @@ void run(Population &pop,SIRstate *state)
   }
 }
 
+/*
+ * Family_classes
+ *
+ * For the binomial chain, families are only counted by composition
+ * (size M and number S, I in each state).  In a step of length dt,
+ * each susceptible of a family with I infected is infected with
+ * probability 1-exp(-(beta_out I_total/(N-1) + beta_in I) dt), and
+ * each infected recovers with probability 1-exp(-gamma dt), so that
+ * the families of one composition go to the others with multinomial
+ * counts.  The cost of a step depends on Mmax only, not on the number
+ * of families.  This is the Gillespie process of sir_f when dt goes
+ * to 0 (the rates are kept fixed during a step), so comparing the
+ * averages with those of sir_f for decreasing dt checks the step.
+ *
+ */
+class Family_classes {
+public:
+  Family_classes(int NFamilies,int Mmax,double PM[]);
+
+  void set_initial(double I0);  // each individual infected with probability I0
+  void step(double dt,double beta_in,double beta_out,double gamma);
+
+  Gstate gstate;
+
+private:
+  int                       Mmax;
+  std::vector<int>          first;       // compositions of size M start at first[M]
+  std::vector<unsigned int> size_count;  // families of each size
+  std::vector<unsigned int> nfam,next;   // families of each composition
+  Binomial_distribution     binomial;
+
+  int  index(int M,int S,int I) const {return first[M]+S*(M+1)+I;}
+  void binomial_pmf(int n,double p,double *P);
+  void multinomial(unsigned int N,int K,const double *P,unsigned int *n);
+} ;
+
+Family_classes::Family_classes(int NFamilies,int Mmax,double PM[]) :
+  Mmax(Mmax),
+  first(Mmax+2,0),
+  size_count(Mmax+1)
+{
+  for (int M=0; M<=Mmax; ++M) first[M+1]=first[M]+(M+1)*(M+1);
+  nfam.resize(first[Mmax+1]);
+  next.resize(first[Mmax+1]);
+  multinomial(NFamilies,Mmax+1,PM,size_count.data());
+  gstate.N=0;
+  for (int M=1; M<=Mmax; ++M) gstate.N+=M*size_count[M];
+}
+
+void Family_classes::binomial_pmf(int n,double p,double *P)
+{
+  double c=1;                   // n choose k
+  for (int k=0; k<=n; ++k) {
+    P[k]=c*pow(p,k)*pow(1-p,n-k);
+    c=c*(n-k)/(k+1);
+  }
+}
+
+// N trials distributed among K outcomes of probabilities proportional
+// to P, as successive binomials
+void Family_classes::multinomial(unsigned int N,int K,const double *P,unsigned int *n)
+{
+  int last=K-1;
+  while (last>0 && P[last]<=0) n[last--]=0;
+  double rest=0;
+  for (int k=0; k<=last; ++k) rest+=P[k];
+  for (int k=0; k<last; ++k) {
+    n[k]= N>0 && P[k]>0 ? binomial(N,std::min(P[k]/rest,1.)) : 0;
+    N-=n[k];
+    rest-=P[k];
+  }
+  n[last]=N;
+}
+
+void Family_classes::set_initial(double I0)
+{
+  std::vector<double>       P(Mmax+1);
+  std::vector<unsigned int> n(Mmax+1);
+  std::fill(nfam.begin(),nfam.end(),0);
+  for (int M=1; M<=Mmax; ++M) {
+    binomial_pmf(M,I0,P.data());
+    multinomial(size_count[M],M+1,P.data(),n.data());
+    for (int I=0; I<=M; ++I) nfam[index(M,M-I,I)]=n[I];
+  }
+  gstate.S=gstate.I=gstate.R=0;
+  for (int M=1; M<=Mmax; ++M)
+    for (int S=0; S<=M; ++S)
+      for (int I=0; S+I<=M; ++I) {
+	gstate.S+=S*nfam[index(M,S,I)];
+	gstate.I+=I*nfam[index(M,S,I)];
+      }
+  gstate.R=gstate.N-gstate.S-gstate.I;
+}
+
+void Family_classes::step(double dt,double beta_in,double beta_out,double gamma)
+{
+  std::vector<double>       Pa(Mmax+1),Pb(Mmax+1),P((Mmax+1)*(Mmax+1));
+  std::vector<unsigned int> n((Mmax+1)*(Mmax+1));
+  double hout=beta_out*gstate.I/(gstate.N-1);
+  double prec=-expm1(-gamma*dt);
+
+  std::fill(next.begin(),next.end(),0);
+  for (int M=1; M<=Mmax; ++M)
+    for (int S=0; S<=M; ++S)
+      for (int I=0; S+I<=M; ++I) {
+	unsigned int nf=nfam[index(M,S,I)];
+	if (nf==0) continue;
+	if (S==0 && I==0) {next[index(M,S,I)]+=nf; continue;}
+	binomial_pmf(S,-expm1(-(hout+beta_in*I)*dt),Pa.data());
+	binomial_pmf(I,prec,Pb.data());
+	for (int a=0; a<=S; ++a)              // a infections and b recoveries
+	  for (int b=0; b<=I; ++b)
+	    P[a*(I+1)+b]=Pa[a]*Pb[b];
+	multinomial(nf,(S+1)*(I+1),P.data(),n.data());
+	for (int a=0; a<=S; ++a)
+	  for (int b=0; b<=I; ++b) {
+	    unsigned int m=n[a*(I+1)+b];
+	    next[index(M,S-a,I+a-b)]+=m;
+	    gstate.S-=a*m;
+	    gstate.I+=(a-b)*m;
+	    gstate.R+=b*m;
+	  }
+      }
+  nfam.swap(next);
+}
+
+void run_binomial(Family_classes &fc,SIRstate *state)
+{
+  SIRistate istate;
+  int nsub=lround(1./options.dt);
+  for (int t=0; t<=options.steps; ++t) {
+    if (t>0)
+      for (int k=0; k<nsub; ++k)
+	fc.step(options.dt,options.beta_in,options.beta_out,options.gamma);
+    istate.S=(double) fc.gstate.S/fc.gstate.N;
+    istate.I=(double) fc.gstate.I/fc.gstate.N;
+    istate.R=(double) fc.gstate.R/fc.gstate.N;
+    state->push(t,istate);
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // main
@@ -306,16 +484,38 @@ int main(int argc,char *argv[])
 
   // Prepare global state (for output) and population
   SIRstate *state;
-  state = options.Nruns>1 ?
+  state = options.Nruns>1 || options.avfile ?
     new SIRstate_av : new SIRstate;
+#ifdef BINOMIAL_CHAIN
+  Family_classes pop(options.Nfamilies,options.Mmax,options.PM);
+#else
   Population pop(options.Nfamilies,options.beta_in,options.beta_out,options.gamma,
 		 options.Mmax,options.PM);
+#endif
 
   std::cout << "# N = " << pop.gstate.N << '\n';
-  std::cout << state->header() << '\n';
+  Trajectory_writer *traj=0;
+  Run_archive       *archive=0;
+  if (options.trajfile && (options.Nruns>1 || options.avfile)) {
+    archive=new Run_archive(options.trajfile,1.);
+    archive->add_run_info(argc,argv,options.seed,options.ifile);
+    static_cast<SIRstate_av*>(state)->set_archive(archive);
+  }
+  if (options.trajfile && !archive) {
+    traj=new Trajectory_writer(options.trajfile);
+    traj->add_run_info(argc,argv,options.seed,options.ifile);
+    state->set_trajectory(traj);
+  } else {
+    std::cout << state->header() << '\n';
+    if (options.Nruns==1 && !options.avfile) state->set_async_output();
+  }
 
   // Do runs and print results
   for (int n=0; n<options.Nruns; ++n) {
+#ifdef BINOMIAL_CHAIN
+    pop.set_initial(options.I0);
+    run_binomial(pop,state);
+#else
     // seed infected
     pop.set_all_S();
     for (int f=0; f<pop.families.size(); ++f) {
@@ -325,10 +525,18 @@ int main(int argc,char *argv[])
 
     // run and accumulate averages
     run(pop,state);
+#endif
+    if (archive) archive->end_run();
   }
 
-  if (options.Nruns>1)
+  if (options.Nruns>1 || options.avfile)
     std::cout << *state;
+  if (options.avfile) {
+    std::ofstream avf(options.avfile,std::ios::binary);
+    static_cast<SIRstate_av*>(state)->save(avf);
+  }
 
+  delete traj;
+  delete archive;
   delete state;
 }
@@ -25,6 +25,7 @@
  */
 
 #include <iostream>
+#include <fstream>
 #include <cstdio>
 #include <math.h>
 
@@ -32,6 +33,7 @@
 #include <string.h>
 
 #include "qdrandom.hh"
+#include "ensemble.hh"
 #include "popstate.hh"
 #include "gillespie_sampler.hh"
 
@@ -47,6 +49,7 @@ struct opt {
   int    N;
   int    steps;
   long   seed;
+  char   *avfile;    // file to save averages for later merging (optional)
 
   double R0;
   double inf_time;   // infection time (days)
@@ -55,7 +58,7 @@ struct opt {
   double beta;
   double gamma;
 
-  opt() : last_arg_read(0) {}
+  opt() : last_arg_read(0), avfile(0) {}
 
 } options;
 
@@ -70,7 +73,9 @@ static int nargs=5;
 
 void show_usage(char *prog)
 {
-  std::cerr << "usage: " << prog << " parameterfile seed N steps Nruns\n\n";
+  std::cerr << "usage: " << prog << " parameterfile seed N steps Nruns [avfile]\n\n"
+	    << "If avfile is given, the averages are also saved there (in binary form) so that\n"
+	    << "they can later be combined with those of other runs using merge_av\n";
   exit(1);
 }
 
@@ -86,13 +91,14 @@ char *readbuf(FILE *f)
 
 void read_parameters(int argc,char *argv[])
 {
-  if (argc!=nargs+1) show_usage(argv[0]);
+  if (argc!=nargs+1 && argc!=nargs+2) show_usage(argv[0]);
 
   read_arg(argv,options.ifile);
   read_arg(argv,options.seed);
   read_arg(argv,options.N);
   read_arg(argv,options.steps);
   read_arg(argv,options.Nruns);
+  if (argc==nargs+2) read_arg(argv,options.avfile);
 
   FILE *f=fopen(options.ifile,"r");
   if (f==0) throw std::runtime_error(strerror(errno));
@@ -173,6 +179,65 @@ void run(SIRstate *state)
   }
 }
 
+/*
+ * Lockstep version: ensemble_lanes runs at a time (see ensemble.hh),
+ * each with its own clock.  Sampling is as done by Gillespie_sampler:
+ * before the event, the state is pushed for the sampling times
+ * (integers up to options.steps) earlier than the time of the event.
+ *
+ */
+
+void run_lanes(SIRstate *state,int nruns)
+{
+  const int L=ensemble_lanes;
+  Lane_random<L> lran;
+
+  for (int first=0; first<nruns; first+=L) {
+    int    S[L],I[L],R[L],inf[L],live[L];
+    double time[L],tnew[L],tsamp[L],u1[L],u2[L];
+    int    nlive=0;
+    for (int l=0; l<L; ++l) {
+      S[l]=options.S0*options.N;
+      I[l]=options.I0*options.N;
+      R[l]=options.N-S[l]-I[l];
+      time[l]=0;
+      tsamp[l]=0;
+      live[l]= first+l<nruns;          // the last block may be incomplete
+      nlive+=live[l];
+    }
+
+    while (nlive>0) {
+      lran.uniform_pos(u1);
+      lran.uniform(u2);
+      for (int l=0; l<L; ++l) {
+	double pinf=options.beta*I[l]*S[l]/options.N;
+	double prec=options.gamma*I[l];
+	double pany=pinf+prec;
+	tnew[l]= pany>0 ? time[l]-lane_log(u1[l])/pany : HUGE_VAL;
+	inf[l]= u2[l]*pany<pinf;
+      }
+
+      for (int l=0; l<L; ++l) {
+	if (!live[l] || tnew[l]<=tsamp[l]) continue;
+	SIRistate gstate;
+	gstate.S=(double) S[l]/options.N;
+	gstate.I=(double) I[l]/options.N;
+	gstate.R=(double) R[l]/options.N;
+	for (; tsamp[l]<tnew[l] && tsamp[l]<=options.steps; tsamp[l]+=1.)
+	  state->push(tsamp[l],gstate);
+	if (tnew[l]>=options.steps) {live[l]=0; --nlive;}
+      }
+
+      for (int l=0; l<L; ++l) {
+	int a=live[l] & inf[l], b=live[l] & !inf[l];
+	S[l]-=a;
+	I[l]+=a-b;
+	R[l]+=b;
+	time[l]=tnew[l];
+      }
+    }
+  }
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -188,10 +253,14 @@ int main(int argc,char *argv[])
 
   // Do runs and print results
   if (options.Nruns>1)
-    for (int n=0; n<options.Nruns; ++n)
-      run<true>(&state);
+    run_lanes(&state,options.Nruns);
   else
     run<false>(&state);
 
   std::cout << state;
+
+  if (options.avfile) {
+    std::ofstream avf(options.avfile,std::ios::binary);
+    state.save(avf);
+  }
 }
@@ -0,0 +1,255 @@
+/*
+ * tdigest.cc -- streaming quantile estimation (t-digest)
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tdigest.hh"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Tdigest
+
+Tdigest::Tdigest(double compression_) :
+  compression(compression_),
+  total_weight(0),
+  min(std::numeric_limits<double>::infinity()),
+  max(-std::numeric_limits<double>::infinity())
+{}
+
+void Tdigest::push(double x)
+{
+  if (x<min) min=x;
+  if (x>max) max=x;
+  buffer.push_back(x);
+  if (buffer.size()>=5*compression) compress();
+}
+
+// Scale function k1 of Dunning and Ertl: a centroid can span at most
+// one unit of k, which makes centroids small near q=0 and q=1
+inline double Tdigest::kscale(double q) const
+{
+  return compression*asin(2*q-1)/(2*M_PI);
+}
+
+// Merge the buffered points into the centroid list
+void Tdigest::compress() const
+{
+  if (buffer.empty()) return;
+
+  for (double x : buffer) centroids.push_back({x,1.});
+  total_weight+=buffer.size();
+  buffer.clear();
+  merge_centroids();
+}
+
+// Sort the centroids and merge neighbours as long as the merged
+// centroid spans less than one unit of kscale
+void Tdigest::merge_centroids() const
+{
+  std::sort(centroids.begin(),centroids.end(),
+	    [](const centroid& a,const centroid& b) {return a.mean<b.mean;} );
+
+  double kmax=kscale(1.);
+  std::vector<centroid> merged;
+  merged.reserve(compression);
+  centroid cur=centroids[0];
+  double wsofar=0;
+  double k=std::min(kscale(0.)+1,kmax);
+  double qlimit=(sin(2*M_PI*k/compression)+1)/2;
+  for (int i=1; i<centroids.size(); ++i) {
+    const centroid& c=centroids[i];
+    if ( (wsofar+cur.weight+c.weight)/total_weight <= qlimit ) {
+      cur.weight+=c.weight;
+      cur.mean+=(c.mean-cur.mean)*c.weight/cur.weight;
+    } else {
+      merged.push_back(cur);
+      wsofar+=cur.weight;
+      cur=c;
+      k=std::min(kscale(wsofar/total_weight)+1,kmax);
+      qlimit=(sin(2*M_PI*k/compression)+1)/2;
+    }
+  }
+  merged.push_back(cur);
+  centroids.swap(merged);
+}
+
+void Tdigest::merge(const Tdigest& g)
+{
+  if (g.N()==0) return;
+  g.compress();
+  compress();
+  centroids.insert(centroids.end(),g.centroids.begin(),g.centroids.end());
+  total_weight+=g.total_weight;
+  merge_centroids();
+  if (g.min<min) min=g.min;
+  if (g.max>max) max=g.max;
+}
+
+// Interpolate linearly between centroid centres (and the extreme
+// values at both ends)
+double Tdigest::quantile(double q) const
+{
+  compress();
+  if (centroids.empty()) return NAN;
+  if (centroids.size()==1) return centroids[0].mean;
+
+  double target=q*total_weight;
+  const centroid& first=centroids.front();
+  if (target<first.weight/2) {
+    if (first.weight==1) return min;
+    return min+(first.mean-min)*target/(first.weight/2);
+  }
+
+  double cum=0;
+  for (int i=0; i<centroids.size()-1; ++i) {
+    const centroid& a=centroids[i];
+    const centroid& b=centroids[i+1];
+    double ca=cum+a.weight/2;
+    double cb=cum+a.weight+b.weight/2;
+    if (target<cb)
+      return a.mean+(b.mean-a.mean)*(target-ca)/(cb-ca);
+    cum+=a.weight;
+  }
+
+  const centroid& last=centroids.back();
+  if (last.weight==1) return max;
+  double cl=total_weight-last.weight/2;
+  return last.mean+(max-last.mean)*(target-cl)/(total_weight-cl);
+}
+
+void Tdigest::save(std::ostream& o) const
+{
+  compress();
+  unsigned long nc=centroids.size();
+  o.write((const char*) &compression,sizeof(compression));
+  o.write((const char*) &min,sizeof(min));
+  o.write((const char*) &max,sizeof(max));
+  o.write((const char*) &nc,sizeof(nc));
+  o.write((const char*) centroids.data(),nc*sizeof(centroid));
+}
+
+void Tdigest::load(std::istream& is)
+{
+  unsigned long nc;
+  is.read((char*) &compression,sizeof(compression));
+  is.read((char*) &min,sizeof(min));
+  is.read((char*) &max,sizeof(max));
+  is.read((char*) &nc,sizeof(nc));
+  if (!is) throw std::runtime_error("Tdigest::load: read error");
+  buffer.clear();
+  centroids.resize(nc);
+  is.read((char*) centroids.data(),nc*sizeof(centroid));
+  total_weight=0;
+  for (auto& c : centroids) total_weight+=c.weight;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Window_quantiles
+
+const double Window_quantiles::print_probs[nprobs]={0.05,0.25,0.5,0.75,0.95};
+
+Window_quantiles::Window_quantiles(int ncols_,double compression_) :
+  ncols(ncols_),
+  compression(compression_)
+{}
+
+void Window_quantiles::push(int window,const double *e)
+{
+  if (window<0) return;
+  if (window*ncols>=digests.size())
+    digests.resize((window+10)*ncols,Tdigest(compression));
+  Tdigest *d=digests.data()+window*ncols;
+  for (int i=0; i<ncols; ++i)
+    d[i].push(e[i]);
+}
+
+double Window_quantiles::quantile(int window,int col,double q) const
+{
+  if (window*ncols>=digests.size()) return NAN;
+  return digests[window*ncols+col].quantile(q);
+}
+
+void Window_quantiles::print(std::ostream& o,int window) const
+{
+  char buf[50];
+  for (int c=0; c<ncols; ++c)
+    for (int k=0; k<nprobs; ++k) {
+      sprintf(buf," %11.6g",quantile(window,c,print_probs[k]));
+      o << buf;
+    }
+}
+
+// Column names are colname(percent), and the columns are preceded by
+// a space, as in print()
+void Window_quantiles::add_header(std::string& hdr,const char* const colname[]) const
+{
+  char buf[50];
+  for (int c=0; c<ncols; ++c)
+    for (int k=0; k<nprobs; ++k) {
+      sprintf(buf," %6s(%2d%%)",colname[c],(int) (100*print_probs[k]+0.5));
+      hdr+=buf;
+    }
+}
+
+void Window_quantiles::merge(const Window_quantiles& g)
+{
+  if (g.ncols!=ncols)
+    throw std::runtime_error("Window_quantiles::merge: number of columns does not match");
+  if (g.digests.size()>digests.size())
+    digests.resize(g.digests.size(),Tdigest(compression));
+  for (int i=0; i<g.digests.size(); ++i)
+    digests[i].merge(g.digests[i]);
+}
+
+static const char window_quantiles_magic[]="Window_quantiles 1\n";
+
+void Window_quantiles::save(std::ostream& o) const
+{
+  unsigned long nd=digests.size();
+  o.write(window_quantiles_magic,sizeof(window_quantiles_magic)-1);
+  o.write((const char*) &ncols,sizeof(ncols));
+  o.write((const char*) &compression,sizeof(compression));
+  o.write((const char*) &nd,sizeof(nd));
+  for (auto& d : digests) d.save(o);
+  if (!o) throw std::runtime_error("Window_quantiles::save: write error");
+}
+
+void Window_quantiles::load(std::istream& is)
+{
+  char magic[sizeof(window_quantiles_magic)];
+  unsigned long nd;
+
+  is.read(magic,sizeof(window_quantiles_magic)-1);
+  if (!is || strncmp(magic,window_quantiles_magic,sizeof(window_quantiles_magic)-1)!=0)
+    throw std::runtime_error("Window_quantiles::load: not a Window_quantiles file");
+  is.read((char*) &ncols,sizeof(ncols));
+  is.read((char*) &compression,sizeof(compression));
+  is.read((char*) &nd,sizeof(nd));
+  if (!is) throw std::runtime_error("Window_quantiles::load: read error");
+  digests.assign(nd,Tdigest(compression));
+  for (auto& d : digests) d.load(is);
+  if (!is) throw std::runtime_error("Window_quantiles::load: read error");
+}
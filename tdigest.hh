@@ -0,0 +1,103 @@
+/*
+ * tdigest.hh -- streaming quantile estimation (t-digest)
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#ifndef TDIGEST_HH
+#define TDIGEST_HH
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Tdigest
+//
+// Estimates quantiles of a stream of numbers using bounded memory,
+// following Dunning and Ertl's merging t-digest.  Points are
+// buffered, and when the buffer is full they are sorted and merged
+// into a list of at most about compression centroids (mean and
+// weight), which are small near the tails and larger around the
+// median, so that extreme quantiles are more accurate than central
+// ones.  Two digests can be merged (the result is as accurate as if
+// all points had been pushed in one), so partial results can be
+// combined.  The algorithm is deterministic (it does not use random
+// numbers).
+
+class Tdigest {
+public:
+  Tdigest(double compression=100);
+
+  void   push(double x);
+  void   merge(const Tdigest&);
+  double quantile(double q) const;   // q in [0,1]
+  double N() const {return total_weight+buffer.size();}
+
+  void   save(std::ostream&) const;
+  void   load(std::istream&);
+
+private:
+  struct centroid {
+    double mean,weight;
+  } ;
+
+  double                        compression;
+  mutable std::vector<centroid> centroids;
+  mutable std::vector<double>   buffer;
+  mutable double                total_weight;
+  double                        min,max;
+
+  void   compress() const;
+  void   merge_centroids() const;
+  double kscale(double q) const;
+} ;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Window_quantiles
+//
+// A Tdigest for each of ncols columns in each time window, meant to
+// be used together with Multi_geoave (which computes the window index
+// for a given time, see Multi_geoave::push()).  print() writes the
+// quantiles in print_probs for all columns of a window, and
+// add_header() the corresponding column names.
+
+class Window_quantiles {
+public:
+  Window_quantiles(int ncols,double compression=50);
+
+  void   push(int window,const double *e);   // e must point to ncols values
+  void   merge(const Window_quantiles&);
+  double quantile(int window,int col,double q) const;
+  void   print(std::ostream&,int window) const;
+  void   add_header(std::string& hdr,const char* const colname[]) const;
+
+  static const int    nprobs=5;
+  static const double print_probs[nprobs];
+
+  void   save(std::ostream&) const;
+  void   load(std::istream&);
+
+private:
+  int                  ncols;
+  double               compression;
+  std::vector<Tdigest> digests;              // window n, column i is at n*ncols+i
+} ;
+
+#endif /* TDIGEST_HH */
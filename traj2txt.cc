@@ -0,0 +1,121 @@
+/*
+ * traj2txt.cc
+ *
+ * Print a binary trajectory file (see trajfile.hh) in the text format
+ * used by the simulation programs.  The informative entries of the
+ * header (command line, seed, parameter file) are printed first as
+ * comments, followed by the text header and the data.
+ *
+ * Run archives are printed one run after the other (separated by two
+ * blank lines), or only the run given as second argument (numbered
+ * from 0).
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstdio>
+
+#include <stdlib.h>
+
+#include "trajfile.hh"
+
+void show_usage(char *prog)
+{
+  std::cerr << "usage: " << prog << " trajfile [run]\n\n"
+	    << "Print a binary trajectory file or run archive in text format\n";
+  exit(1);
+}
+
+void print_entries(const std::vector<std::pair<std::string,std::string> >& entries)
+{
+  for (auto& e : entries) {
+    if (e.first=="columns" || e.first=="text_header") continue;
+    std::istringstream v(e.second);
+    std::string line;
+    printf("# %s:\n",e.first.c_str());
+    while (std::getline(v,line))
+      printf("#   %s\n",line.c_str());
+  }
+}
+
+void print_trajectory(char *fname)
+{
+  Trajectory_reader traj(fname);
+
+  print_entries(traj.entries());
+  printf("%s\n",traj.text_header().c_str());
+
+  int nc=traj.ncols();
+  std::vector<const double*> col(nc);
+  for (int b=0; b<traj.nblocks(); ++b) {
+    for (int c=0; c<nc; ++c) col[c]=traj.column(b,c);
+    for (long r=0; r<traj.block_rows(b); ++r) {
+      for (int c=0; c<nc; ++c) {
+	if (traj.format(c)=='d')
+	  printf("%11d",(int) col[c][r]);
+	else
+	  printf("%11.6g",col[c][r]);
+	putchar(c<nc-1 ? ' ' : '\n');
+      }
+    }
+  }
+}
+
+void print_archive(char *fname,int run)
+{
+  Run_archive_reader archive(fname);
+
+  print_entries(archive.entries());
+  printf("# Runs: %d\n",archive.nruns());
+
+  int nc=archive.ncols();
+  std::string hdr="#      time";
+  for (int c=0; c<nc; ++c) {
+    char buf[50];
+    sprintf(buf," %11s",archive.colname(c).c_str());
+    hdr+=buf;
+  }
+
+  std::vector<double> time;
+  std::vector<long>   data;
+  int first= run<0 ? 0 : run;
+  int last= run<0 ? archive.nruns()-1 : run;
+  for (int k=first; k<=last; ++k) {
+    archive.read_run(k,time,data);
+    if (k>first) printf("\n\n");
+    printf("# Run %d\n%s\n",k,hdr.c_str());
+    for (int i=0; i<time.size(); ++i) {
+      printf("%11.6g",time[i]);
+      for (int c=0; c<nc; ++c)
+	printf(" %11ld",data[i*nc+c]);
+      putchar('\n');
+    }
+  }
+}
+
+int main(int argc,char *argv[])
+{
+  if (argc!=2 && argc!=3) show_usage(argv[0]);
+
+  if (is_run_archive(argv[1]))
+    print_archive(argv[1],argc==3 ? atoi(argv[2]) : -1);
+  else
+    print_trajectory(argv[1]);
+}
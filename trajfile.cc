@@ -0,0 +1,413 @@
+/*
+ * trajfile.cc -- binary (columnar) trajectory files
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "trajfile.hh"
+
+static const char traj_magic[]="COVIDm trajectory 1\n";
+static const char archive_magic[]="COVIDm run archive 1\n";
+static const char index_magic[]="RUNINDEX";
+
+static void add_entry(std::string& hdr,const char *key,const std::string& value)
+{
+  char buf[200];
+  sprintf(buf,"%s %lu\n",key,(unsigned long) value.size());
+  hdr+=buf;
+  hdr+=value;
+  hdr+='\n';
+}
+
+// Parse header entries in [p,hend)
+static void parse_header(const char *fname,const char *p,const char *hend,
+			 std::vector<std::pair<std::string,std::string> >& info)
+{
+  while (p<hend) {
+    if (*p=='\n') {++p; continue;}                  // padding
+    const char *eol=(const char*) memchr(p,'\n',hend-p);
+    if (eol==0) throw std::runtime_error(std::string(fname)+": bad header");
+    std::istringstream kl(std::string(p,eol));
+    std::string key;
+    unsigned long n;
+    kl >> key >> n;
+    p=eol+1;
+    if (p+n>hend) throw std::runtime_error(std::string(fname)+": bad header");
+    info.push_back(std::make_pair(key,std::string(p,n)));
+    p+=n+1;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Binary_file_info
+
+void Binary_file_info::add_info(const char *key,const std::string& value)
+{
+  add_entry(info,key,value);
+}
+
+void Binary_file_info::add_info_file(const char *key,const char *fname)
+{
+  std::ifstream in(fname);
+  if (!in) {
+    std::cerr << "Error opening file (" << fname << ")\n";
+    throw std::runtime_error(strerror(errno));
+  }
+  std::ostringstream s;
+  s << in.rdbuf();
+  add_entry(info,key,s.str());
+}
+
+void Binary_file_info::add_run_info(int argc,char *argv[],long seed,const char *parfile)
+{
+  std::string cmd(argv[0]);
+  for (int i=1; i<argc; ++i) cmd+=std::string(" ")+argv[i];
+  add_info("command",cmd);
+  add_info("seed",std::to_string(seed));
+  add_info_file("parameter_file",parfile);
+}
+
+// Write magic, header length and header (hdr followed by the
+// informative entries), padded so that what follows is 8-byte aligned
+void Binary_file_info::write_header(FILE *f,const char *magic,std::string hdr)
+{
+  hdr+=info;
+  unsigned long hlen=hdr.size();
+  unsigned long pos=strlen(magic)+sizeof(hlen)+hlen;
+  if (pos%8) hlen+=8-pos%8;
+  hdr.resize(hlen,'\n');
+
+  fwrite(magic,1,strlen(magic),f);
+  fwrite(&hlen,sizeof(hlen),1,f);
+  fwrite(hdr.data(),1,hlen,f);
+  if (ferror(f)) throw std::runtime_error("write error writing binary file header");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Trajectory_writer
+
+Trajectory_writer::Trajectory_writer(const char *fname_,int block_rows_) :
+  fname(fname_),
+  ncols_(0),
+  block_rows(block_rows_),
+  nrows(0)
+{
+  f=fopen(fname_,"wb");
+  if (f==0) {
+    std::cerr << "Error opening file (" << fname << ")\n";
+    throw std::runtime_error(strerror(errno));
+  }
+}
+
+Trajectory_writer::~Trajectory_writer()
+{
+  if (nrows>0) write_block();
+  fclose(f);
+}
+
+void Trajectory_writer::begin(const char *text_header,const std::string& formats)
+{
+  // Column names are the fields of the last line of the text header
+  std::string th(text_header);
+  size_t      p=th.rfind('\n');
+  std::istringstream last(p==std::string::npos ? th : th.substr(p+1));
+  std::string name,cols;
+  if (last.peek()=='#') last.get();
+  for (ncols_=0; last >> name; ++ncols_) {
+    if (ncols_>=formats.size())
+      throw std::runtime_error("Trajectory_writer: more columns in header than formats");
+    cols+=name+' '+formats[ncols_]+'\n';
+  }
+  if (ncols_!=formats.size())
+    throw std::runtime_error("Trajectory_writer: number of columns in header and formats do not match");
+
+  std::string hdr;
+  add_entry(hdr,"columns",cols);
+  add_entry(hdr,"text_header",th);
+  write_header(f,traj_magic,hdr);
+  block.resize(ncols_*block_rows);
+}
+
+void Trajectory_writer::write_block()
+{
+  unsigned long n=nrows;
+  fwrite(&n,sizeof(n),1,f);
+  for (int c=0; c<ncols_; ++c)
+    fwrite(block.data()+c*block_rows,sizeof(double),nrows,f);
+  if (ferror(f)) throw std::runtime_error("Trajectory_writer: write error");
+  nrows=0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Trajectory_reader
+
+Trajectory_reader::Trajectory_reader(const char *fname)
+{
+  int fd=open(fname,O_RDONLY);
+  if (fd<0) {
+    std::cerr << "Error opening file (" << fname << ")\n";
+    throw std::runtime_error(strerror(errno));
+  }
+  struct stat st;
+  fstat(fd,&st);
+  size=st.st_size;
+  map=mmap(0,size,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);
+  if (map==MAP_FAILED) throw std::runtime_error(strerror(errno));
+
+  const char *p=(const char*) map;
+  const char *end=p+size;
+  if (size<sizeof(traj_magic)-1+sizeof(unsigned long) ||
+      strncmp(p,traj_magic,sizeof(traj_magic)-1)!=0)
+    throw std::runtime_error(std::string(fname)+": not a trajectory file");
+  p+=sizeof(traj_magic)-1;
+  unsigned long hlen=*(const unsigned long*) p;
+  p+=sizeof(hlen);
+  const char *hend=p+hlen;
+  if (hend>end) throw std::runtime_error(std::string(fname)+": truncated header");
+
+  parse_header(fname,p,hend,info);
+  for (auto& e : info)
+    if (e.first=="columns") {
+      std::istringstream cl(e.second);
+      std::string name;
+      char fmt;
+      while (cl >> name >> fmt) {
+	colnames.push_back(name);
+	formats+=fmt;
+      }
+    }
+
+  // Data blocks
+  p=hend;
+  while (p<end) {
+    const unsigned long *b=(const unsigned long*) p;
+    p+=sizeof(unsigned long)+(*b)*ncols()*sizeof(double);
+    if (p>end) {
+      std::cerr << "Warning: " << fname << " is truncated\n";
+      break;
+    }
+    blocks.push_back(b);
+  }
+}
+
+Trajectory_reader::~Trajectory_reader()
+{
+  munmap(map,size);
+}
+
+const std::string& Trajectory_reader::text_header() const
+{
+  static const std::string none;
+  for (auto& e : info)
+    if (e.first=="text_header") return e.second;
+  return none;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Run_archive
+
+Run_archive::Run_archive(const char *fname_,double deltat_) :
+  fname(fname_),
+  deltat(deltat_),
+  ncols(0),
+  nrows(0)
+{
+  f=fopen(fname_,"wb");
+  if (f==0) {
+    std::cerr << "Error opening file (" << fname << ")\n";
+    throw std::runtime_error(strerror(errno));
+  }
+}
+
+Run_archive::~Run_archive()
+{
+  if (nrows>0) end_run();
+  unsigned long n=offsets.size();
+  fwrite(offsets.data(),sizeof(unsigned long),n,f);
+  fwrite(&n,sizeof(n),1,f);
+  fwrite(index_magic,1,8,f);
+  fclose(f);
+}
+
+void Run_archive::begin(const char *colnames)
+{
+  std::istringstream cl(colnames);
+  std::string name,cols;
+  for (ncols=0; cl >> name; ++ncols)
+    cols+=name+'\n';
+
+  char buf[50];
+  sprintf(buf,"%.17g",deltat);
+  std::string hdr;
+  add_entry(hdr,"columns",cols);
+  add_entry(hdr,"deltat",buf);
+  write_header(f,archive_magic,hdr);
+  prev.resize(ncols+1);
+}
+
+// zig-zag and varint encoding
+inline void Run_archive::put(long x)
+{
+  unsigned long u=(x<<1) ^ (x>>(8*sizeof(long)-1));
+  while (u>=0x80) {
+    run+=(char) (u|0x80);
+    u>>=7;
+  }
+  run+=(char) u;
+}
+
+void Run_archive::push(double time,const double *row)
+{
+  if (nrows==0) std::fill(prev.begin(),prev.end(),0);
+  long v=lround(time/deltat);
+  put(v-prev[0]);
+  prev[0]=v;
+  for (int c=0; c<ncols; ++c) {
+    v=lround(row[c]);
+    put(v-prev[c+1]);
+    prev[c+1]=v;
+  }
+  ++nrows;
+}
+
+// The number of rows goes first, so it is encoded separately
+void Run_archive::end_run()
+{
+  offsets.push_back(ftell(f));
+  std::string rows;
+  rows.swap(run);
+  put(nrows);
+  fwrite(run.data(),1,run.size(),f);
+  fwrite(rows.data(),1,rows.size(),f);
+  if (ferror(f)) throw std::runtime_error("Run_archive: write error");
+  run.clear();
+  nrows=0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Run_archive_reader
+
+bool is_run_archive(const char *fname)
+{
+  std::ifstream f(fname,std::ios::binary);
+  char magic[sizeof(archive_magic)];
+  f.read(magic,sizeof(archive_magic)-1);
+  return f && strncmp(magic,archive_magic,sizeof(archive_magic)-1)==0;
+}
+
+Run_archive_reader::Run_archive_reader(const char *fname_) :
+  f(fname_,std::ios::binary),
+  fname(fname_)
+{
+  if (!f) {
+    std::cerr << "Error opening file (" << fname << ")\n";
+    throw std::runtime_error(strerror(errno));
+  }
+  if (!is_run_archive(fname_))
+    throw std::runtime_error(fname+": not a run archive");
+
+  unsigned long hlen;
+  f.seekg(sizeof(archive_magic)-1);
+  f.read((char*) &hlen,sizeof(hlen));
+  std::string hdr(hlen,' ');
+  f.read(&hdr[0],hlen);
+  if (!f) throw std::runtime_error(fname+": truncated header");
+  parse_header(fname_,hdr.data(),hdr.data()+hlen,info);
+  deltat_=1;
+  for (auto& e : info) {
+    if (e.first=="columns") {
+      std::istringstream cl(e.second);
+      std::string name;
+      while (cl >> name) colnames.push_back(name);
+    } else if (e.first=="deltat")
+      deltat_=atof(e.second.c_str());
+  }
+
+  // Index
+  unsigned long n;
+  char magic[8];
+  f.seekg(-(long) (sizeof(n)+8),std::ios::end);
+  unsigned long index_end=f.tellg();
+  f.read((char*) &n,sizeof(n));
+  f.read(magic,8);
+  if (!f || strncmp(magic,index_magic,8)!=0)
+    throw std::runtime_error(fname+": index not found (incomplete archive?)");
+  offsets.resize(n+1);
+  offsets[n]=index_end-n*sizeof(unsigned long);
+  f.seekg(offsets[n]);
+  f.read((char*) offsets.data(),n*sizeof(unsigned long));
+  if (!f) throw std::runtime_error(fname+": error reading index");
+}
+
+void Run_archive_reader::read_run(int k,std::vector<double>& time,std::vector<long>& data)
+{
+  if (k<0 || k>=nruns())
+    throw std::runtime_error(fname+": no such run");
+  std::string buf(offsets[k+1]-offsets[k],' ');
+  f.seekg(offsets[k]);
+  f.read(&buf[0],buf.size());
+  if (!f) throw std::runtime_error(fname+": read error");
+
+  const unsigned char *p=(const unsigned char*) buf.data();
+  const unsigned char *end=p+buf.size();
+  auto get=[&]() -> long {
+    unsigned long u=0;
+    int shift=0;
+    while (p<end && (*p & 0x80)) {
+      u|=(unsigned long) (*p++ & 0x7f) << shift;
+      shift+=7;
+    }
+    if (p==end) throw std::runtime_error(fname+": corrupt run");
+    u|=(unsigned long) (*p++) << shift;
+    return (long) (u>>1) ^ -(long) (u&1);
+  } ;
+
+  long nrows=get();
+  int  nc=ncols();
+  std::vector<long> prev(nc+1,0);
+  time.resize(nrows);
+  data.resize(nrows*nc);
+  for (long i=0; i<nrows; ++i) {
+    prev[0]+=get();
+    time[i]=prev[0]*deltat_;
+    for (int c=0; c<nc; ++c) {
+      prev[c+1]+=get();
+      data[i*nc+c]=prev[c+1];
+    }
+  }
+}
@@ -0,0 +1,232 @@
+/*
+ * trajfile.hh -- binary (columnar) trajectory files
+ *
+ * This file is part of COVIDm.
+ *
+ * COVIDm is copyright (C) 2020 by the authors (see file AUTHORS)
+ *
+ * COVIDm is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (GPL) as
+ * published by the Free Software Foundation. You can use either
+ * version 3, or (at your option) any later version.
+ *
+ * COVIDm is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * For details see the file LICENSE.
+ *
+ */
+
+/*
+ * A trajectory file holds the same data that the programs write to
+ * standard output for a single run, but in binary form, to avoid the
+ * cost of formatting (which dominates when every Gillespie event is
+ * recorded) and to save space.
+ *
+ * Layout of the file:
+ *
+ *  - the line "COVIDm trajectory 1\n"
+ *  - an unsigned long (8 bytes) giving the length of the header
+ *  - the header: a sequence of entries, each formed by a line "key
+ *    nbytes\n" followed by nbytes of text and a newline.  Entry
+ *    "columns" lists one column per line (name and format, 'g' for
+ *    real or 'd' for integer), and "text_header" is the header of the
+ *    text output.  Other entries (seed, command line, parameter file)
+ *    are informative.  The header is padded with newlines so that the
+ *    data start at a multiple of 8 bytes.
+ *  - blocks of data: an unsigned long giving the number of rows in the
+ *    block, followed by the values (doubles), stored by columns
+ *    (i.e. first all the times of the block, then all the values of
+ *    the second column, etc.)
+ *
+ * All data are aligned, so that the file can be mapped in memory and
+ * the columns used directly (this is what Trajectory_reader does).
+ * Numbers are in the native format of the machine that wrote the
+ * file.  The program traj2txt converts the file to the text format.
+ *
+ * A run archive stores the sampled trajectories of all the runs of an
+ * ensemble (which otherwise only survive as averages), compactly
+ * enough to keep thousands of runs.  Only integer quantities (counts)
+ * are stored, and times are assumed to be multiples of the sampling
+ * interval deltat.  Layout:
+ *
+ *  - the line "COVIDm run archive 1\n"
+ *  - the header length and header, as above (the "columns" entry
+ *    includes only names, and entry "deltat" gives the sampling
+ *    interval)
+ *  - the runs, one after the other.  Each run is a sequence of
+ *    varints (7 bits per byte, least significant first, high bit set
+ *    in all bytes but the last): first the number of rows, then the
+ *    rows, each formed by time/deltat and the values of the columns.
+ *    Each number is stored as the difference with the same column of
+ *    the previous row (the first row of a run is relative to zero),
+ *    zig-zag encoded (0,-1,1,-2,... as 0,1,2,3,...), so that slowly
+ *    changing counts take one byte.
+ *  - the index: the offset of each run (unsigned long), the number of
+ *    runs (unsigned long) and the 8 characters "RUNINDEX".
+ *
+ * The writer keeps only the current run in memory (plus 8 bytes per
+ * run for the index), and the reader can load any run with a single
+ * seek.
+ */
+
+#ifndef TRAJFILE_HH
+#define TRAJFILE_HH
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <utility>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Binary_file_info
+//
+// Informative header entries, common to trajectory files and run
+// archives: add_info() adds an entry, add_info_file() copies a whole
+// file (e.g. the parameter file), and add_run_info() records the
+// command line, seed and parameter file.
+
+class Binary_file_info {
+public:
+  void add_info(const char *key,const std::string& value);
+  void add_info_file(const char *key,const char *fname);
+  void add_run_info(int argc,char *argv[],long seed,const char *parfile);
+
+protected:
+  std::string info;
+
+  void write_header(FILE*,const char *magic,std::string hdr);
+} ;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Trajectory_writer
+//
+// Add informative entries, then call begin() with the header of the
+// text output (the column names are taken from its last line) and the
+// column formats, then push() rows.  Rows are buffered and written in
+// blocks of block_rows; the last block is written by the destructor.
+
+class Trajectory_writer : public Binary_file_info {
+public:
+  Trajectory_writer(const char *fname,int block_rows=4096);
+  ~Trajectory_writer();
+
+  void begin(const char *text_header,const std::string& formats);
+  void push(const double *row);    // row must have ncols values
+
+  int  ncols() const {return ncols_;}
+
+private:
+  FILE                *f;
+  std::string         fname;
+  int                 ncols_,block_rows,nrows;
+  std::vector<double> block;       // column c of current block at c*block_rows
+
+  void write_block();
+} ;
+
+inline void Trajectory_writer::push(const double *row)
+{
+  for (int c=0; c<ncols_; ++c)
+    block[c*block_rows+nrows]=row[c];
+  if (++nrows==block_rows) write_block();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Trajectory_reader
+//
+// Maps the file in memory; data are accessed by blocks and columns,
+// column(b,c) points to the block_rows(b) values of column c in block b.
+
+class Trajectory_reader {
+public:
+  Trajectory_reader(const char *fname);
+  ~Trajectory_reader();
+
+  int                ncols() const {return colnames.size();}
+  const std::string& colname(int c) const {return colnames[c];}
+  char               format(int c) const {return formats[c];}
+  const std::string& text_header() const;
+  const std::vector<std::pair<std::string,std::string> >& entries() const {return info;}
+
+  int                nblocks() const {return blocks.size();}
+  long               block_rows(int b) const {return *blocks[b];}
+  const double*      column(int b,int c) const
+  {return (const double*) (blocks[b]+1) + c*(*blocks[b]);}
+
+private:
+  void                     *map;
+  size_t                   size;
+  std::vector<std::pair<std::string,std::string> > info;
+  std::vector<std::string> colnames;
+  std::string              formats;
+  std::vector<const unsigned long*> blocks;
+} ;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Run_archive
+//
+// Add informative entries, then call begin() with the column names
+// (separated by blanks), then for each run push() the rows (the values
+// are rounded to integers) and call end_run().  The index is written
+// by the destructor.
+
+class Run_archive : public Binary_file_info {
+public:
+  Run_archive(const char *fname,double deltat);
+  ~Run_archive();
+
+  void begin(const char *colnames);
+  void push(double time,const double *row);    // row must have ncols values
+  void end_run();
+
+private:
+  FILE                       *f;
+  std::string                fname;
+  double                     deltat;
+  int                        ncols;
+  unsigned long              nrows;
+  std::string                run;              // encoded rows of current run
+  std::vector<long>          prev;             // previous row (time first)
+  std::vector<unsigned long> offsets;
+
+  void put(long);
+} ;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Run_archive_reader
+//
+// read_run(k,time,data) loads run k, data holds the rows one after the
+// other (row i, column c at data[i*ncols()+c]).
+
+class Run_archive_reader {
+public:
+  Run_archive_reader(const char *fname);
+
+  int                nruns() const {return offsets.size()-1;}
+  int                ncols() const {return colnames.size();}
+  const std::string& colname(int c) const {return colnames[c];}
+  double             deltat() const {return deltat_;}
+  const std::vector<std::pair<std::string,std::string> >& entries() const {return info;}
+
+  void read_run(int k,std::vector<double>& time,std::vector<long>& data);
+
+private:
+  std::ifstream              f;
+  std::string                fname;
+  double                     deltat_;
+  std::vector<std::pair<std::string,std::string> > info;
+  std::vector<std::string>   colnames;
+  std::vector<unsigned long> offsets;          // nruns+1 (last one is the start of the index)
+} ;
+
+bool is_run_archive(const char *fname);
+
+#endif /* TRAJFILE_HH */